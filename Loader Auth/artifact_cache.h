@@ -0,0 +1,245 @@
+#pragma once
+
+// Content-addressed local cache for downloaded products.
+//
+// Blobs live in <data dir>/artifacts named after the hex of their ETag /
+// content hash, so identical content is stored once. An index maps each
+// product name to its current blob plus the validators (ETag,
+// Last-Modified) used for conditional revalidation. The cache is bounded
+// by total size and entry count and evicts least recently used entries.
+// The SHA-256 of each blob is kept too, so the server can offer a patch
+// from exactly that version (delta.h).
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+#include "paths.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+struct ArtifactEntry {
+    std::string product;
+    std::string etag;
+    std::string lastModified;
+    unsigned long long size = 0;
+    long long lastUsed = 0;  // unix seconds
+    std::string sha256;      // hex, empty when the download was not hashed
+};
+
+class ArtifactCache {
+public:
+    // --- CONFIG ---
+    static const unsigned long long kMaxBytes = 512ULL * 1024 * 1024;
+    static const size_t kMaxEntries = 16;
+
+    static ArtifactCache& Instance() {
+        static ArtifactCache instance(LocalDataPath("artifacts", true));
+        return instance;
+    }
+
+    // An empty or missing `dir` disables the cache.
+    explicit ArtifactCache(const std::string& dir) : dir_(IsDirectory(dir) ? dir : "") {
+        Load();
+    }
+
+    bool Enabled() const { return !dir_.empty(); }
+
+    // Finds the cached entry for `product` whose blob is still on disk.
+    bool Lookup(const std::string& product, ArtifactEntry& entry) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const ArtifactEntry& e : entries_) {
+            if (e.product == product && FileSize(BlobPathLocked(e.etag)) == (long long)e.size) {
+                entry = e;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string BlobPath(const std::string& etag) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return BlobPathLocked(etag);
+    }
+
+    // Where downloads are staged before Commit() moves them into place.
+    std::string StagingPath(const std::string& product) {
+        return dir_ + kPathSeparator + "incoming-" + HexName(product);
+    }
+
+    // Marks an entry as used now (after a successful revalidation).
+    void Touch(const std::string& product) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (ArtifactEntry& e : entries_) {
+            if (e.product == product) e.lastUsed = (long long)time(NULL);
+        }
+        SaveLocked();
+    }
+
+    // Moves a fully downloaded file from StagingPath() into the content
+    // store and points `product` at it, then enforces the size limits.
+    bool Commit(const std::string& product, const std::string& etag, const std::string& lastModified,
+                const std::string& sha256 = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string staged = dir_ + kPathSeparator + "incoming-" + HexName(product);
+        std::string blob = BlobPathLocked(etag);
+        long long size = FileSize(staged);
+        if (etag.empty() || size < 0) return false;
+
+        if (!MoveIntoPlace(staged, blob)) return false;
+
+        ArtifactEntry entry;
+        entry.product = product;
+        entry.etag = etag;
+        entry.lastModified = lastModified;
+        entry.size = (unsigned long long)size;
+        entry.lastUsed = (long long)time(NULL);
+        entry.sha256 = sha256;
+
+        std::string previousEtag;
+        for (size_t i = 0; i < entries_.size(); i++) {
+            if (entries_[i].product == product) {
+                previousEtag = entries_[i].etag;
+                entries_.erase(entries_.begin() + i);
+                break;
+            }
+        }
+        entries_.push_back(entry);
+
+        if (!previousEtag.empty() && previousEtag != etag) DeleteBlobIfUnusedLocked(previousEtag);
+        EvictLocked();
+        SaveLocked();
+        return true;
+    }
+
+    unsigned long long TotalBytes() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return TotalBytesLocked();
+    }
+
+private:
+    static std::string HexName(const std::string& s) {
+        static const char* digits = "0123456789abcdef";
+        std::string out;
+        out.reserve(s.size() * 2);
+        for (unsigned char c : s) {
+            out += digits[c >> 4];
+            out += digits[c & 15];
+        }
+        return out;
+    }
+
+    static long long FileSize(const std::string& path) {
+#ifdef _WIN32
+        HANDLE h = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (h == INVALID_HANDLE_VALUE) return -1;
+        LARGE_INTEGER size;
+        BOOL ok = GetFileSizeEx(h, &size);
+        CloseHandle(h);
+        return ok ? (long long)size.QuadPart : -1;
+#else
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 ? (long long)st.st_size : -1;
+#endif
+    }
+
+    static bool MoveIntoPlace(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+        return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+#else
+        return rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
+
+    std::string BlobPathLocked(const std::string& etag) const {
+        return dir_ + kPathSeparator + HexName(etag) + ".bin";
+    }
+
+    // Blobs shared by several products are counted once.
+    unsigned long long TotalBytesLocked() const {
+        unsigned long long total = 0;
+        for (size_t i = 0; i < entries_.size(); i++) {
+            bool seen = false;
+            for (size_t j = 0; j < i && !seen; j++) seen = entries_[j].etag == entries_[i].etag;
+            if (!seen) total += entries_[i].size;
+        }
+        return total;
+    }
+
+    void DeleteBlobIfUnusedLocked(const std::string& etag) {
+        for (const ArtifactEntry& e : entries_) {
+            if (e.etag == etag) return;
+        }
+        std::remove(BlobPathLocked(etag).c_str());
+    }
+
+    // Drops least recently used entries until both limits hold. The newest
+    // entry is always kept, even if it alone exceeds kMaxBytes.
+    void EvictLocked() {
+        std::stable_sort(entries_.begin(), entries_.end(), [](const ArtifactEntry& a, const ArtifactEntry& b) {
+            return a.lastUsed < b.lastUsed;
+        });
+        while (entries_.size() > 1 && (entries_.size() > kMaxEntries || TotalBytesLocked() > kMaxBytes)) {
+            std::string etag = entries_.front().etag;
+            entries_.erase(entries_.begin());
+            DeleteBlobIfUnusedLocked(etag);
+        }
+    }
+
+    // index: product \t etag \t lastModified \t size \t lastUsed [\t sha256]
+    void Load() {
+        if (dir_.empty()) return;
+        std::ifstream in(dir_ + kPathSeparator + "index");
+        std::string line;
+        while (std::getline(in, line)) {
+            std::vector<std::string> fields;
+            std::stringstream ss(line);
+            std::string field;
+            while (std::getline(ss, field, '\t')) fields.push_back(field);
+            if (fields.size() != 5 && fields.size() != 6) continue;
+
+            ArtifactEntry e;
+            e.product = fields[0];
+            e.etag = fields[1];
+            e.lastModified = fields[2];
+            e.size = strtoull(fields[3].c_str(), NULL, 10);
+            e.lastUsed = strtoll(fields[4].c_str(), NULL, 10);
+            if (fields.size() == 6) e.sha256 = fields[5];
+            entries_.push_back(e);
+        }
+    }
+
+    void SaveLocked() {
+        if (dir_.empty()) return;
+        std::string path = dir_ + kPathSeparator + "index";
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out) return;
+            for (const ArtifactEntry& e : entries_) {
+                out << e.product << '\t' << e.etag << '\t' << e.lastModified << '\t'
+                    << e.size << '\t' << e.lastUsed;
+                if (!e.sha256.empty()) out << '\t' << e.sha256;
+                out << '\n';
+            }
+        }
+        MoveIntoPlace(tmp, path);
+    }
+
+    std::string dir_;
+    std::mutex mutex_;
+    std::vector<ArtifactEntry> entries_;
+};
@@ -0,0 +1,705 @@
+#pragma once
+
+// Client side of the loader auth API (/auth/*).
+//
+// One AuthClient holds one session. main.cpp drives a single instance
+// interactively; loadgen.cpp runs many of them concurrently. Request bodies
+// are built with json::Writer into a per-thread buffer, and every request
+// goes through HttpClient's shared keep-alive pool under a RequestPolicy
+// (deadline, retries, circuit breaker). With leases enabled, license and
+// login checks can be answered from a signed offline lease
+// (license_lease.h) instead. With telemetry enabled, login logs and
+// component reports are queued (telemetry.h) instead of sent inline.
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "http_client.h"
+#include "request_policy.h"
+#include "hardware.h"
+#include "json.h"
+#include "session_cache.h"
+#include "license_lease.h"
+#include "telemetry.h"
+#include "trace.h"
+
+// Result of POST /auth/payload/stream.
+struct PayloadTicket {
+    std::string downloadUrl;   // signed URL, valid for 30 seconds
+    std::string etag;          // content hash (newer servers only)
+    std::string sha256;        // SHA-256 of the payload, hex (servers that recorded it at upload)
+    unsigned long long size = 0;
+    std::string patchUrl;      // signed URL of a patch from the baseSha256 we sent, when the server has one
+    unsigned long long patchSize = 0;
+    bool notModified = false;  // the cachedEtag we sent is still current
+    std::string response;      // raw body (batch: the product's message), for error reports
+};
+
+// One product of a RequestPayloads() call; the fields mean what the
+// arguments of RequestPayload() do.
+struct PayloadRequest {
+    std::string productName;
+    std::string cachedEtag;
+    std::string baseSha256;
+};
+
+// Called after every API request with the endpoint path ("/auth/login"),
+// its latency and whether it got a 2xx answer.
+typedef std::function<void(const char* endpoint, double ms, bool ok)> RequestObserver;
+
+class AuthClient {
+public:
+    // --- CONFIG ---
+    static const size_t kRequestBufferSize = 1024;
+    static const unsigned long kRequestDeadlineMs = 10000;  // per call, retries included
+    static const size_t kMaxBatchProducts = 16;             // server limit for /auth/payload/batch
+    static constexpr const char* kLoginEvent = "login";             // telemetry event types
+    static constexpr const char* kComponentsEvent = "components";
+
+    // `initMembers` are the pre-serialized /auth/init members (name,
+    // ownerId, secret, version); `out` receives progress messages.
+    AuthClient(const std::string& apiUrl, std::string_view initMembers, const std::string& version,
+               std::ostream& out = std::cout)
+        : apiUrl_(apiUrl), initMembers_(initMembers), version_(version), out_(out) {}
+
+    // Hardware identity sent with license, HWID and component calls.
+    void SetHardware(const HardwareInfo& hardware) { hardware_ = hardware; }
+
+    // Lets Initialize() resume the session saved by a previous launch.
+    // `key` ties the cache file to this app and machine.
+    void EnableSessionCache(SessionCache* cache, const std::string& key) {
+        sessionCache_ = cache;
+        sessionCacheKey_ = key;
+    }
+
+    // Lets CheckLease() authenticate from a stored lease, and makes
+    // successful license/login checks store the lease the server returns.
+    // `publicKeyHex` is the server's Ed25519 lease key.
+    void EnableLeases(LeaseStore* store, const std::string& key, const std::string& publicKeyHex) {
+        leases_ = store;
+        leaseKey_ = key;
+        leasePublicKey_ = publicKeyHex;
+    }
+
+    // Makes SendLoginLog() and SendComponents() queue their events on
+    // `queue`, which starts sending once a session exists.
+    void EnableTelemetry(TelemetryQueue* queue) { telemetry_ = queue; }
+
+    void SetObserver(RequestObserver observer) { observer_ = observer; }
+
+    const std::string& SessionId() const { return sessionId_; }
+    const std::string& AppId() const { return appId_; }
+    const std::string& CurrentUser() const { return currentUser_; }
+    bool ServerBatch() const { return serverBatch_; }  // server advertises /auth/activate-batch
+    bool ServerPayloadBatch() const { return serverPayloadBatch_; }  // server advertises /auth/payload/batch
+
+    // Progress is written to `out` so the startup pipeline can run this in
+    // the background and print the log once the user is done typing.
+    bool Initialize(std::ostream& out) {
+        trace::Scope scope("InitializeAuth");
+        out << "[*] Initializing authentication..." << std::endl;
+
+        if (Resume(out)) return true;
+
+        const std::string& postData = json::Writer(RequestBuffer())
+            .Members(initMembers_)
+            .Finish();
+
+        std::string response = Post("/auth/init", postData);
+
+        json::Document doc;
+        doc.Parse(response);
+
+        // Parse session_id
+        if (doc.Find("session_id")) {
+            sessionId_ = doc.String("session_id");
+            out << "[+] Session initialized: " << sessionId_.substr(0, 8) << "..." << std::endl;
+
+            // Parse appId
+            if (doc.Find("appId")) {
+                std::lock_guard<std::mutex> lock(appMutex_);
+                appId_ = doc.String("appId");
+                out << "[+] App ID: " << appId_ << std::endl;
+            }
+
+            // Optional server capabilities
+            serverBatch_ = doc.ArrayContains("features", "batch");
+            serverTelemetry_ = doc.ArrayContains("features", "telemetry");
+            serverPayloadBatch_ = doc.ArrayContains("features", "payload-batch");
+
+            // Remember the session so the next launch can resume it
+            if (sessionCache_ && doc.Find("session_sig")) {
+                CachedSession session;
+                session.sessionId = sessionId_;
+                session.appId = appId_;
+                session.signature = doc.String("session_sig");
+                session.expiresAt = doc.Int("expires_at");
+                sessionCache_->Save(sessionCacheKey_, session);
+            }
+
+            StartTelemetry();
+            return true;
+        }
+
+        out << "[-] Failed to initialize. Response: " << response << std::endl;
+        return false;
+    }
+
+    bool Initialize() { return Initialize(out_); }
+
+    // Checks the stored lease for this subject, machine and app, offline.
+    // Valid means the caller may treat the user as authenticated; Renew
+    // means the regular online check should run, with FallBackToLease() as
+    // the way out when the server can't be reached. May run while
+    // Initialize() is still going; see LeaseAppId().
+    LeaseStatus CheckLease(const char* kind, const std::string& subject, const std::string& password,
+                           const std::string& hwid) {
+        if (!leases_) return LeaseStatus::Missing;
+        trace::Scope scope("CheckLease");
+
+        LicenseLease lease;
+        LeaseStatus status = leases_->Check(leaseKey_, leasePublicKey_,
+                                            { kind, LeaseAppId(), subject, hwid, password }, lease);
+        if (status == LeaseStatus::Missing) return status;
+
+        long long hoursLeft = (lease.leaseExpires - LeaseStore::NowMs() + 60 * 60 * 1000 - 1) / (60 * 60 * 1000);
+        if (status == LeaseStatus::Valid) {
+            if (strcmp(kind, lease_kind::kLogin) == 0) currentUser_ = subject;
+            out_ << "[+] License lease valid for " << hoursLeft << " more hour(s), verified offline" << std::endl;
+        } else {
+            out_ << "[*] License lease ends in " << hoursLeft << " hour(s), revalidating online..." << std::endl;
+            fallbackLease_ = lease;
+            fallbackKind_ = kind;
+            fallbackSubject_ = subject;
+        }
+        return status;
+    }
+
+    // Accepts the lease CheckLease() reported as Renew, unless the server
+    // refused the credentials since. For when the online check got no answer.
+    bool FallBackToLease() {
+        if (!leases_ || fallbackKind_ == nullptr) return false;
+        if (LeaseStore::NowMs() >= fallbackLease_.leaseExpires) return false;
+        if (strcmp(fallbackKind_, lease_kind::kLogin) == 0) currentUser_ = fallbackSubject_;
+        leases_->CountFallback();
+        out_ << "[*] Server unavailable, continuing on the license lease" << std::endl;
+        return true;
+    }
+
+    bool Login(const std::string& username, const std::string& password) {
+        trace::Scope scope("Login");
+        if (sessionId_.empty()) {
+            out_ << "[-] Session not initialized!" << std::endl;
+            return false;
+        }
+
+        out_ << "[*] Logging in as " << username << "..." << std::endl;
+
+        const std::string& postData = json::Writer(RequestBuffer())
+            .Member("username", username)
+            .Member("password", password)
+            .Member("session_id", sessionId_)
+            .Member("hwid", hardware_.hwid)
+            .Member("appId", appId_)
+            .Finish();
+
+        unsigned long status = 0;
+        std::string response = Post("/auth/login", postData, &status);
+
+        json::Document doc;
+        doc.Parse(response);
+        UpdateLease(doc, status, lease_kind::kLogin, username, password);
+
+        // Check for success
+        if (doc.Bool("success")) {
+            currentUser_ = username;
+            out_ << "[+] Login successful! Welcome, " << username << std::endl;
+            return true;
+        }
+
+        out_ << "[-] Login failed. Response: " << response << std::endl;
+        return false;
+    }
+
+    bool CheckLicense(const std::string& licenseKey) {
+        trace::Scope scope("CheckLicense");
+        if (sessionId_.empty()) {
+            out_ << "[-] Session not initialized!" << std::endl;
+            return false;
+        }
+
+        out_ << "[*] Checking license key..." << std::endl;
+
+        const std::string& postData = json::Writer(RequestBuffer())
+            .Member("key", licenseKey)
+            .Member("session_id", sessionId_)
+            .Member("hwid", hardware_.hwid)
+            .Member("appId", appId_)
+            .Finish();
+
+        unsigned long status = 0;
+        std::string response = Post("/auth/license", postData, &status);
+
+        json::Document doc;
+        doc.Parse(response);
+        UpdateLease(doc, status, lease_kind::kLicense, licenseKey, "");
+
+        if (doc.Bool("success")) {
+            out_ << "[+] License valid!" << std::endl;
+            return true;
+        }
+
+        out_ << "[-] Invalid license. Response: " << response << std::endl;
+        return false;
+    }
+
+    bool SendHWID(const std::string& licenseKey) {
+        trace::Scope scope("SendHWID");
+        if (sessionId_.empty() || appId_.empty()) {
+            out_ << "[-] Session not initialized!" << std::endl;
+            return false;
+        }
+
+        const std::string& postData = json::Writer(RequestBuffer())
+            .Member("appId", appId_)
+            .Member("key", licenseKey)
+            .Member("hwid", hardware_.hwid)
+            .Member("session_id", sessionId_)
+            .Finish();
+
+        std::string response = Post("/auth/hwid", postData);
+
+        if (IsSuccess(response)) {
+            out_ << "[+] HWID sent successfully" << std::endl;
+            return true;
+        }
+
+        out_ << "[-] Failed to send HWID" << std::endl;
+        return false;
+    }
+
+    bool SendComponents(const std::string& licenseKey) {
+        trace::Scope scope("SendComponents");
+        if (sessionId_.empty() || appId_.empty()) {
+            out_ << "[-] Session not initialized!" << std::endl;
+            return false;
+        }
+
+        out_ << "[*] Collecting hardware information..." << std::endl;
+        out_ << "[+] GPU: " << hardware_.gpu << std::endl;
+        out_ << "[+] Motherboard: " << hardware_.motherboard << std::endl;
+        out_ << "[+] CPU: " << hardware_.cpu << std::endl;
+
+        std::string eventId = TelemetryQueue::NewEventId();
+        const std::string& postData = json::Writer(RequestBuffer())
+            .Member("event_id", eventId)
+            .Member("type", kComponentsEvent)
+            .Member("occurred_at", std::to_string(LeaseStore::NowMs()))
+            .Member("appId", appId_)
+            .Member("key", licenseKey)
+            .Member("hwid", hardware_.hwid)
+            .Member("gpu", hardware_.gpu)
+            .Member("motherboard", hardware_.motherboard)
+            .Member("cpu", hardware_.cpu)
+            .Member("session_id", sessionId_)
+            .Finish();
+
+        if (telemetry_) {
+            telemetry_->Enqueue({ eventId, kComponentsEvent, postData });
+            out_ << "[+] Hardware components queued for registration" << std::endl;
+            return true;
+        }
+
+        std::string response = Post("/auth/components", postData);
+
+        if (IsSuccess(response)) {
+            out_ << "[+] Hardware components registered successfully" << std::endl;
+            return true;
+        }
+
+        out_ << "[-] Failed to register components" << std::endl;
+        return false;
+    }
+
+    bool SendLoginLog(const std::string& usernameOrKey) {
+        trace::Scope scope("SendLoginLog");
+        if (sessionId_.empty() || appId_.empty()) {
+            out_ << "[-] Session not initialized!" << std::endl;
+            return false;
+        }
+
+        std::string eventId = TelemetryQueue::NewEventId();
+        const std::string& postData = json::Writer(RequestBuffer())
+            .Member("event_id", eventId)
+            .Member("type", kLoginEvent)
+            .Member("occurred_at", std::to_string(LeaseStore::NowMs()))
+            .Member("appId", appId_)
+            .Member("username_or_key", usernameOrKey)
+            .Member("hwid", hardware_.hwid)
+            .Member("session_id", sessionId_)
+            .Finish();
+
+        if (telemetry_) {
+            telemetry_->Enqueue({ eventId, kLoginEvent, postData });
+            out_ << "[+] Login log queued" << std::endl;
+            return true;
+        }
+
+        std::string response = Post("/auth/log-login", postData);
+
+        if (IsSuccess(response)) {
+            out_ << "[+] Login logged successfully" << std::endl;
+            return true;
+        }
+
+        out_ << "[-] Failed to log login" << std::endl;
+        return false;
+    }
+
+    // Sends license check, HWID binding, component registration and login log
+    // as one request (one round trip instead of four). Returns true when the
+    // license itself was accepted.
+    bool ActivateLicenseBatch(const std::string& licenseKey) {
+        trace::Scope scope("ActivateLicenseBatch");
+        if (sessionId_.empty() || appId_.empty()) {
+            out_ << "[-] Session not initialized!" << std::endl;
+            return false;
+        }
+
+        out_ << "[*] Checking license key..." << std::endl;
+
+        const std::string& postData = json::Writer(RequestBuffer())
+            .Member("appId", appId_)
+            .Member("key", licenseKey)
+            .Member("hwid", hardware_.hwid)
+            .Member("gpu", hardware_.gpu)
+            .Member("motherboard", hardware_.motherboard)
+            .Member("cpu", hardware_.cpu)
+            .Member("session_id", sessionId_)
+            .Finish();
+
+        unsigned long status = 0;
+        std::string response = Post("/auth/activate-batch", postData, &status);
+
+        json::Document doc;
+        doc.Parse(response);
+        UpdateLease(doc, status, lease_kind::kLicense, licenseKey, "");
+
+        // Top-level success mirrors the license step
+        if (!doc.Bool("success")) {
+            out_ << "[-] Invalid license. Response: " << response << std::endl;
+            return false;
+        }
+        out_ << "[+] License valid!" << std::endl;
+
+        if (doc.Bool("hwid.success"))
+            out_ << "[+] HWID sent successfully" << std::endl;
+        else
+            out_ << "[-] Failed to send HWID" << std::endl;
+
+        out_ << "[+] GPU: " << hardware_.gpu << std::endl;
+        out_ << "[+] Motherboard: " << hardware_.motherboard << std::endl;
+        out_ << "[+] CPU: " << hardware_.cpu << std::endl;
+        if (doc.Bool("components.success"))
+            out_ << "[+] Hardware components registered successfully" << std::endl;
+        else
+            out_ << "[-] Failed to register components" << std::endl;
+
+        if (doc.Bool("log.success"))
+            out_ << "[+] Login logged successfully" << std::endl;
+        else
+            out_ << "[-] Failed to log login" << std::endl;
+
+        return true;
+    }
+
+    // Asks for a signed download URL for `productName`. With `cachedEtag`
+    // set, newer servers answer notModified instead when it is current.
+    // With `baseSha256` (the hash of the cached copy) set, they may also
+    // offer a patch from that copy (delta.h). Returns false when the server
+    // gave neither.
+    bool RequestPayload(const std::string& licenseKey, const std::string& productName,
+                        const std::string& cachedEtag, const std::string& baseSha256, PayloadTicket& ticket) {
+        trace::Scope scope("RequestPayload");
+        json::Writer body(RequestBuffer());
+        body.Member("appId", appId_)
+            .Member("key", licenseKey)
+            .Member("hwid", hardware_.hwid)
+            .Member("productName", productName)
+            .Member("session_id", sessionId_);
+        if (!cachedEtag.empty()) body.Member("cachedEtag", cachedEtag);
+        if (!baseSha256.empty()) body.Member("baseSha256", baseSha256);
+        const std::string& postData = body.Finish();
+
+        ticket.response = Post("/auth/payload/stream", postData);
+
+        json::Document doc;
+        doc.Parse(ticket.response);
+        return ReadTicket(doc, "", !cachedEtag.empty(), ticket);
+    }
+
+    // Asks for the signed URLs of several products in one call (servers
+    // with ServerPayloadBatch(), at most kMaxBatchProducts). `tickets` gets
+    // one entry per product, in order; `granted` tells which ones the
+    // server answered with a URL or notModified. Returns false when the
+    // call itself failed.
+    bool RequestPayloads(const std::string& licenseKey, const std::vector<PayloadRequest>& products,
+                         std::vector<PayloadTicket>& tickets, std::vector<bool>& granted) {
+        trace::Scope scope("RequestPayloads");
+        std::string list = "\"products\":[";
+        std::string item;
+        for (size_t i = 0; i < products.size(); i++) {
+            json::Writer writer(item);
+            writer.Member("productName", products[i].productName);
+            if (!products[i].cachedEtag.empty()) writer.Member("cachedEtag", products[i].cachedEtag);
+            if (!products[i].baseSha256.empty()) writer.Member("baseSha256", products[i].baseSha256);
+            if (i > 0) list += ',';
+            list += writer.Finish();
+        }
+        list += ']';
+        const std::string& postData = json::Writer(RequestBuffer())
+            .Member("appId", appId_)
+            .Member("key", licenseKey)
+            .Member("hwid", hardware_.hwid)
+            .Member("session_id", sessionId_)
+            .Members(list)
+            .Finish();
+
+        std::string response = Post("/auth/payload/batch", postData);
+        json::Document doc;
+        doc.Parse(response);
+        tickets.assign(products.size(), PayloadTicket());
+        granted.assign(products.size(), false);
+        if (!doc.Bool("success")) {
+            for (PayloadTicket& ticket : tickets) ticket.response = response;
+            return false;
+        }
+
+        for (size_t i = 0; i < products.size(); i++) {
+            std::string prefix = "products." + std::to_string(i) + ".";
+            // Answers carry the product name; a mismatch means a confused server
+            if (doc.String(prefix + "productName") != products[i].productName) {
+                tickets[i].response = "Missing from the batch answer";
+                continue;
+            }
+            tickets[i].response = doc.String(prefix + "message");
+            granted[i] = ReadTicket(doc, prefix, !products[i].cachedEtag.empty(), tickets[i]);
+        }
+        return true;
+    }
+
+private:
+    // Fills `ticket` from the /auth/payload/stream answer at `prefix` ("" or
+    // "products.<i>."); true when it holds a URL or notModified.
+    static bool ReadTicket(const json::Document& doc, const std::string& prefix, bool sentEtag, PayloadTicket& ticket) {
+        ticket.notModified = sentEtag && doc.Bool(prefix + "notModified");
+        ticket.downloadUrl = doc.String(prefix + "downloadUrl");
+        ticket.etag = doc.String(prefix + "etag");
+        ticket.sha256 = doc.String(prefix + "sha256");
+        ticket.size = (unsigned long long)doc.Int(prefix + "size");
+        ticket.patchUrl = doc.String(prefix + "patchUrl");
+        ticket.patchSize = (unsigned long long)doc.Int(prefix + "patchSize");
+        return ticket.notModified || !ticket.downloadUrl.empty();
+    }
+
+    // Request bodies are written into a per-thread buffer that keeps its
+    // capacity, so building a body does not allocate once it is warm.
+    static std::string& RequestBuffer() {
+        thread_local std::string buffer;
+        if (buffer.capacity() < kRequestBufferSize) buffer.reserve(kRequestBufferSize);
+        return buffer;
+    }
+
+    // True when the server replied with "success": true.
+    static bool IsSuccess(const std::string& response) {
+        json::Document doc;
+        doc.Parse(response);
+        return doc.Bool("success");
+    }
+
+    // Every call may be retried except those whose replay would be recorded
+    // twice (login logs, which activate-batch also writes).
+    static RequestPolicy PolicyFor(const char* endpoint) {
+        RequestPolicy policy = RequestPolicy::Idempotent();
+        policy.deadlineMs = kRequestDeadlineMs;
+        if (strcmp(endpoint, "/auth/log-login") == 0 || strcmp(endpoint, "/auth/activate-batch") == 0) {
+            policy.idempotent = false;
+        }
+        // The telemetry queue retries on its own schedule and keeps the events meanwhile
+        if (strcmp(endpoint, "/auth/telemetry") == 0) policy.maxAttempts = 1;
+        return policy;
+    }
+
+    void StartTelemetry() {
+        if (!telemetry_) return;
+        telemetry_->Start([this](std::vector<TelemetryEvent>& batch, const std::atomic<bool>* cancel) {
+            SendTelemetry(batch, cancel);
+        });
+    }
+
+    // Delivers a batch in one POST /auth/telemetry, or event by event to
+    // the individual endpoints on servers without it. Events the server
+    // answered (other than 5xx/429) are removed from `batch`.
+    void SendTelemetry(std::vector<TelemetryEvent>& batch, const std::atomic<bool>* cancel) {
+        trace::Scope scope("SendTelemetry");
+        unsigned long status = 0;
+        if (!serverTelemetry_) {
+            for (size_t i = 0; i < batch.size() && !*cancel;) {
+                const char* endpoint = batch[i].type == kLoginEvent ? "/auth/log-login" : "/auth/components";
+                Post(endpoint, batch[i].json, &status, cancel);
+                if (status != 0 && status < 500 && status != 429) batch.erase(batch.begin() + i);
+                else i++;
+            }
+            return;
+        }
+
+        std::string events = "\"events\":[";
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (i > 0) events += ',';
+            events += batch[i].json;
+        }
+        events += ']';
+        std::string postData = json::Writer(RequestBuffer())
+            .Member("appId", appId_)
+            .Member("session_id", sessionId_)
+            .Members(events)
+            .Finish();
+
+        std::string response = Post("/auth/telemetry", postData, &status, cancel);
+        if (status == 0 || status >= 500 || status == 429) return;
+
+        // A refused batch is not retried; a 2xx lists the events to send again
+        json::Document doc;
+        doc.Parse(response);
+        batch.erase(std::remove_if(batch.begin(), batch.end(), [&](const TelemetryEvent& event) {
+            return !doc.ArrayContains("retry", event.id);
+        }), batch.end());
+    }
+
+    // The app a lease must be issued for: this session's, or while
+    // Initialize() hasn't set it yet, the one the session cache last
+    // recorded. "" (no lease matches) when neither is known.
+    std::string LeaseAppId() {
+        {
+            std::lock_guard<std::mutex> lock(appMutex_);
+            if (!appId_.empty()) return appId_;
+        }
+        return sessionCache_ ? sessionCache_->AppId(sessionCacheKey_) : "";
+    }
+
+    // Stores the lease from a successful check; forgets the stored one when
+    // the server refused the credentials (4xx other than throttling).
+    void UpdateLease(const json::Document& doc, unsigned long status, const char* kind,
+                     const std::string& subject, const std::string& password) {
+        if (!leases_) return;
+        if (doc.Bool("success")) {
+            if (!doc.Has("lease.payload")) return;
+            LicenseLease lease;
+            lease.payload = doc.String("lease.payload");
+            lease.signature = doc.String("lease.sig");
+            if (!leases_->Save(leaseKey_, leasePublicKey_, { kind, appId_, subject, hardware_.hwid, password }, lease)) {
+                out_ << "[-] Server lease did not verify, not stored" << std::endl;
+            }
+        } else if (status >= 400 && status < 500 && status != 429) {
+            leases_->Clear();
+            fallbackKind_ = nullptr;
+        }
+    }
+
+    // `status` receives the HTTP status (0 when there was no answer).
+    std::string Post(const char* endpoint, const std::string& body, unsigned long* status = NULL,
+                     const std::atomic<bool>* cancel = nullptr) {
+        auto started = std::chrono::steady_clock::now();
+        HttpRequest request;
+        request.method = "POST";
+        request.url = apiUrl_ + endpoint;
+        request.body = body;
+        request.cancel = cancel;
+        request.headers.push_back({ "Content-Type", "application/json" });
+        HttpResponse response = policy::Send(request, PolicyFor(endpoint));
+        if (status) *status = response.status;
+        if (observer_) {
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+            observer_(endpoint, ms, response.ok());
+        }
+        return response.body;
+    }
+
+    // Resumes the session saved by a previous launch. Returns false when there
+    // is none or the server no longer accepts it.
+    bool Resume(std::ostream& out) {
+        if (!sessionCache_) return false;
+
+        CachedSession cached;
+        if (!sessionCache_->Load(sessionCacheKey_, cached)) {
+            sessionCache_->CountMiss();
+            return false;
+        }
+
+        const std::string& postData = json::Writer(RequestBuffer())
+            .Member("session_id", cached.sessionId)
+            .Member("appId", cached.appId)
+            .Member("expires_at", std::to_string(cached.expiresAt))
+            .Member("session_sig", cached.signature)
+            .Member("version", version_)
+            .Finish();
+
+        std::string response = Post("/auth/session/resume", postData);
+
+        json::Document doc;
+        doc.Parse(response);
+
+        if (!doc.Bool("success")) {
+            // Only forget the session when the server actually refused it
+            if (doc.Has("success")) {
+                sessionCache_->Clear();
+                sessionCache_->CountRejected();
+            }
+            return false;
+        }
+
+        sessionId_ = cached.sessionId;
+        {
+            std::lock_guard<std::mutex> lock(appMutex_);
+            appId_ = cached.appId;
+        }
+        serverBatch_ = doc.ArrayContains("features", "batch");
+        serverTelemetry_ = doc.ArrayContains("features", "telemetry");
+        serverPayloadBatch_ = doc.ArrayContains("features", "payload-batch");
+        sessionCache_->CountHit();
+        out << "[+] Session resumed: " << sessionId_.substr(0, 8) << "..." << std::endl;
+        StartTelemetry();
+        return true;
+    }
+
+    std::string apiUrl_;
+    std::string initMembers_;
+    std::string version_;
+    std::ostream& out_;
+    HardwareInfo hardware_;
+    SessionCache* sessionCache_ = nullptr;
+    std::string sessionCacheKey_;
+    RequestObserver observer_;
+    LeaseStore* leases_ = nullptr;
+    std::string leaseKey_;
+    std::string leasePublicKey_;
+    TelemetryQueue* telemetry_ = nullptr;
+    LicenseLease fallbackLease_;          // lease left from CheckLease() when it said Renew
+    const char* fallbackKind_ = nullptr;
+    std::string fallbackSubject_;
+
+    std::string sessionId_;
+    std::string appId_;
+    std::mutex appMutex_;                 // appId_ may be set while CheckLease() reads it
+    std::string currentUser_;
+    bool serverBatch_ = false;
+    bool serverTelemetry_ = false;  // server advertises /auth/telemetry
+    bool serverPayloadBatch_ = false;
+};
@@ -0,0 +1,989 @@
+// Microbenchmarks for the loader's hot paths (Google Benchmark).
+// Build and run with compile_bench.sh.
+//
+// Besides the usual --benchmark_* flags:
+//   --save-baseline=FILE         store this run's timings
+//   --baseline=FILE              compare against stored timings; exit code 1
+//                                when a benchmark regressed
+//   --regression-threshold=PCT   slowdown that counts as a regression (default 10)
+
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <new>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include "json.h"
+#include "text_codec.h"
+#include "hardware.h"
+#include "http_client.h"
+#include "auth_client.h"
+
+// --- ALLOCATION COUNTING ---
+
+// Every global operator new/delete form is replaced, all of them going
+// through CountedAllocate()/CountedFree(). Those stay out of line so the
+// compiler never pairs an inlined free() with a call to operator new.
+
+static std::atomic<unsigned long long> g_allocations(0);
+
+__attribute__((noinline)) static void* CountedAllocate(size_t size, size_t alignment) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) return malloc(size);
+    void* p = nullptr;
+    return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+}
+
+__attribute__((noinline)) static void CountedFree(void* p) noexcept { free(p); }
+
+static void* CountedAllocateOrThrow(size_t size, size_t alignment) {
+    if (void* p = CountedAllocate(size, alignment)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size) { return CountedAllocateOrThrow(size, 0); }
+void* operator new[](size_t size) { return CountedAllocateOrThrow(size, 0); }
+void* operator new(size_t size, std::align_val_t a) { return CountedAllocateOrThrow(size, (size_t)a); }
+void* operator new[](size_t size, std::align_val_t a) { return CountedAllocateOrThrow(size, (size_t)a); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return CountedAllocate(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return CountedAllocate(size, 0); }
+void* operator new(size_t size, std::align_val_t a, const std::nothrow_t&) noexcept { return CountedAllocate(size, (size_t)a); }
+void* operator new[](size_t size, std::align_val_t a, const std::nothrow_t&) noexcept { return CountedAllocate(size, (size_t)a); }
+
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { CountedFree(p); }
+
+// Reports heap allocations per iteration for the benchmark loop.
+class AllocationCounter {
+public:
+    explicit AllocationCounter(benchmark::State& state) : state_(state), start_(g_allocations.load()) {}
+    ~AllocationCounter() {
+        double allocations = (double)(g_allocations.load() - start_);
+        state_.counters["allocs/req"] = benchmark::Counter(allocations / (double)state_.iterations());
+    }
+
+private:
+    benchmark::State& state_;
+    unsigned long long start_;
+};
+
+// --- FIXTURES ---
+
+static const std::string kInitResponse =
+    "{\"success\":true,\"message\":\"Initialized\",\"features\":[\"batch\"],"
+    "\"session_id\":\"c3b88b47cd7601326f6d33e099363909\",\"appId\":\"Zq8v1rX2bYkP0aL3mN4c\","
+    "\"app_info\":{\"numUsers\":1532,\"numOnlineUsers\":0,\"version\":\"1.0\"}}";
+
+static const std::string kExpiryResponse =
+    "{\"success\":true,\"expires_at\":\"2026-11-17T02:37:56.545Z\",\"days_remaining\":30,"
+    "\"is_expired\":false,\"subscription_type\":\"license\",\"level\":1}";
+
+// --- LEGACY (find()-based, as used before json.h) ---
+
+static std::string LegacyGetJsonValue(const std::string& json, const std::string& key) {
+    std::string searchKey = "\"" + key + "\":";
+    size_t pos = json.find(searchKey);
+    if (pos == std::string::npos) return "";
+
+    pos += searchKey.length();
+    while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\"')) pos++;
+
+    size_t end = pos;
+    bool inString = json[pos - 1] == '\"';
+    if (inString) {
+        end = json.find('\"', pos);
+    } else {
+        while (end < json.length() && json[end] != ',' && json[end] != '}' && json[end] != ' ') end++;
+    }
+    if (end == std::string::npos) return "";
+    return json.substr(pos, end - pos);
+}
+
+static std::string LegacySessionId(const std::string& response) {
+    size_t pos = response.find("\"session_id\":\"");
+    if (pos == std::string::npos) return "";
+    pos += 14;
+    size_t endPos = response.find("\"", pos);
+    return response.substr(pos, endPos - pos);
+}
+
+// --- JSON EXTRACTION ---
+
+static void BM_Expiry_LegacyFind(benchmark::State& state) {
+    for (auto _ : state) {
+        bool success = LegacyGetJsonValue(kExpiryResponse, "success") == "true";
+        std::string expiresAt = LegacyGetJsonValue(kExpiryResponse, "expires_at");
+        std::string days = LegacyGetJsonValue(kExpiryResponse, "days_remaining");
+        std::string expired = LegacyGetJsonValue(kExpiryResponse, "is_expired");
+        std::string level = LegacyGetJsonValue(kExpiryResponse, "level");
+        benchmark::DoNotOptimize(success);
+        benchmark::DoNotOptimize(expiresAt);
+        benchmark::DoNotOptimize(days);
+        benchmark::DoNotOptimize(expired);
+        benchmark::DoNotOptimize(level);
+    }
+}
+BENCHMARK(BM_Expiry_LegacyFind);
+
+static void BM_Expiry_JsonDocument(benchmark::State& state) {
+    json::Document doc;
+    for (auto _ : state) {
+        doc.Parse(kExpiryResponse);
+        bool success = doc.Bool("success");
+        std::string_view expiresAt = doc.View("expires_at");
+        std::string_view days = doc.View("days_remaining");
+        bool expired = doc.Bool("is_expired");
+        std::string_view level = doc.View("level");
+        benchmark::DoNotOptimize(success);
+        benchmark::DoNotOptimize(expiresAt);
+        benchmark::DoNotOptimize(days);
+        benchmark::DoNotOptimize(expired);
+        benchmark::DoNotOptimize(level);
+    }
+}
+BENCHMARK(BM_Expiry_JsonDocument);
+
+static void BM_Init_LegacyFind(benchmark::State& state) {
+    for (auto _ : state) {
+        std::string sessionId = LegacySessionId(kInitResponse);
+        size_t pos = kInitResponse.find("\"appId\":\"") + 9;
+        std::string appId = kInitResponse.substr(pos, kInitResponse.find("\"", pos) - pos);
+        pos = kInitResponse.find("\"features\":[");
+        bool batch = kInitResponse.find("\"batch\"", pos) < kInitResponse.find("]", pos);
+        benchmark::DoNotOptimize(sessionId);
+        benchmark::DoNotOptimize(appId);
+        benchmark::DoNotOptimize(batch);
+    }
+}
+BENCHMARK(BM_Init_LegacyFind);
+
+static void BM_Init_JsonDocument(benchmark::State& state) {
+    json::Document doc;
+    for (auto _ : state) {
+        doc.Parse(kInitResponse);
+        std::string_view sessionId = doc.View("session_id");
+        std::string_view appId = doc.View("appId");
+        bool batch = doc.ArrayContains("features", "batch");
+        benchmark::DoNotOptimize(sessionId);
+        benchmark::DoNotOptimize(appId);
+        benchmark::DoNotOptimize(batch);
+    }
+}
+BENCHMARK(BM_Init_JsonDocument);
+
+// --- URL ENCODING ---
+
+static const std::wstring kAppSecret = L"00347ecb6ab1084f15649e13aed2ba1d4e2693a81ba0b97ef3ec79943fd2a0fa";
+static const std::wstring kQueryValue = L"Scarlet External v1.0 (beta) & friends/test?x=1";
+static const std::wstring kUserInfoPath =
+    L"/auth/get-user-info/Scarlet External/DESKTOP-7H2K9Q1-gamer-0000000F756E6547?appSecret=" + kAppSecret;
+
+static void BM_UrlEncode_Secret(benchmark::State& state) {
+    for (auto _ : state) {
+        std::wstring encoded = UrlEncode(kAppSecret);
+        benchmark::DoNotOptimize(encoded);
+    }
+    state.SetBytesProcessed(state.iterations() * kAppSecret.size());
+}
+BENCHMARK(BM_UrlEncode_Secret);
+
+static void BM_UrlEncode_Escaped(benchmark::State& state) {
+    for (auto _ : state) {
+        std::wstring encoded = UrlEncode(kQueryValue);
+        benchmark::DoNotOptimize(encoded);
+    }
+    state.SetBytesProcessed(state.iterations() * kQueryValue.size());
+}
+BENCHMARK(BM_UrlEncode_Escaped);
+
+static void BM_EncodeUrlPath(benchmark::State& state) {
+    for (auto _ : state) {
+        std::string url = "http://localhost:80";
+        EncodeUrlPath(kUserInfoPath, url);
+        benchmark::DoNotOptimize(url);
+    }
+    state.SetBytesProcessed(state.iterations() * kUserInfoPath.size());
+}
+BENCHMARK(BM_EncodeUrlPath);
+
+// The swprintf-per-byte encoder index.cpp had before text_codec.h
+static std::wstring LegacyUrlEncode(const std::wstring& str) {
+    std::wstring encoded;
+    for (wchar_t c : str) {
+        if (iswalnum(c) || c == L'-' || c == L'_' || c == L'.' || c == L'~') {
+            encoded += c;
+        } else {
+            wchar_t buf[4];
+            swprintf(buf, 4, L"%%%02X", (unsigned char)c);
+            encoded += buf;
+        }
+    }
+    return encoded;
+}
+
+static void BM_UrlEncode_LegacySecret(benchmark::State& state) {
+    for (auto _ : state) {
+        std::wstring encoded = LegacyUrlEncode(kAppSecret);
+        benchmark::DoNotOptimize(encoded);
+    }
+    state.SetBytesProcessed(state.iterations() * kAppSecret.size());
+}
+BENCHMARK(BM_UrlEncode_LegacySecret);
+
+static void BM_UrlEncode_LegacyEscaped(benchmark::State& state) {
+    for (auto _ : state) {
+        std::wstring encoded = LegacyUrlEncode(kQueryValue);
+        benchmark::DoNotOptimize(encoded);
+    }
+    state.SetBytesProcessed(state.iterations() * kQueryValue.size());
+}
+BENCHMARK(BM_UrlEncode_LegacyEscaped);
+
+static void BM_UrlEncode_Utf8(benchmark::State& state) {
+    const std::string value = WideToUtf8(kQueryValue);
+    for (auto _ : state) {
+        std::string encoded = UrlEncode(value);
+        benchmark::DoNotOptimize(encoded);
+    }
+    state.SetBytesProcessed(state.iterations() * value.size());
+}
+BENCHMARK(BM_UrlEncode_Utf8);
+
+// --- TEXT CONVERSION ---
+
+static const std::string kAsciiText =
+    "{\"success\":true,\"username\":\"player_one\",\"expires_at\":\"2026-11-17T02:37:56.545Z\","
+    "\"days_remaining\":30,\"is_expired\":false,\"subscription_type\":\"license\",\"level\":1,"
+    "\"message\":\"Session resumed from cache; no network round trip was needed this time.\"}";
+
+static const std::string kMixedText =
+    "Usu\xC3\xA1rio Jo\xC3\xA3o Concei\xC3\xA7\xC3\xA3o \xE2\x80\x94 licen\xC3\xA7""a v\xC3\xA1lida at\xC3\xA9 "
+    "17/11, n\xC3\xADvel 1 \xF0\x9F\x8E\xAE \xE3\x83\x97\xE3\x83\xAC\xE3\x82\xA4\xE3\x83\xA4\xE3\x83\xBC "
+    "Sess\xC3\xA3o retomada do cache local, sem ida ao servidor desta vez.";
+
+// Argument: 0 = ASCII fixture, 1 = mixed-script fixture
+static const std::string& TextFixture(int64_t which) {
+    return which ? kMixedText : kAsciiText;
+}
+
+static void BM_Utf8ToWide_Legacy(benchmark::State& state) {
+    const std::string& text = TextFixture(state.range(0));
+    for (auto _ : state) {
+        std::wstring wide(text.begin(), text.end());
+        benchmark::DoNotOptimize(wide);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_Utf8ToWide_Legacy)->ArgName("mixed")->Arg(0)->Arg(1);
+
+template <typename Char, bool kVectorized>
+static void BM_FromUtf8(benchmark::State& state) {
+    const std::string& text = TextFixture(state.range(0));
+    for (auto _ : state) {
+        std::basic_string<Char> wide = text_codec::FromUtf8<Char, kVectorized>(text);
+        benchmark::DoNotOptimize(wide);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK_TEMPLATE(BM_FromUtf8, char16_t, false)->ArgName("mixed")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_FromUtf8, char16_t, true)->ArgName("mixed")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_FromUtf8, wchar_t, false)->ArgName("mixed")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_FromUtf8, wchar_t, true)->ArgName("mixed")->Arg(0)->Arg(1);
+
+template <typename Char, bool kVectorized>
+static void BM_ToUtf8(benchmark::State& state) {
+    const std::string& text = TextFixture(state.range(0));
+    const std::basic_string<Char> wide = text_codec::FromUtf8<Char>(text);
+    for (auto _ : state) {
+        std::string utf8 = text_codec::ToUtf8<Char, kVectorized>(wide);
+        benchmark::DoNotOptimize(utf8);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK_TEMPLATE(BM_ToUtf8, char16_t, false)->ArgName("mixed")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_ToUtf8, char16_t, true)->ArgName("mixed")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_ToUtf8, wchar_t, false)->ArgName("mixed")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_ToUtf8, wchar_t, true)->ArgName("mixed")->Arg(0)->Arg(1);
+
+// --- TEXT CODEC CHECKS ---
+// Run before the benchmarks: round trips over random valid text, the SSE2
+// paths against the scalar ones (malformed input included), and a few
+// fixed vectors. A failure stops the run.
+
+template <typename Char>
+static bool CheckCodecOn(const std::string& utf8, bool valid, std::string& failure) {
+    std::basic_string<Char> fast = text_codec::FromUtf8<Char, true>(utf8);
+    if (fast != text_codec::FromUtf8<Char, false>(utf8)) {
+        failure = "SSE2 and scalar decoding differ";
+        return false;
+    }
+    std::string back = text_codec::ToUtf8<Char, true>(fast);
+    if (back != text_codec::ToUtf8<Char, false>(fast)) {
+        failure = "SSE2 and scalar encoding differ";
+        return false;
+    }
+    // Malformed input comes back as U+FFFD, after which the text is stable
+    if (valid ? back != utf8 : text_codec::ToUtf8<Char>(text_codec::FromUtf8<Char>(back)) != back) {
+        failure = "round trip changed the text";
+        return false;
+    }
+    return true;
+}
+
+static bool CheckTextCodec(size_t& checked, std::string& failure) {
+    std::mt19937 rng(20241017);
+    auto below = [&rng](unsigned n) { return (unsigned)(rng() % n); };
+
+    // Random valid text, mostly ASCII, with runs long enough for the 16-byte blocks
+    for (int round = 0; round < 3000; round++) {
+        std::string utf8;
+        unsigned length = below(96);
+        for (unsigned i = 0; i < length; i++) {
+            char32_t cp;
+            unsigned kind = below(10);
+            if (kind < 7) cp = 0x20 + below(0x5F);
+            else if (kind == 7) cp = 0x80 + below(0x780);
+            else if (kind == 8) { do cp = 0x800 + below(0xF800); while (cp >= 0xD800 && cp <= 0xDFFF); }
+            else cp = 0x10000 + below(0x100000);
+            char bytes[4];
+            utf8.append(bytes, text_codec::EncodeUtf8(cp, bytes));
+        }
+        if (!CheckCodecOn<char16_t>(utf8, true, failure) || !CheckCodecOn<wchar_t>(utf8, true, failure)) return false;
+        checked++;
+    }
+
+    // Random bytes: invalid sequences, truncated tails, stray continuation bytes
+    for (int round = 0; round < 3000; round++) {
+        std::string bytes;
+        unsigned length = below(96);
+        for (unsigned i = 0; i < length; i++) bytes += (char)(below(4) ? 0x20 + below(0x5F) : 0x80 + below(0x80));
+        if (!CheckCodecOn<char16_t>(bytes, false, failure) || !CheckCodecOn<wchar_t>(bytes, false, failure)) return false;
+        checked++;
+    }
+
+    // Random UTF-16 with lone surrogates
+    for (int round = 0; round < 1000; round++) {
+        std::u16string units;
+        unsigned length = below(64);
+        for (unsigned i = 0; i < length; i++) units += (char16_t)(below(4) ? 0x20 + below(0x5F) : 0xD800 + below(0x800));
+        if (text_codec::ToUtf8<char16_t, true>(units) != text_codec::ToUtf8<char16_t, false>(units)) {
+            failure = "SSE2 and scalar encoding differ on lone surrogates";
+            return false;
+        }
+        checked++;
+    }
+
+    struct Vector {
+        const char* utf8;
+        std::u16string utf16;
+    };
+    const Vector vectors[] = {
+        { "a\xC3\xA7\xE2\x82\xAC\xF0\x9F\x98\x80", u"a\u00E7\u20AC\U0001F600" },
+        { "\xC0\x80", u"\uFFFD\uFFFD" },                        // overlong NUL
+        { "\xED\xA0\x80", u"\uFFFD\uFFFD\uFFFD" },              // encoded surrogate
+        { "\xF4\x90\x80\x80", u"\uFFFD\uFFFD\uFFFD\uFFFD" },    // past U+10FFFF
+        { "\xF0\x9F\x98", u"\uFFFD" },                          // truncated
+        { "\xE2\x82x", u"\uFFFDx" },
+    };
+    for (const Vector& v : vectors) {
+        if (Utf8ToUtf16(v.utf8) != v.utf16) {
+            failure = "wrong decoding of vector " + std::to_string(&v - vectors);
+            return false;
+        }
+        checked++;
+    }
+    if (Utf16ToUtf8(u"x\xD800y\xDC00") != "x\xEF\xBF\xBDy\xEF\xBF\xBD") {
+        failure = "lone surrogates are not replaced";
+        return false;
+    }
+    if (UrlEncode(std::string("a\xC3\xA7\xC3\xA3o & x-_.~")) != "a%C3%A7%C3%A3o%20%26%20x-_.~" ||
+        UrlEncode(L"Jo\u00E3o/1") != L"Jo%C3%A3o%2F1") {
+        failure = "wrong URL encoding";
+        return false;
+    }
+    std::string url = "http://h";
+    EncodeUrlPath(L"/a b/\u00E7?q=1", url);
+    if (url != "http://h/a%20b/%C3%A7?q=1") {
+        failure = "wrong path encoding";
+        return false;
+    }
+    checked += 4;
+    return true;
+}
+
+// --- LEASE CHECKS ---
+// Run with the text codec checks: a lease signed for another app must not
+// authenticate, whether the app id comes from the session or, before init
+// finishes, from the session cache. The leases are signed with a test key.
+
+static const char kTestLeaseKey[] = "ea4a6c63e29c520abef5507b132ec5f9954776aebebe7b92421eea691446d22c";
+
+static LicenseLease TestLease(const char* appId, const char* signature) {
+    LicenseLease lease;
+    lease.payload = std::string("{\"v\":1,\"kind\":\"license\",\"appId\":\"") + appId +
+        "\",\"subject\":\"KEY-1\",\"hwid\":\"HWID-1\",\"username\":\"KEY-1\",\"level\":1,"
+        "\"expires_ms\":4102444800000,\"issued_at\":1700000000000,\"lease_expires\":4102444800000}";
+    lease.signature = signature;
+    return lease;
+}
+
+static bool CheckLeases(size_t& checked, std::string& failure) {
+    LicenseLease leaseA = TestLease("app-a",
+        "8ac616c426d53893603ee09beabfb2dabcf72bf53c557dd7dd2327d045e279f9"
+        "98128c0c961dc36fb535a1002efaf4cb375af559eea13c3fcf8ecb463d17670c");
+    LicenseLease leaseB = TestLease("app-b",
+        "2692047a6c832b6e5241ff677f3383950c17c93a9939fba7d679abe2f2175317"
+        "a5ad0f6ae4cec8e8ebe06778e5b1c1c54f860906bdc6cb0671e715e89e323c0b");
+    std::string base = "/tmp/scarlet_bench_" + std::to_string(getpid());
+    std::string leasePath = base + ".lease", sessionPath = base + ".session";
+    auto done = [&](const char* message) {
+        std::remove(leasePath.c_str());
+        std::remove(sessionPath.c_str());
+        if (message) failure = message;
+        return message == nullptr;
+    };
+
+    LeaseStore store(leasePath);
+    LicenseLease found;
+    if (store.Save("k", kTestLeaseKey, { lease_kind::kLicense, "app-a", "KEY-1", "HWID-1", "" }, leaseB)) {
+        return done("a lease for another app was stored");
+    }
+    if (!store.Save("k", kTestLeaseKey, { lease_kind::kLicense, "app-a", "KEY-1", "HWID-1", "" }, leaseA)) {
+        return done("a lease for this app was not stored");
+    }
+    if (store.Check("k", kTestLeaseKey, { lease_kind::kLicense, "app-a", "KEY-1", "HWID-1", "" }, found) != LeaseStatus::Valid) {
+        return done("a lease for this app was rejected");
+    }
+    if (store.Check("k", kTestLeaseKey, { lease_kind::kLicense, "app-b", "KEY-1", "HWID-1", "" }, found) != LeaseStatus::Missing ||
+        store.Check("k", kTestLeaseKey, { lease_kind::kLicense, "", "KEY-1", "HWID-1", "" }, found) != LeaseStatus::Missing) {
+        return done("a lease for another app was accepted");
+    }
+    checked += 4;
+
+    // Before init: the app comes from the session cache, expired sessions included
+    SessionCache sessions(sessionPath);
+    std::ostringstream out;
+    AuthClient client("http://127.0.0.1:1", "", "1.0", out);
+    client.EnableSessionCache(&sessions, "s");
+    client.EnableLeases(&store, "k", kTestLeaseKey);
+    if (client.CheckLease(lease_kind::kLicense, "KEY-1", "", "HWID-1") != LeaseStatus::Missing) {
+        return done("a lease was accepted with no app known");
+    }
+    sessions.Save("s", { "session", "app-b", "sig", 1 });
+    if (client.CheckLease(lease_kind::kLicense, "KEY-1", "", "HWID-1") != LeaseStatus::Missing) {
+        return done("AuthClient accepted a lease for another app");
+    }
+    sessions.Save("s", { "session", "app-a", "sig", 1 });
+    if (client.CheckLease(lease_kind::kLicense, "KEY-1", "", "HWID-1") != LeaseStatus::Valid) {
+        return done("AuthClient rejected a lease for this app");
+    }
+    checked += 3;
+    return done(nullptr);
+}
+
+// --- WMIC OUTPUT PARSING ---
+
+static const std::string kWmicOutput =
+    "Name                                    \r\r\n"
+    "NVIDIA GeForce RTX 3070                 \r\r\n"
+    "\r\r\n";
+
+// The parser inside the old ExecCommand(), minus the pipe
+static std::string LegacyExecCommandParse(const std::string& result) {
+    std::string cleanResult = "";
+    std::stringstream ss(result);
+    std::string line;
+    int lineCount = 0;
+    while (getline(ss, line)) {
+        if (line.empty() || line.find_first_not_of(" \t\r\n") == std::string::npos) continue;
+        lineCount++;
+        if (lineCount == 2) {
+            size_t first = line.find_first_not_of(" \t\r\n");
+            size_t last = line.find_last_not_of(" \t\r\n");
+            if (first != std::string::npos && last != std::string::npos) {
+                cleanResult = line.substr(first, (last - first + 1));
+            }
+            break;
+        }
+    }
+    if (cleanResult.empty()) return "Unknown";
+    return cleanResult;
+}
+
+static void BM_Wmic_LegacyParse(benchmark::State& state) {
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        std::string value = LegacyExecCommandParse(kWmicOutput);
+        benchmark::DoNotOptimize(value);
+    }
+}
+BENCHMARK(BM_Wmic_LegacyParse);
+
+static void BM_Wmic_ParseValue(benchmark::State& state) {
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        std::string value = hardware::ParseWmicValue(kWmicOutput);
+        benchmark::DoNotOptimize(value);
+    }
+}
+BENCHMARK(BM_Wmic_ParseValue);
+
+// --- REQUEST BODIES ---
+
+static const std::string kAppId = "Zq8v1rX2bYkP0aL3mN4c";
+static const std::string kLicenseKey = "SCARLET-4F2A-99C1-7D0B";
+static const std::string kHwid = "DESKTOP-7H2K9Q1-gamer";
+static const std::string kGpu = "NVIDIA GeForce RTX 3070 \"OC\" Edition";
+static const std::string kMotherboard = "ROG STRIX B550-F GAMING (WI-FI)";
+static const std::string kCpu = "AMD Ryzen 7 5800X 8-Core Processor";
+static const std::string kSessionId = "c3b88b47cd7601326f6d33e099363909";
+
+static void BM_ComponentsBody_Concat(benchmark::State& state) {
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        std::string postData = "{\"appId\":\"" + kAppId + "\",\"key\":\"" + kLicenseKey +
+                               "\",\"hwid\":\"" + kHwid + "\",\"gpu\":\"" + kGpu +
+                               "\",\"motherboard\":\"" + kMotherboard + "\",\"cpu\":\"" + kCpu +
+                               "\",\"session_id\":\"" + kSessionId + "\"}";
+        benchmark::DoNotOptimize(postData);
+    }
+}
+BENCHMARK(BM_ComponentsBody_Concat);
+
+static void BM_ComponentsBody_Writer(benchmark::State& state) {
+    std::string buffer;
+    buffer.reserve(1024);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        const std::string& postData = json::Writer(buffer)
+            .Member("appId", kAppId)
+            .Member("key", kLicenseKey)
+            .Member("hwid", kHwid)
+            .Member("gpu", kGpu)
+            .Member("motherboard", kMotherboard)
+            .Member("cpu", kCpu)
+            .Member("session_id", kSessionId)
+            .Finish();
+        benchmark::DoNotOptimize(postData.data());
+    }
+}
+BENCHMARK(BM_ComponentsBody_Writer);
+
+static void BM_InitBody_Concat(benchmark::State& state) {
+    const std::string name = "Scarlet External", owner = "1", version = "1.0";
+    const std::string secret = "00347ecb6ab1084f15649e13aed2ba1d4e2693a81ba0b97ef3ec79943fd2a0fa";
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        std::string postData = "{\"name\":\"" + name + "\",\"ownerId\":\"" + owner +
+                               "\",\"secret\":\"" + secret + "\",\"version\":\"" + version + "\"}";
+        benchmark::DoNotOptimize(postData);
+    }
+}
+BENCHMARK(BM_InitBody_Concat);
+
+static void BM_InitBody_Fragment(benchmark::State& state) {
+    static constexpr auto kInit = json::Fragment<256>()
+        .Member("name", "Scarlet External")
+        .Member("ownerId", "1")
+        .Member("secret", "00347ecb6ab1084f15649e13aed2ba1d4e2693a81ba0b97ef3ec79943fd2a0fa")
+        .Member("version", "1.0");
+    std::string buffer;
+    buffer.reserve(1024);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        const std::string& postData = json::Writer(buffer).Members(kInit).Finish();
+        benchmark::DoNotOptimize(postData.data());
+    }
+}
+BENCHMARK(BM_InitBody_Fragment);
+
+// --- RESPONSE ACCUMULATION ---
+
+// Simulates reading an N-byte body in 4 KB chunks.
+static void BM_Accumulate_Legacy(benchmark::State& state) {
+    const size_t total = (size_t)state.range(0);
+    std::vector<char> chunk(4096, 'x');
+    for (auto _ : state) {
+        std::string response = "";
+        char buffer[4096];
+        for (size_t done = 0; done < total; done += 4095) {
+            size_t n = std::min<size_t>(4095, total - done);
+            memcpy(buffer, chunk.data(), n);
+            buffer[n] = 0;
+            response += buffer;
+        }
+        benchmark::DoNotOptimize(response);
+    }
+    state.SetBytesProcessed(state.iterations() * total);
+}
+BENCHMARK(BM_Accumulate_Legacy)->Arg(512)->Arg(64 * 1024)->Arg(1024 * 1024);
+
+static void BM_Accumulate_Reserved(benchmark::State& state) {
+    const size_t total = (size_t)state.range(0);
+    std::vector<char> chunk(8192, 'x');
+    for (auto _ : state) {
+        std::string response;
+        response.reserve(total);
+        for (size_t done = 0; done < total; done += 8192) {
+            response.append(chunk.data(), std::min<size_t>(8192, total - done));
+        }
+        benchmark::DoNotOptimize(response);
+    }
+    state.SetBytesProcessed(state.iterations() * total);
+}
+BENCHMARK(BM_Accumulate_Reserved)->Arg(512)->Arg(64 * 1024)->Arg(1024 * 1024);
+
+// --- LOOPBACK ROUND TRIP ---
+
+// Keep-alive HTTP/1.1 server on 127.0.0.1, one thread per connection.
+// "/bytes/N" answers N bytes, anything else the expiry response; request
+// bodies are read and dropped. Lives until the process exits, like the
+// client's pooled connections.
+class LoopbackServer {
+public:
+    static const size_t kMaxBody = 4 * 1024 * 1024;
+
+    static LoopbackServer& Instance() {
+        static LoopbackServer instance;
+        return instance;
+    }
+
+    bool Ok() const { return port_ != 0; }
+
+    std::string Url(const std::string& path) const {
+        return "http://127.0.0.1:" + std::to_string(port_) + path;
+    }
+
+private:
+    LoopbackServer() {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return;
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(fd, (sockaddr*)&addr, len) != 0 || listen(fd, 64) != 0 ||
+            getsockname(fd, (sockaddr*)&addr, &len) != 0) {
+            close(fd);
+            return;
+        }
+        port_ = ntohs(addr.sin_port);
+        std::thread([fd] {
+            for (;;) {
+                int client = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+                if (client >= 0) std::thread(&LoopbackServer::Serve, client).detach();
+                else if (errno != EINTR && errno != ECONNABORTED) return;
+            }
+        }).detach();
+    }
+
+    static bool SendAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            size -= (size_t)n;
+        }
+        return true;
+    }
+
+    static void Serve(int fd) {
+        static const std::string filler(kMaxBody, 'x');
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        std::string in;
+        char buffer[16384];
+        for (;;) {
+            size_t headEnd;
+            while ((headEnd = in.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+                if (n <= 0) {
+                    close(fd);
+                    return;
+                }
+                in.append(buffer, (size_t)n);
+            }
+
+            std::string head = in.substr(0, headEnd);
+            for (char& c : head) c = (char)tolower((unsigned char)c);
+            size_t bodyBytes = 0;
+            size_t lengthAt = head.find("\r\ncontent-length:");
+            if (lengthAt != std::string::npos) bodyBytes = strtoul(head.c_str() + lengthAt + 17, NULL, 10);
+            while (in.size() < headEnd + 4 + bodyBytes) {
+                ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+                if (n <= 0) {
+                    close(fd);
+                    return;
+                }
+                in.append(buffer, (size_t)n);
+            }
+
+            bool isHead = head.compare(0, 5, "head ") == 0;
+            size_t pathStart = head.find(' ') + 1;
+            std::string path = head.substr(pathStart, head.find(' ', pathStart) - pathStart);
+            in.erase(0, headEnd + 4 + bodyBytes);
+
+            const char* body = kExpiryResponse.data();
+            size_t size = kExpiryResponse.size();
+            if (path.compare(0, 7, "/bytes/") == 0) {
+                body = filler.data();
+                size = std::min<size_t>(strtoul(path.c_str() + 7, NULL, 10), kMaxBody);
+            }
+            std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                                   std::to_string(size) + "\r\n\r\n";
+            if (!SendAll(fd, response.data(), response.size()) || (!isHead && !SendAll(fd, body, size))) {
+                close(fd);
+                return;
+            }
+        }
+    }
+
+    unsigned short port_ = 0;
+};
+
+static void BM_HttpRoundTrip_Get(benchmark::State& state) {
+    LoopbackServer& server = LoopbackServer::Instance();
+    if (!server.Ok()) {
+        state.SkipWithError("loopback server did not start");
+        return;
+    }
+    const std::string url = server.Url("/auth/get-expiry/bench");
+    for (auto _ : state) {
+        HttpResponse response = HttpClient::Instance().Send(url, "GET");
+        if (response.status != 200) {
+            state.SkipWithError(("request failed: " + response.error).c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(response.body.data());
+    }
+}
+BENCHMARK(BM_HttpRoundTrip_Get)->UseRealTime();
+
+static void BM_HttpRoundTrip_Post(benchmark::State& state) {
+    LoopbackServer& server = LoopbackServer::Instance();
+    if (!server.Ok()) {
+        state.SkipWithError("loopback server did not start");
+        return;
+    }
+    const std::string url = server.Url("/auth/components");
+    std::string buffer;
+    for (auto _ : state) {
+        const std::string& postData = json::Writer(buffer)
+            .Member("appId", kAppId)
+            .Member("key", kLicenseKey)
+            .Member("hwid", kHwid)
+            .Member("gpu", kGpu)
+            .Member("motherboard", kMotherboard)
+            .Member("cpu", kCpu)
+            .Member("session_id", kSessionId)
+            .Finish();
+        HttpResponse response = HttpClient::Instance().Send(url, "POST", postData);
+        if (response.status != 200) {
+            state.SkipWithError(("request failed: " + response.error).c_str());
+            break;
+        }
+        json::Document doc;
+        doc.Parse(response.body);
+        bool success = doc.Bool("success");
+        benchmark::DoNotOptimize(success);
+    }
+}
+BENCHMARK(BM_HttpRoundTrip_Post)->UseRealTime();
+
+// The response accumulation above, through the real transport
+static void BM_HttpRoundTrip_Body(benchmark::State& state) {
+    LoopbackServer& server = LoopbackServer::Instance();
+    if (!server.Ok()) {
+        state.SkipWithError("loopback server did not start");
+        return;
+    }
+    const size_t total = (size_t)state.range(0);
+    const std::string url = server.Url("/bytes/" + std::to_string(total));
+    for (auto _ : state) {
+        HttpResponse response = HttpClient::Instance().Send(url, "GET");
+        if (response.status != 200 || response.body.size() != total) {
+            state.SkipWithError(("request failed: " + response.error).c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(response.body.data());
+    }
+    state.SetBytesProcessed(state.iterations() * total);
+}
+BENCHMARK(BM_HttpRoundTrip_Body)->Arg(64 * 1024)->Arg(1024 * 1024)->UseRealTime();
+
+// --- BASELINE ---
+
+// Baseline file: one benchmark per line, name \t nanoseconds per iteration.
+// CPU time is compared, wall time for the real-time benchmarks; with
+// --benchmark_repetitions, the median.
+class BaselineReporter : public benchmark::ConsoleReporter {
+public:
+    explicit BaselineReporter(OutputOptions options) : ConsoleReporter(options) {}
+
+    void ReportRuns(const std::vector<Run>& reports) override {
+        ConsoleReporter::ReportRuns(reports);
+        for (const Run& run : reports) {
+            if (run.error_occurred) continue;
+            bool median = run.run_type == Run::RT_Aggregate;
+            if (median && run.aggregate_name != "median") continue;
+            std::string name = run.run_name.str();
+            if (!median && medians_.count(name)) continue;
+
+            bool realTime = name.find("/real_time") != std::string::npos;
+            double time = realTime ? run.GetAdjustedRealTime() : run.GetAdjustedCPUTime();
+            results_[name] = time * 1e9 / benchmark::GetTimeUnitMultiplier(run.time_unit);
+            if (median) medians_.insert(name);
+        }
+    }
+
+    const std::map<std::string, double>& Results() const { return results_; }
+
+private:
+    std::map<std::string, double> results_;  // ns per iteration
+    std::set<std::string> medians_;
+};
+
+static bool LoadBaseline(const std::string& path, std::map<std::string, double>& baseline) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos || tab == 0) continue;
+        double ns = strtod(line.c_str() + tab + 1, NULL);
+        if (ns > 0) baseline[line.substr(0, tab)] = ns;
+    }
+    return true;
+}
+
+static bool SaveBaseline(const std::string& path, const std::map<std::string, double>& results) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) return false;
+    char value[32];
+    for (const auto& result : results) {
+        snprintf(value, sizeof(value), "%.3f", result.second);
+        out << result.first << '\t' << value << '\n';
+    }
+    return (bool)out;
+}
+
+// Prints the comparison; returns the number of regressions.
+static int CompareWithBaseline(const std::map<std::string, double>& results,
+                               const std::map<std::string, double>& baseline, double thresholdPercent) {
+    int regressions = 0;
+    printf("\n[*] Baseline comparison (threshold %.1f%%)\n", thresholdPercent);
+    printf("%-48s %14s %14s %9s\n", "Benchmark", "Baseline (ns)", "Now (ns)", "Change");
+    for (const auto& result : results) {
+        auto it = baseline.find(result.first);
+        if (it == baseline.end()) {
+            printf("%-48s %14s %14.1f %9s\n", result.first.c_str(), "-", result.second, "new");
+            continue;
+        }
+        double change = 100.0 * (result.second - it->second) / it->second;
+        const char* verdict = "";
+        if (change > thresholdPercent) {
+            verdict = "  REGRESSION";
+            regressions++;
+        } else if (change < -thresholdPercent) {
+            verdict = "  faster";
+        }
+        printf("%-48s %14.1f %14.1f %+8.1f%%%s\n", result.first.c_str(), it->second, result.second, change, verdict);
+    }
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    std::string baselinePath, savePath;
+    double threshold = 10;
+    // A reporter passed in ignores --benchmark_color, so it is applied here
+    bool color = isatty(STDOUT_FILENO);
+
+    // Takes our flags out of argv before Google Benchmark sees it
+    int kept = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--benchmark_color=false" || arg == "--benchmark_color=no") color = false;
+        if (arg.compare(0, 11, "--baseline=") == 0) baselinePath = arg.substr(11);
+        else if (arg.compare(0, 16, "--save-baseline=") == 0) savePath = arg.substr(16);
+        else if (arg.compare(0, 23, "--regression-threshold=") == 0) threshold = strtod(arg.c_str() + 23, NULL);
+        else argv[kept++] = argv[i];
+    }
+    argc = kept;
+    argv[argc] = NULL;
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty() && !LoadBaseline(baselinePath, baseline)) {
+        fprintf(stderr, "[-] Cannot read baseline %s\n", baselinePath.c_str());
+        return 1;
+    }
+
+    size_t checked = 0;
+    std::string failure;
+    if (!CheckTextCodec(checked, failure)) {
+        fprintf(stderr, "[-] text_codec.h check failed: %s\n", failure.c_str());
+        return 1;
+    }
+    printf("[+] text_codec.h: %zu checks passed\n", checked);
+
+    checked = 0;
+    if (!CheckLeases(checked, failure)) {
+        fprintf(stderr, "[-] license_lease.h check failed: %s\n", failure.c_str());
+        return 1;
+    }
+    printf("[+] license_lease.h: %zu checks passed\n", checked);
+
+    BaselineReporter reporter(color ? benchmark::ConsoleReporter::OO_Defaults : benchmark::ConsoleReporter::OO_Tabular);
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+
+    int status = 0;
+    if (!savePath.empty()) {
+        if (SaveBaseline(savePath, reporter.Results())) {
+            printf("[+] Baseline saved to %s (%zu benchmarks)\n", savePath.c_str(), reporter.Results().size());
+        } else {
+            fprintf(stderr, "[-] Cannot write baseline %s\n", savePath.c_str());
+            status = 1;
+        }
+    }
+    if (!baselinePath.empty()) {
+        int regressions = CompareWithBaseline(reporter.Results(), baseline, threshold);
+        if (regressions > 0) {
+            printf("[-] %d regression(s) above %.1f%%\n", regressions, threshold);
+            status = 1;
+        } else {
+            printf("[+] No regressions above %.1f%%\n", threshold);
+        }
+    }
+    return status;
+}
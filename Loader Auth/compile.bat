@@ -13,7 +13,7 @@ if %ERRORLEVEL% NEQ 0 (
 )
 
 echo [*] Compilando com g++...
-g++ main.cpp -o ScarletLoader_%date:~-4%%date:~3,2%%date:~0,2%_%time:~0,2%%time:~3,2%%time:~6,2%.exe -lwininet -static -O2
+g++ -std=c++17 main.cpp -o ScarletLoader_%date:~-4%%date:~3,2%%date:~0,2%_%time:~0,2%%time:~3,2%%time:~6,2%.exe -DSCARLET_ZLIB -DSCARLET_ZSTD -lwininet -lzstd -lz -static -O2
 
 if %ERRORLEVEL% EQU 0 (
     echo.
@@ -0,0 +1,17 @@
+#!/bin/sh
+# Builds and runs the loader microbenchmarks (Linux).
+# Requires Google Benchmark (Debian/Ubuntu: apt install libbenchmark-dev).
+# Arguments go to the benchmark, e.g.:
+#   ./compile_bench.sh --save-baseline=bench_baseline.txt
+#   ./compile_bench.sh --baseline=bench_baseline.txt --regression-threshold=15
+set -e
+cd "$(dirname "$0")"
+
+echo "========================================"
+echo "  Compilando Scarlet Loader Benchmarks"
+echo "========================================"
+
+g++ -std=c++17 -O2 -pthread $CXXFLAGS -o scarlet_bench bench.cpp $LDFLAGS -lbenchmark
+
+echo "[+] Executavel: scarlet_bench"
+./scarlet_bench "$@"
@@ -14,7 +14,7 @@ if %ERRORLEVEL% NEQ 0 (
 
 REM Compilar index.cpp
 echo [1/2] Compilando index.cpp...
-g++ -o ScarletMenuFetcher.exe index.cpp -lwininet -static -O2 -s
+g++ -std=c++17 -o ScarletMenuFetcher.exe index.cpp -DSCARLET_ZLIB -DSCARLET_ZSTD -lwininet -lzstd -lz -static -O2 -s
 
 if %errorlevel% neq 0 (
     echo.
@@ -5,7 +5,7 @@ echo ========================================
 echo.
 
 echo [1/2] Compilando index.cpp...
-g++ -o ScarletMenuFetcher.exe index.cpp -lwininet -static -O2 -s 2>&1
+g++ -std=c++17 -o ScarletMenuFetcher.exe index.cpp -lwininet -static -O2 -s 2>&1
 
 if %errorlevel% neq 0 (
     echo.
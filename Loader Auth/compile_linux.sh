@@ -0,0 +1,26 @@
+#!/bin/sh
+# Builds the loader, the menu fetcher and the load generator for Linux (epoll transport; https with OpenSSL).
+# CXXFLAGS / LDFLAGS are passed through (e.g. -I/-L for a zstd outside the default paths).
+set -e
+cd "$(dirname "$0")"
+
+echo "========================================"
+echo "  Compilando Scarlet Auth Loader (Linux)"
+echo "========================================"
+
+# Transferencias comprimidas: gzip (zlib) e zstd quando os headers existem
+CODECS=""
+if echo '#include <zlib.h>' | g++ $CXXFLAGS -E -x c++ - >/dev/null 2>&1; then CODECS="$CODECS -DSCARLET_ZLIB -lz"; fi
+if echo '#include <zstd.h>' | g++ $CXXFLAGS -E -x c++ - >/dev/null 2>&1; then CODECS="$CODECS -DSCARLET_ZSTD -lzstd"; fi
+echo "[*] Codecs:${CODECS:- nenhum}"
+
+# HTTPS (OpenSSL) quando os headers existem; sem ele so http://
+TLS=""
+if echo '#include <openssl/ssl.h>' | g++ $CXXFLAGS -E -x c++ - >/dev/null 2>&1; then TLS="-DSCARLET_OPENSSL -lssl -lcrypto"; fi
+if [ -n "$TLS" ]; then echo "[*] TLS: OpenSSL"; else echo "[*] TLS: nenhum (so http://)"; fi
+
+g++ -std=c++17 -O2 -pthread $CXXFLAGS -o scarlet_loader main.cpp $LDFLAGS $CODECS $TLS
+g++ -std=c++17 -O2 -pthread $CXXFLAGS -o scarlet_menu_fetcher index.cpp $LDFLAGS $CODECS $TLS
+g++ -std=c++17 -O2 -pthread $CXXFLAGS -o scarlet_loadgen loadgen.cpp $LDFLAGS $CODECS $TLS
+
+echo "[+] Executaveis: scarlet_loader, scarlet_menu_fetcher, scarlet_loadgen"
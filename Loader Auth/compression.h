@@ -0,0 +1,421 @@
+#pragma once
+
+// Streaming decoders for compressed HTTP bodies (Content-Encoding: gzip,
+// zstd).
+//
+// Support is chosen at build time: -DSCARLET_ZLIB (link -lz) enables gzip,
+// -DSCARLET_ZSTD (link -lzstd) enables zstd. AcceptEncoding() advertises
+// exactly what was built in.
+//
+// Decoders take the encoded body in arbitrary pieces and emit decoded bytes
+// through a positioned sink. The zstd decoder splits the stream into
+// frames; frames whose header carries their decoded size are decompressed
+// on worker threads straight to their output offset, others are streamed
+// in order on the caller's thread. ZstdPatchDecoder rebuilds a file from a
+// `zstd --patch-from` delta against its previous version (delta.h).
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+#ifdef SCARLET_ZLIB
+#include <zlib.h>
+#endif
+#ifdef SCARLET_ZSTD
+#include <zstd.h>
+#include <zstd_errors.h>
+#endif
+
+namespace compression {
+
+// Receives decoded bytes at their offset in the decoded body. May be called
+// from several threads at once (for disjoint ranges) when the decoder runs
+// with more than one thread.
+typedef std::function<bool(unsigned long long offset, const char* data, size_t size)> OutputSink;
+
+// "zstd, gzip", "gzip", ... or "" when this build decodes nothing.
+inline const char* AcceptEncoding() {
+#if defined(SCARLET_ZSTD) && defined(SCARLET_ZLIB)
+    return "zstd, gzip";
+#elif defined(SCARLET_ZSTD)
+    return "zstd";
+#elif defined(SCARLET_ZLIB)
+    return "gzip";
+#else
+    return "";
+#endif
+}
+
+inline double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+class Decoder {
+public:
+    virtual ~Decoder() {}
+
+    // Feeds the next piece of the encoded body. False on corrupt input or
+    // when the sink refused the output.
+    virtual bool Write(const char* data, size_t size) = 0;
+
+    // Call once after the last Write(); false when the body was truncated.
+    virtual bool Finish() = 0;
+
+    unsigned long long EncodedBytes() const { return encodedBytes_; }
+    unsigned long long DecodedBytes() const { return decodedBytes_; }
+
+    // Time spent decompressing, summed over all decoder threads.
+    double DecodeSeconds() const { return decodeNanos_ / 1e9; }
+
+protected:
+    void AddDecodeTime(std::chrono::steady_clock::time_point start) {
+        decodeNanos_ += (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::atomic<unsigned long long> encodedBytes_{ 0 };
+    std::atomic<unsigned long long> decodedBytes_{ 0 };
+    std::atomic<unsigned long long> decodeNanos_{ 0 };
+};
+
+#ifdef SCARLET_ZLIB
+
+// gzip, including bodies made of several concatenated gzip members.
+class GzipDecoder : public Decoder {
+public:
+    static const size_t kOutputSize = 256 * 1024;
+
+    explicit GzipDecoder(OutputSink out) : out_(out), buffer_(kOutputSize) {
+        memset(&stream_, 0, sizeof(stream_));
+        ok_ = inflateInit2(&stream_, 15 + 16) == Z_OK;
+    }
+
+    ~GzipDecoder() { inflateEnd(&stream_); }
+
+    bool Write(const char* data, size_t size) override {
+        if (!ok_) return false;
+        encodedBytes_ += size;
+        auto started = std::chrono::steady_clock::now();
+
+        stream_.next_in = (Bytef*)data;
+        stream_.avail_in = (uInt)size;
+        while (ok_ && stream_.avail_in > 0) {
+            if (ended_) {
+                // Another member follows the one that just ended
+                inflateReset(&stream_);
+                ended_ = false;
+            }
+            stream_.next_out = (Bytef*)buffer_.data();
+            stream_.avail_out = (uInt)buffer_.size();
+            int rc = inflate(&stream_, Z_NO_FLUSH);
+            if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) ok_ = false;
+            if (rc == Z_STREAM_END) ended_ = true;
+
+            size_t produced = buffer_.size() - stream_.avail_out;
+            if (produced > 0) {
+                if (!out_(decodedBytes_, buffer_.data(), produced)) ok_ = false;
+                decodedBytes_ += produced;
+            }
+            if (rc == Z_BUF_ERROR && produced == 0) break;
+        }
+        AddDecodeTime(started);
+        return ok_;
+    }
+
+    bool Finish() override { return ok_ && ended_; }
+
+private:
+    OutputSink out_;
+    z_stream stream_;
+    std::vector<char> buffer_;
+    bool ok_ = false;
+    bool ended_ = false;
+};
+
+#endif // SCARLET_ZLIB
+
+#ifdef SCARLET_ZSTD
+
+class ZstdDecoder : public Decoder {
+public:
+    // --- CONFIG ---
+    static const size_t kMaxBufferedFrame = 8 * 1024 * 1024;       // larger frames are streamed
+    static const unsigned long long kMaxParallelOutput = 64 * 1024 * 1024;  // per frame, held in memory
+
+    ZstdDecoder(OutputSink out, unsigned threads) : out_(out), outBuffer_(ZSTD_DStreamOutSize()) {
+        stream_ = ZSTD_createDStream();
+        for (unsigned i = 1; i < threads; i++) workers_.emplace_back(&ZstdDecoder::Worker, this);
+    }
+
+    ~ZstdDecoder() {
+        Stop();
+        ZSTD_freeDStream(stream_);
+    }
+
+    bool Write(const char* data, size_t size) override {
+        if (failed_) return false;
+        encodedBytes_ += size;
+
+        if (streaming_) {
+            size_t used = Stream(data, size);
+            if (failed_) return false;
+            data += used;
+            size -= used;
+        }
+
+        pending_.append(data, size);
+        return Split();
+    }
+
+    bool Finish() override {
+        bool complete = !streaming_ && pending_.empty();
+        Stop();
+        return complete && !failed_;
+    }
+
+private:
+    struct Job {
+        std::string frame;
+        unsigned long long offset;
+        unsigned long long size;
+    };
+
+    // Cuts complete frames off the front of pending_. Frames with a known,
+    // reasonable decoded size go to the workers; anything else (or every
+    // frame, when running single-threaded) is decoded inline.
+    bool Split() {
+        size_t pos = 0;
+        while (pos < pending_.size() && !failed_) {
+            const char* frame = pending_.data() + pos;
+            size_t avail = pending_.size() - pos;
+
+            size_t frameSize = ZSTD_findFrameCompressedSize(frame, avail);
+            if (ZSTD_isError(frameSize)) {
+                // Incomplete frame: wait for more input unless it is too
+                // big to buffer, in which case stream it from here
+                if (avail < kMaxBufferedFrame && ZSTD_getErrorCode(frameSize) == ZSTD_error_srcSize_wrong) break;
+                ZSTD_initDStream(stream_);
+                streaming_ = true;
+                pos += Stream(frame, avail);
+                continue;
+            }
+
+            unsigned long long contentSize = ZSTD_getFrameContentSize(frame, frameSize);
+            bool parallel = !workers_.empty() && contentSize != ZSTD_CONTENTSIZE_UNKNOWN &&
+                            contentSize != ZSTD_CONTENTSIZE_ERROR && contentSize <= kMaxParallelOutput;
+            if (parallel) {
+                Enqueue(Job{ std::string(frame, frameSize), nextOffset_, contentSize });
+                nextOffset_ += contentSize;
+            } else {
+                ZSTD_initDStream(stream_);
+                streaming_ = true;
+                Stream(frame, frameSize);
+                if (streaming_) failed_ = true;  // a whole frame must end the stream
+            }
+            pos += frameSize;
+        }
+        pending_.erase(0, pos);
+        return !failed_;
+    }
+
+    // Decodes in order on this thread. Returns the bytes consumed; clears
+    // streaming_ when the current frame ended.
+    size_t Stream(const char* data, size_t size) {
+        auto started = std::chrono::steady_clock::now();
+        ZSTD_inBuffer in = { data, size, 0 };
+        while (in.pos < in.size && streaming_ && !failed_) {
+            ZSTD_outBuffer out = { outBuffer_.data(), outBuffer_.size(), 0 };
+            size_t rc = ZSTD_decompressStream(stream_, &out, &in);
+            if (ZSTD_isError(rc)) {
+                failed_ = true;
+                break;
+            }
+            if (out.pos > 0) {
+                if (!out_(nextOffset_, outBuffer_.data(), out.pos)) failed_ = true;
+                nextOffset_ += out.pos;
+                decodedBytes_ += out.pos;
+            }
+            if (rc == 0) streaming_ = false;
+        }
+        // Flush what the decoder still holds for this input
+        while (streaming_ && !failed_) {
+            ZSTD_outBuffer out = { outBuffer_.data(), outBuffer_.size(), 0 };
+            size_t rc = ZSTD_decompressStream(stream_, &out, &in);
+            if (ZSTD_isError(rc)) {
+                failed_ = true;
+                break;
+            }
+            if (out.pos > 0) {
+                if (!out_(nextOffset_, outBuffer_.data(), out.pos)) failed_ = true;
+                nextOffset_ += out.pos;
+                decodedBytes_ += out.pos;
+            }
+            if (rc == 0) streaming_ = false;
+            if (out.pos < out.size) break;
+        }
+        AddDecodeTime(started);
+        return in.pos;
+    }
+
+    void Enqueue(Job job) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // Bound the compressed frames held in memory
+        drained_.wait(lock, [this] { return jobs_.size() < workers_.size() * 2 || failed_; });
+        jobs_.push_back(std::move(job));
+        ready_.notify_one();
+    }
+
+    void Worker() {
+        ZSTD_DCtx* ctx = ZSTD_createDCtx();
+        std::vector<char> output;
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                ready_.wait(lock, [this] { return !jobs_.empty() || stopping_; });
+                if (jobs_.empty()) break;
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+                drained_.notify_one();
+            }
+            if (failed_) continue;
+
+            auto started = std::chrono::steady_clock::now();
+            output.resize((size_t)job.size);
+            size_t rc = ZSTD_decompressDCtx(ctx, output.data(), output.size(), job.frame.data(), job.frame.size());
+            AddDecodeTime(started);
+            if (ZSTD_isError(rc) || rc != job.size || !out_(job.offset, output.data(), output.size())) {
+                failed_ = true;
+                drained_.notify_all();
+                continue;
+            }
+            decodedBytes_ += job.size;
+        }
+        ZSTD_freeDCtx(ctx);
+    }
+
+    // Waits for queued frames and joins the workers.
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_all();
+        for (std::thread& t : workers_) t.join();
+        workers_.clear();
+    }
+
+    OutputSink out_;
+    ZSTD_DStream* stream_;
+    std::vector<char> outBuffer_;
+    std::string pending_;                 // start of the next, still incomplete frame
+    bool streaming_ = false;              // inside a frame decoded with stream_
+    unsigned long long nextOffset_ = 0;   // decoded offset of the next frame
+    std::atomic<bool> failed_{ false };
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable drained_;
+    std::deque<Job> jobs_;
+    bool stopping_ = false;
+};
+
+// A patch made with `zstd --patch-from=<base>`: one zstd frame that uses
+// the previous version of the file as its dictionary. Decoded in order on
+// the caller's thread; `base` must stay alive until Finish().
+class ZstdPatchDecoder : public Decoder {
+public:
+    // Patches for large files reference the whole base, so allow the
+    // largest window this platform can address
+    static const int kMaxWindowLog = sizeof(size_t) == 8 ? 31 : 30;
+
+    ZstdPatchDecoder(OutputSink out, const char* base, size_t baseSize)
+        : out_(out), outBuffer_(ZSTD_DStreamOutSize()) {
+        ctx_ = ZSTD_createDCtx();
+        failed_ = !ctx_ ||
+                  ZSTD_isError(ZSTD_DCtx_setParameter(ctx_, ZSTD_d_windowLogMax, kMaxWindowLog)) ||
+                  ZSTD_isError(ZSTD_DCtx_refPrefix(ctx_, base, baseSize));
+    }
+
+    ~ZstdPatchDecoder() { ZSTD_freeDCtx(ctx_); }
+
+    bool Write(const char* data, size_t size) override {
+        if (failed_) return false;
+        encodedBytes_ += size;
+        auto started = std::chrono::steady_clock::now();
+
+        ZSTD_inBuffer in = { data, size, 0 };
+        for (;;) {
+            // The prefix only applies to the first frame; anything after it is corrupt
+            if (ended_ && in.pos < in.size) failed_ = true;
+            if (ended_ || failed_) break;
+
+            ZSTD_outBuffer out = { outBuffer_.data(), outBuffer_.size(), 0 };
+            size_t rc = ZSTD_decompressStream(ctx_, &out, &in);
+            if (ZSTD_isError(rc)) {
+                failed_ = true;
+                break;
+            }
+            if (out.pos > 0) {
+                if (!out_(decodedBytes_, outBuffer_.data(), out.pos)) failed_ = true;
+                decodedBytes_ += out.pos;
+            }
+            if (rc == 0) ended_ = true;
+            else if (in.pos == in.size && out.pos < out.size) break;  // needs more input
+        }
+        AddDecodeTime(started);
+        return !failed_;
+    }
+
+    bool Finish() override { return ended_ && !failed_; }
+
+private:
+    OutputSink out_;
+    ZSTD_DCtx* ctx_;
+    std::vector<char> outBuffer_;
+    bool ended_ = false;
+    bool failed_ = false;
+};
+
+#endif // SCARLET_ZSTD
+
+// Decoder for a Content-Encoding value, or nullptr when it is not supported
+// by this build. `threads` only matters for zstd.
+inline std::unique_ptr<Decoder> MakeDecoder(const std::string& contentEncoding, OutputSink out, unsigned threads = 1) {
+#ifdef SCARLET_ZLIB
+    if (contentEncoding == "gzip" || contentEncoding == "x-gzip") return std::unique_ptr<Decoder>(new GzipDecoder(out));
+#endif
+#ifdef SCARLET_ZSTD
+    if (contentEncoding == "zstd") return std::unique_ptr<Decoder>(new ZstdDecoder(out, threads));
+#endif
+    (void)contentEncoding;
+    (void)out;
+    (void)threads;
+    return nullptr;
+}
+
+// Decodes a whole body in place. False (body untouched) on failure.
+inline bool DecodeString(const std::string& contentEncoding, std::string& body, double* decodeSeconds = nullptr) {
+    std::string decoded;
+    decoded.reserve(body.size() * 4);
+    std::unique_ptr<Decoder> decoder = MakeDecoder(contentEncoding,
+        [&decoded](unsigned long long, const char* data, size_t size) {
+            decoded.append(data, size);  // single-threaded: output arrives in order
+            return true;
+        });
+    if (!decoder || !decoder->Write(body.data(), body.size()) || !decoder->Finish()) return false;
+    body.swap(decoded);
+    if (decodeSeconds) *decodeSeconds = decoder->DecodeSeconds();
+    return true;
+}
+
+} // namespace compression
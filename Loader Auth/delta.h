@@ -0,0 +1,169 @@
+#pragma once
+
+// Delta updates.
+//
+// When the loader still has the previous version of a product in its
+// artifact cache, it reports that copy's SHA-256 with the payload request.
+// If the server kept a patch from that version to the current one (made
+// with `zstd --patch-from` at upload), it offers a signed patch URL next
+// to the full download. ApplyPatch() streams the patch through a
+// ZstdPatchDecoder that uses the cached copy as its reference and writes
+// the result to "<dest>.part", hashing it as it lands. Only a result whose
+// SHA-256 matches the server's is committed; on any failure the caller
+// falls back to the full download.
+//
+// Patches need the zstd decoder (-DSCARLET_ZSTD); other builds never ask
+// for them.
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <cctype>
+
+#include "http_client.h"
+#include "compression.h"
+#include "download.h"
+
+struct PatchResult {
+    bool ok = false;
+    unsigned long long patchBytes = 0;  // bytes on the wire
+    unsigned long long bytes = 0;       // size of the rebuilt file
+    unsigned retries = 0;
+    double seconds = 0;
+    double decodeSeconds = 0;
+    std::string sha256;                 // hash of the rebuilt file, hex
+    std::string error;
+
+    double SavedPercent() const {
+        return bytes > patchBytes ? 100.0 * (bytes - patchBytes) / bytes : 0;
+    }
+};
+
+namespace delta {
+
+// --- CONFIG ---
+const unsigned long long kMaxBaseBytes = 512ULL * 1024 * 1024;  // the base is held in memory while patching
+const unsigned kMaxAttempts = 4;
+
+inline bool Supported() {
+#ifdef SCARLET_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+inline bool ReadWholeFile(const std::string& path, std::string& data) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    std::streamoff size = in.tellg();
+    if (size < 0 || (unsigned long long)size > kMaxBaseBytes) return false;
+    data.resize((size_t)size);
+    in.seekg(0);
+    return size == 0 || (bool)in.read(&data[0], size);
+}
+
+} // namespace delta
+
+// Rebuilds the current version of a file into `destPath` from the cached
+// previous version at `basePath` and the patch at `patchUrl`. Nothing is
+// written to destPath unless the result hashes to `expectedSha256`.
+inline PatchResult ApplyPatch(const std::string& basePath, const std::string& patchUrl,
+                              const std::string& destPath, const std::string& expectedSha256,
+                              std::atomic<unsigned long long>* progress = nullptr) {
+    PatchResult result;
+    auto started = std::chrono::steady_clock::now();
+    if (expectedSha256.empty()) {
+        result.error = "No SHA-256 to verify the patched file against";
+        return result;
+    }
+
+#ifdef SCARLET_ZSTD
+    std::string base;
+    if (!delta::ReadWholeFile(basePath, base)) {
+        result.error = "Failed to read the cached copy";
+        return result;
+    }
+
+    FileWriter writer(destPath);
+    writer.CountInto(progress);
+    StreamHasher hasher(writer);
+    if (!writer.Open(0)) {
+        result.error = "Failed to write temp file";
+        return result;
+    }
+    compression::ZstdPatchDecoder decoder([&writer, &hasher](unsigned long long offset, const char* data, size_t size) {
+        return writer.WriteAt(offset, data, size) && hasher.Add(offset, data, size);
+    }, base.data(), base.size());
+
+    // Decoding is sequential, so a failed read resumes with an open-ended range
+    unsigned long long received = 0, total = 0;
+    bool decoded = true, complete = false;
+    for (unsigned attempt = 0; attempt < delta::kMaxAttempts && decoded && !complete; attempt++) {
+        if (attempt > 0) {
+            result.retries++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(200 * attempt));
+        }
+
+        HttpRequest request;
+        request.url = patchUrl;
+        if (received > 0) request.headers.push_back({ "Range", "bytes=" + std::to_string(received) + "-" });
+        request.onHeaders = [&](const HttpResponse& response) {
+            std::string encoding = response.Header("Content-Encoding");
+            if (!encoding.empty() && encoding != "identity") return false;
+            if (received == 0 && response.status == 200) {
+                total = response.ContentLength();
+                return true;
+            }
+            return received > 0 && response.status == 206;
+        };
+        request.sink = [&](const char* data, size_t size) {
+            received += size;
+            decoded = decoder.Write(data, size);
+            return decoded;
+        };
+
+        HttpResponse response = HttpClient::Instance().Send(request);
+        if (response.status == 0 && received == 0 && attempt == 0) {
+            result.error = "Failed to connect to patch URL";
+            return result;
+        }
+        if (response.status != 200 && response.status != 206 && response.status != 0) break;  // expired or gone
+        complete = response.complete && (total == 0 || received == total);
+    }
+
+    result.patchBytes = received;
+    result.decodeSeconds = decoder.DecodeSeconds();
+    if (!decoded || !complete || !decoder.Finish()) {
+        result.error = decoded ? "Failed to download patch" : "Patch does not apply to the cached copy";
+        return result;
+    }
+
+    result.bytes = writer.Written();
+    std::string expected = expectedSha256;
+    for (char& c : expected) c = (char)tolower((unsigned char)c);
+    if (!hasher.Finish(result.bytes, result.sha256) || !DigestEquals(expected, result.sha256)) {
+        result.error = "Integrity check failed (SHA-256 mismatch)";
+        return result;
+    }
+    if (!writer.Commit()) {
+        result.error = "Failed to write temp file";
+        return result;
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    result.ok = true;
+    return result;
+#else
+    (void)basePath;
+    (void)patchUrl;
+    (void)destPath;
+    (void)progress;
+    (void)started;
+    result.error = "Patches need a zstd build";
+    return result;
+#endif
+}
@@ -0,0 +1,726 @@
+#pragma once
+
+// Streaming download engine.
+//
+// The body is written straight to "<dest>.part", preallocated from
+// Content-Length, through one fixed read buffer that grows while the link
+// keeps filling it (64 KB -> 1 MB). Memory use does not depend on the
+// artifact size. On success the part file is renamed over <dest>.
+//
+// When the host supports byte ranges, the first request only fetches a
+// small probe range. Its throughput decides how many parallel Range
+// requests fetch the rest, and more are added while the projected finish
+// time misses the target. Each segment is retried and resumed on its own.
+// A probe or plain 200 stream that breaks off resumes from where it
+// stopped with an open-ended range. A host that does not give the size
+// ("bytes 0-N/*") has the rest read in order, and the download counts as
+// complete only when an answer to an open-ended range ends cleanly.
+//
+// A compressed body (Content-Encoding: gzip or zstd) goes through a
+// streaming decoder on its way to the part file. Its encoded bytes must be
+// decoded in order, so it is fetched over one connection (resuming with
+// open-ended ranges); zstd frames are then decoded on several threads.
+//
+// Every byte written is also fed to a SHA-256 of the body as it lands
+// (StreamHasher), so checking the server's hash costs no second pass over
+// the file. A mismatch fails the download and deletes the part file.
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+#include "http_client.h"
+#include "compression.h"
+#include "sha256.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Conditional request validators from a previously cached copy.
+struct DownloadOptions {
+    std::string ifNoneMatch;      // sent as If-None-Match
+    std::string ifModifiedSince;  // sent as If-Modified-Since
+    std::string sha256;           // expected hash of the (decoded) body, hex; empty skips the check
+    std::atomic<unsigned long long>* progress = nullptr;  // advanced by every byte written, for progress displays
+};
+
+struct DownloadResult {
+    bool ok = false;
+    bool notModified = false;  // 304: the cached copy is current, nothing was written
+    std::string etag;          // validators of the downloaded body
+    std::string lastModified;
+    unsigned long long bytes = 0;
+    unsigned long long expectedBytes = 0;  // 0 when the server sent no Content-Length
+    unsigned connections = 0;              // parallel range requests used (1 = sequential)
+    unsigned retries = 0;                  // segment attempts that had to be resumed
+    double seconds = 0;
+    std::string encoding;                  // Content-Encoding of the transfer, empty when none
+    unsigned long long encodedBytes = 0;   // bytes on the wire when encoded; `bytes` is the decoded size
+    double decodeSeconds = 0;              // decoder time, summed over threads
+    std::string sha256;                    // hash of the body, hex
+    bool verified = false;                 // sha256 matched DownloadOptions::sha256
+    double hashSeconds = 0;                // time spent hashing, summed over threads
+    std::string error;
+
+    double MegabytesPerSecond() const {
+        return seconds > 0 ? (bytes / (1024.0 * 1024.0)) / seconds : 0;
+    }
+
+    double CompressionRatio() const {
+        return encodedBytes ? (double)bytes / encodedBytes : 0;
+    }
+
+    double DecodeMegabytesPerSecond() const {
+        return decodeSeconds > 0 ? (bytes / (1024.0 * 1024.0)) / decodeSeconds : 0;
+    }
+};
+
+// Writer for "<path>.part" with preallocation and an atomic rename into
+// place on Commit(). Write() appends; WriteAt() may be called from several
+// threads for disjoint ranges, ReadAt() reads back what was written.
+// Anything not committed is deleted.
+class FileWriter {
+public:
+    explicit FileWriter(const std::string& path) : path_(path), partPath_(path + ".part") {}
+    ~FileWriter() { Abort(); }
+
+    bool Open(unsigned long long preallocate) {
+#ifdef _WIN32
+        handle_ = CreateFileA(partPath_.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (handle_ == INVALID_HANDLE_VALUE) return false;
+
+        if (preallocate > 0) {
+            // Reserve the full extent up front so the file never grows in small steps
+            LARGE_INTEGER size;
+            size.QuadPart = (LONGLONG)preallocate;
+            if (SetFilePointerEx(handle_, size, NULL, FILE_BEGIN)) SetEndOfFile(handle_);
+            size.QuadPart = 0;
+            SetFilePointerEx(handle_, size, NULL, FILE_BEGIN);
+        }
+#else
+        fd_ = open(partPath_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0700);
+        if (fd_ < 0) return false;
+#ifdef __linux__
+        if (preallocate > 0) posix_fallocate(fd_, 0, (off_t)preallocate);
+#endif
+#endif
+        written_ = 0;
+        end_ = 0;
+        return true;
+    }
+
+    bool Write(const char* data, size_t size) {
+        return WriteAt(end_, data, size);
+    }
+
+    bool WriteAt(unsigned long long offset, const char* data, size_t size) {
+        while (size > 0) {
+#ifdef _WIN32
+            // An OVERLAPPED offset on a synchronous handle is a positioned write
+            OVERLAPPED ov;
+            ZeroMemory(&ov, sizeof(ov));
+            ov.Offset = (DWORD)(offset & 0xFFFFFFFFULL);
+            ov.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD n = 0;
+            if (!WriteFile(handle_, data, (DWORD)size, &n, &ov) || n == 0) return false;
+#else
+            ssize_t n = pwrite(fd_, data, size, (off_t)offset);
+            if (n <= 0) return false;
+#endif
+            data += n;
+            size -= (size_t)n;
+            offset += (unsigned long long)n;
+            written_ += (unsigned long long)n;
+            if (progress_) *progress_ += (unsigned long long)n;
+
+            unsigned long long end = end_.load();
+            while (offset > end && !end_.compare_exchange_weak(end, offset)) {}
+        }
+        return true;
+    }
+
+    bool ReadAt(unsigned long long offset, char* data, size_t size) {
+        while (size > 0) {
+#ifdef _WIN32
+            OVERLAPPED ov;
+            ZeroMemory(&ov, sizeof(ov));
+            ov.Offset = (DWORD)(offset & 0xFFFFFFFFULL);
+            ov.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD n = 0;
+            if (!ReadFile(handle_, data, (DWORD)size, &n, &ov) || n == 0) return false;
+#else
+            ssize_t n = pread(fd_, data, size, (off_t)offset);
+            if (n <= 0) return false;
+#endif
+            data += n;
+            size -= (size_t)n;
+            offset += (unsigned long long)n;
+        }
+        return true;
+    }
+
+    // Truncates to the bytes actually written (the preallocation may have
+    // been larger) and renames the part file over the destination.
+    bool Commit() {
+#ifdef _WIN32
+        if (handle_ == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)end_.load();
+        SetFilePointerEx(handle_, end, NULL, FILE_BEGIN);
+        SetEndOfFile(handle_);
+        CloseHandle(handle_);
+        handle_ = INVALID_HANDLE_VALUE;
+        if (!MoveFileExA(partPath_.c_str(), path_.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+            DeleteFileA(partPath_.c_str());
+            return false;
+        }
+#else
+        if (fd_ < 0) return false;
+        bool ok = ftruncate(fd_, (off_t)end_.load()) == 0;
+        close(fd_);
+        fd_ = -1;
+        if (!ok || rename(partPath_.c_str(), path_.c_str()) != 0) {
+            unlink(partPath_.c_str());
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    void Abort() {
+#ifdef _WIN32
+        if (handle_ == INVALID_HANDLE_VALUE) return;
+        CloseHandle(handle_);
+        handle_ = INVALID_HANDLE_VALUE;
+        DeleteFileA(partPath_.c_str());
+#else
+        if (fd_ < 0) return;
+        close(fd_);
+        fd_ = -1;
+        unlink(partPath_.c_str());
+#endif
+    }
+
+    unsigned long long Written() const { return written_; }
+
+    // Also adds every byte written to `counter` (shared between downloads).
+    void CountInto(std::atomic<unsigned long long>* counter) { progress_ = counter; }
+
+private:
+    std::string path_;
+    std::string partPath_;
+    std::atomic<unsigned long long>* progress_ = nullptr;
+    std::atomic<unsigned long long> written_{ 0 };
+    std::atomic<unsigned long long> end_{ 0 };  // highest offset written; Commit() truncates here
+#ifdef _WIN32
+    HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+};
+
+// SHA-256 of the body in file order, computed while it arrives. Segments
+// and zstd frames land out of order: bytes at the hashed frontier are
+// hashed right away by the thread that wrote them (one thread at a time;
+// the others only stash their bytes), bytes ahead of it wait in memory up
+// to kMaxBacklog and past that are read back from the part file (just
+// written, so from the page cache) once the frontier reaches them.
+class StreamHasher {
+public:
+    static const size_t kMaxBacklog = 64 * 1024 * 1024;
+    static const size_t kReadBackChunk = 1024 * 1024;
+
+    explicit StreamHasher(FileWriter& writer) : writer_(writer) {}
+
+    // Called after `data` was written at `offset`.
+    bool Add(unsigned long long offset, const char* data, size_t size) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (offset < frontier_) {
+            // Rewrite of bytes already hashed (a resumed read); only the tail is new
+            unsigned long long skip = std::min<unsigned long long>(frontier_ - offset, size);
+            offset += skip;
+            data += skip;
+            size -= (size_t)skip;
+            if (size == 0) return true;
+        }
+        if (hashing_ || offset != frontier_) {
+            Stash(offset, data, size);
+            return true;
+        }
+
+        hashing_ = true;
+        lock.unlock();
+        Hash(data, size);
+        lock.lock();
+        frontier_ += size;
+        bool ok = DrainLocked(lock);
+        hashing_ = false;
+        return ok;
+    }
+
+    // Hashes what is left and writes the hex digest. False when the hashed
+    // bytes don't cover [0, total) (a hole, or a failed read back).
+    bool Finish(unsigned long long total, std::string& hex) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!DrainLocked(lock) || frontier_ != total || !buffered_.empty() || !spilled_.empty()) return false;
+        unsigned char digest[Sha256::kDigestSize];
+        sha_.Final(digest);
+        hex = HexEncode(digest, sizeof(digest));
+        return true;
+    }
+
+    double Seconds() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return seconds_;
+    }
+
+private:
+    void Stash(unsigned long long offset, const char* data, size_t size) {
+        if (backlog_ + size <= kMaxBacklog) {
+            buffered_[offset].assign(data, size);
+            backlog_ += size;
+        } else {
+            spilled_[offset] = size;
+        }
+    }
+
+    // Only the thread holding hashing_ (or Finish) calls this.
+    void Hash(const char* data, size_t size) {
+        auto started = std::chrono::steady_clock::now();
+        sha_.Update(data, size);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::lock_guard<std::mutex> lock(timeMutex_);
+        seconds_ += elapsed;
+    }
+
+    // Hashes stashed ranges that start at the frontier, with the lock
+    // released while hashing.
+    bool DrainLocked(std::unique_lock<std::mutex>& lock) {
+        for (;;) {
+            auto memory = buffered_.find(frontier_);
+            if (memory != buffered_.end()) {
+                std::string bytes = std::move(memory->second);
+                buffered_.erase(memory);
+                backlog_ -= bytes.size();
+                lock.unlock();
+                Hash(bytes.data(), bytes.size());
+                lock.lock();
+                frontier_ += bytes.size();
+                continue;
+            }
+
+            auto disk = spilled_.find(frontier_);
+            if (disk == spilled_.end()) return true;
+            unsigned long long offset = disk->first;
+            size_t size = disk->second;
+            spilled_.erase(disk);
+            lock.unlock();
+            bool ok = ReadBack(offset, size);
+            lock.lock();
+            if (!ok) return false;
+            frontier_ += size;
+        }
+    }
+
+    bool ReadBack(unsigned long long offset, size_t size) {
+        std::vector<char> chunk(std::min(size, kReadBackChunk));
+        while (size > 0) {
+            size_t n = std::min(size, chunk.size());
+            if (!writer_.ReadAt(offset, chunk.data(), n)) return false;
+            Hash(chunk.data(), n);
+            offset += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    FileWriter& writer_;
+    std::mutex mutex_;
+    Sha256 sha_;
+    unsigned long long frontier_ = 0;   // bytes [0, frontier_) are hashed
+    bool hashing_ = false;
+    std::map<unsigned long long, std::string> buffered_;  // offset -> bytes
+    std::map<unsigned long long, size_t> spilled_;        // offset -> length, on disk only
+    size_t backlog_ = 0;
+    std::mutex timeMutex_;
+    double seconds_ = 0;
+};
+
+namespace download {
+
+const unsigned long long kProbeSize = 1024 * 1024;         // first ranged request
+const unsigned long long kSegmentSize = 4 * 1024 * 1024;   // unit of work for the parallel phase
+const unsigned kMaxConnections = 8;
+const unsigned kMaxAttempts = 4;                           // per segment
+const double kTargetSeconds = 15.0;                        // well inside the 30 s signed-URL window
+
+// Connections needed to move `remaining` bytes in kTargetSeconds when one
+// connection sustains `bytesPerSecond`.
+inline unsigned ConnectionsFor(unsigned long long remaining, double bytesPerSecond) {
+    if (remaining == 0) return 0;
+    if (bytesPerSecond <= 0) return kMaxConnections;
+    double needed = (double)remaining / (bytesPerSecond * kTargetSeconds);
+    unsigned n = (unsigned)needed + 1;
+    unsigned segments = (unsigned)((remaining + kSegmentSize - 1) / kSegmentSize);
+    return std::min(std::min(n, kMaxConnections), segments);
+}
+
+// Parses "bytes a-b/total"; returns total, or 0 when it is "*" (unknown).
+inline unsigned long long ContentRangeTotal(const std::string& contentRange) {
+    size_t slash = contentRange.find('/');
+    if (slash == std::string::npos) return 0;
+    return strtoull(contentRange.c_str() + slash + 1, NULL, 10);
+}
+
+// Parses "bytes a-b/total"; returns a, or -1 when there is none.
+inline long long ContentRangeStart(const std::string& contentRange) {
+    size_t digits = contentRange.find_first_of("0123456789");
+    size_t dash = contentRange.find('-');
+    if (digits == std::string::npos || dash == std::string::npos || digits > dash) return -1;
+    return (long long)strtoull(contentRange.c_str() + digits, NULL, 10);
+}
+
+struct Segment {
+    unsigned long long start;
+    unsigned long long end;  // inclusive
+};
+
+// Splits [from, total) into kSegmentSize pieces.
+inline std::vector<Segment> SplitSegments(unsigned long long from, unsigned long long total) {
+    std::vector<Segment> segments;
+    for (unsigned long long start = from; start < total; start += kSegmentSize) {
+        segments.push_back({ start, std::min(start + kSegmentSize, total) - 1 });
+    }
+    return segments;
+}
+
+} // namespace download
+
+namespace download {
+
+inline HttpHeader RangeHeader(unsigned long long start, unsigned long long end) {
+    return { "Range", "bytes=" + std::to_string(start) + "-" + std::to_string(end) };
+}
+
+// Writes the body into the writer (and the hasher) starting at `offset`.
+// `received` is advanced as data lands so a failed read can resume where
+// it stopped.
+inline BodySink WriteSink(FileWriter& writer, StreamHasher& hasher, unsigned long long offset,
+                          unsigned long long& received, std::atomic<unsigned long long>* progress) {
+    return [&writer, &hasher, offset, &received, progress](const char* data, size_t size) {
+        if (!writer.WriteAt(offset + received, data, size)) return false;
+        if (!hasher.Add(offset + received, data, size)) return false;
+        received += size;
+        if (progress) *progress += size;
+        return true;
+    };
+}
+
+// Shared state of one parallel download.
+struct SegmentedJob {
+    std::string url;
+    FileWriter* writer;
+    StreamHasher* hasher;
+    std::mutex mutex;
+    std::vector<Segment> pending;
+    std::atomic<unsigned long long> received{ 0 };
+    std::atomic<unsigned> retries{ 0 };
+    std::atomic<bool> failed{ false };
+};
+
+// Fetches one segment, resuming from the last byte received on each retry.
+inline bool FetchSegment(SegmentedJob& job, const Segment& segment) {
+    unsigned long long length = segment.end - segment.start + 1;
+    unsigned long long got = 0;
+
+    for (unsigned attempt = 0; attempt < kMaxAttempts && !job.failed; attempt++) {
+        if (attempt > 0) {
+            job.retries++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(200 * attempt));
+        }
+
+        HttpRequest request;
+        request.url = job.url;
+        request.headers.push_back(RangeHeader(segment.start + got, segment.end));
+        // 200 here would resend the whole file into our range; treat as failure
+        request.onHeaders = [](const HttpResponse& response) { return response.status == 206; };
+        request.sink = WriteSink(*job.writer, *job.hasher, segment.start, got, &job.received);
+
+        HttpClient::Instance().Send(request);
+        if (got >= length) return true;
+    }
+    return false;
+}
+
+// Threads for decoding zstd frames of one download.
+inline unsigned DecodeThreads() {
+    unsigned cores = std::thread::hardware_concurrency();
+    return std::max(1u, std::min(cores, 4u));
+}
+
+// Fetches the rest of a body from `received` on, over one connection with
+// open-ended ranges, and resumes after a failed read. `total` is the full
+// size of the body on the wire. When it is 0 (unknown, e.g. "bytes 0-N/*"),
+// the body ends where a complete answer to an open-ended range ends, and
+// `total` is set then. `encoding` is the body's Content-Encoding ("" for
+// none); every answer must use the same one. `write` consumes the bytes.
+// Once it fails, the data itself is bad and no retry is made.
+inline bool FetchRest(const std::string& url, const std::string& encoding, const BodySink& write,
+                      unsigned long long& received, unsigned long long& total, unsigned& retries) {
+    for (unsigned attempt = 0; attempt < kMaxAttempts; attempt++) {
+        if (total > 0 && received >= total) return received == total;
+        if (attempt > 0) {
+            retries++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(200 * attempt));
+        }
+
+        HttpRequest request;
+        request.url = url;
+        request.headers.push_back({ "Range", "bytes=" + std::to_string(received) + "-" });
+        if (!encoding.empty()) request.headers.push_back({ "Accept-Encoding", encoding });
+        request.onHeaders = [&](const HttpResponse& response) {
+            std::string got = response.Header("Content-Encoding");
+            if (got == "identity") got.clear();
+            std::string contentRange = response.Header("Content-Range");
+            if (response.status != 206 || got != encoding || ContentRangeStart(contentRange) != (long long)received) return false;
+            if (total == 0) total = ContentRangeTotal(contentRange);
+            return true;
+        };
+        bool written = true;
+        request.sink = [&](const char* data, size_t size) {
+            written = write(data, size);
+            if (written) received += size;
+            return written;
+        };
+
+        HttpResponse response = HttpClient::Instance().Send(request);
+        if (!written) return false;  // corrupt data does not get better on retry
+        if (response.status == 200) return false;  // the server ignores ranges; asking again will not help
+        if (response.status == 416 && received > 0 && ContentRangeTotal(response.Header("Content-Range")) == received) {
+            total = received;  // "bytes */N": everything was already here
+            return true;
+        }
+        if (response.status == 206 && response.complete && total == 0) {
+            total = received;  // an open-ended range runs to the end of the body
+            return true;
+        }
+    }
+    return total > 0 && received == total;
+}
+
+inline void SegmentWorker(SegmentedJob* job) {
+    for (;;) {
+        Segment segment;
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            if (job->pending.empty() || job->failed) return;
+            segment = job->pending.back();
+            job->pending.pop_back();
+        }
+        if (!FetchSegment(*job, segment)) {
+            job->failed = true;
+            return;
+        }
+    }
+}
+
+} // namespace download
+
+// Streams `url` into `destPath`. The previous contents of destPath are only
+// replaced when the whole body arrived.
+inline DownloadResult DownloadToFile(const std::string& url, const std::string& destPath,
+                                     const DownloadOptions& options = DownloadOptions()) {
+    using namespace download;
+
+    DownloadResult result;
+    auto started = std::chrono::steady_clock::now();
+
+    // Probe with a small range; hosts without range support answer 200
+    HttpRequest request;
+    request.url = url;
+    request.headers.push_back(RangeHeader(0, kProbeSize - 1));
+    if (*compression::AcceptEncoding()) request.headers.push_back({ "Accept-Encoding", compression::AcceptEncoding() });
+    if (!options.ifNoneMatch.empty()) request.headers.push_back({ "If-None-Match", options.ifNoneMatch });
+    if (!options.ifModifiedSince.empty()) request.headers.push_back({ "If-Modified-Since", options.ifModifiedSince });
+
+    // The part file is opened (and preallocated) once the headers say how
+    // big the body is, before the first byte of it arrives.
+    FileWriter writer(destPath);
+    writer.CountInto(options.progress);
+    StreamHasher hasher(writer);
+    bool opened = false;
+    unsigned long long received = 0;
+    auto probeStarted = started;
+
+    // Set when the server compressed the body; sizes in the headers are
+    // then encoded sizes and the decoded size is only known at the end.
+    std::unique_ptr<compression::Decoder> decoder;
+    unsigned long long encodedTotal = 0;
+
+    request.onHeaders = [&](const HttpResponse& response) {
+        if (response.status != 200 && response.status != 206) return false;
+        unsigned long long total = response.status == 206 ? ContentRangeTotal(response.Header("Content-Range"))
+                                                           : response.ContentLength();
+        std::string encoding = response.Header("Content-Encoding");
+        if (!encoding.empty() && encoding != "identity") {
+            result.encoding = encoding;
+            decoder = compression::MakeDecoder(encoding, [&writer, &hasher](unsigned long long offset, const char* data, size_t size) {
+                return writer.WriteAt(offset, data, size) && hasher.Add(offset, data, size);
+            }, DecodeThreads());
+            if (!decoder) return false;
+            encodedTotal = total;
+        } else {
+            result.expectedBytes = total;
+        }
+        opened = writer.Open(result.expectedBytes);
+        probeStarted = std::chrono::steady_clock::now();
+        return opened;
+    };
+    BodySink plain = WriteSink(writer, hasher, 0, received, NULL);
+    request.sink = [&](const char* data, size_t size) {
+        if (!decoder) return plain(data, size);
+        received += size;
+        return decoder->Write(data, size);
+    };
+
+    HttpResponse response = HttpClient::Instance().Send(request);
+    double probeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - probeStarted).count();
+
+    if (response.status == 0) {
+        result.error = "Failed to connect to download URL";
+        return result;
+    }
+    if (response.status == 304) {
+        result.ok = true;
+        result.notModified = true;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        return result;
+    }
+    if (response.status != 200 && response.status != 206) {
+        result.error = "Server returned HTTP " + std::to_string(response.status);
+        return result;
+    }
+    if (!result.encoding.empty() && !decoder) {
+        result.error = "Unsupported Content-Encoding: " + result.encoding;
+        return result;
+    }
+    if (!opened) {
+        result.error = "Failed to write temp file";
+        return result;
+    }
+
+    result.etag = response.Header("ETag");
+    result.lastModified = response.Header("Last-Modified");
+    bool readOk = response.complete;
+    result.connections = 1;
+
+    // A short complete answer to the probe range is the whole body, even when its size was not given
+    bool probeHadAll = readOk && received < kProbeSize;
+    if (!readOk) result.retries++;  // the probe broke off; whatever picks it up again is a retry
+    BodySink plainRest = [&writer, &hasher, &received](const char* data, size_t size) {
+        return writer.WriteAt(received, data, size) && hasher.Add(received, data, size);
+    };
+
+    if (decoder) {
+        // The rest of the body, or of a read that broke off, comes in order over one connection
+        bool more = response.status == 206 ? (encodedTotal > 0 ? received < encodedTotal : !probeHadAll) : !readOk;
+        if (more) {
+            compression::Decoder& decode = *decoder;
+            readOk = FetchRest(url, result.encoding, [&decode](const char* data, size_t size) {
+                return decode.Write(data, size);
+            }, received, encodedTotal, result.retries);
+        }
+        // Finish() waits for the frames still decoding on worker threads
+        readOk = decoder->Finish() && readOk && (encodedTotal == 0 || received == encodedTotal);
+        result.encodedBytes = received;
+        result.decodeSeconds = decoder->DecodeSeconds();
+        if (readOk) HttpClient::Instance().RecordDecoded(received, writer.Written(), result.decodeSeconds);
+    } else if (response.status == 206 && result.expectedBytes == 0) {
+        // "bytes 0-N/*": with the size unknown, the rest is read in order until an answer ends
+        if (probeHadAll) result.expectedBytes = received;
+        else readOk = FetchRest(url, "", plainRest, received, result.expectedBytes, result.retries);
+    } else if (response.status == 206 && received < result.expectedBytes) {
+        // Parallel phase for everything after the probe range (or after where it broke off)
+        SegmentedJob job;
+        job.url = url;
+        job.writer = &writer;
+        job.hasher = &hasher;
+        job.pending = SplitSegments(received, result.expectedBytes);
+        std::reverse(job.pending.begin(), job.pending.end()); // workers pop from the back
+
+        double perConnection = probeSeconds > 0 ? received / probeSeconds : 0;
+        unsigned long long remaining = result.expectedBytes - received;
+
+        std::vector<std::thread> workers;
+        unsigned initial = std::max(1u, ConnectionsFor(remaining, perConnection));
+        for (unsigned i = 0; i < initial; i++) workers.emplace_back(SegmentWorker, &job);
+
+        // Add connections while the measured rate projects past the target
+        auto phaseStarted = std::chrono::steady_clock::now();
+        for (;;) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                if (job.pending.empty() || job.failed) break;
+            }
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - phaseStarted).count();
+            unsigned long long done = job.received;
+            if (elapsed < 1.0 || done == 0 || workers.size() >= kMaxConnections) continue;
+
+            double projected = elapsed + (remaining - done) / (done / elapsed);
+            if (projected > kTargetSeconds) workers.emplace_back(SegmentWorker, &job);
+        }
+
+        for (std::thread& t : workers) t.join();
+        result.connections += (unsigned)workers.size();
+        result.retries += job.retries;
+        readOk = !job.failed;
+    } else if (!readOk) {
+        // A 200 stream that broke off resumes where it stopped, if the host allows ranges after all
+        readOk = FetchRest(url, "", plainRest, received, result.expectedBytes, result.retries);
+    }
+
+    result.bytes = writer.Written();
+    if (!readOk || result.bytes == 0 || (result.expectedBytes && result.bytes != result.expectedBytes)) {
+        result.error = "Failed to download payload";
+        return result;
+    }
+
+    // Most of the hash was computed while the body arrived
+    bool hashed = hasher.Finish(result.bytes, result.sha256);
+    result.hashSeconds = hasher.Seconds();
+    if (!options.sha256.empty()) {
+        std::string expected = options.sha256;
+        for (char& c : expected) c = (char)tolower((unsigned char)c);
+        if (!hashed || !DigestEquals(expected, result.sha256)) {
+            result.error = "Integrity check failed (SHA-256 mismatch)";
+            return result;
+        }
+        result.verified = true;
+    }
+
+    if (!writer.Commit()) {
+        result.error = "Failed to write temp file";
+        return result;
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    result.ok = true;
+    return result;
+}
@@ -0,0 +1,415 @@
+#pragma once
+
+// Ed25519 signature verification (RFC 8032), portable C++.
+//
+// Verify-only: the loader checks signatures made by the server and never
+// signs. The field and group arithmetic is TweetNaCl's (public domain);
+// SHA-512 follows FIPS 180-4. Verification uses public data only, so it
+// does not need to be constant time.
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+
+class Sha512 {
+public:
+    static const size_t kDigestSize = 64;
+    static const size_t kBlockSize = 128;
+
+    Sha512() { Reset(); }
+
+    void Reset() {
+        static const uint64_t init[8] = {
+            0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+            0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+        };
+        memcpy(state_, init, sizeof(state_));
+        buffered_ = 0;
+        length_ = 0;
+    }
+
+    void Update(const void* data, size_t len) {
+        const unsigned char* p = (const unsigned char*)data;
+        length_ += len;
+        while (len > 0) {
+            size_t take = kBlockSize - buffered_ < len ? kBlockSize - buffered_ : len;
+            memcpy(buffer_ + buffered_, p, take);
+            buffered_ += take;
+            p += take;
+            len -= take;
+            if (buffered_ == kBlockSize) {
+                Block(buffer_);
+                buffered_ = 0;
+            }
+        }
+    }
+
+    void Update(std::string_view data) { Update(data.data(), data.size()); }
+
+    void Final(unsigned char digest[kDigestSize]) {
+        unsigned long long bits = length_ * 8;
+        unsigned char pad = 0x80;
+        Update(&pad, 1);
+        unsigned char zero = 0;
+        while (buffered_ != kBlockSize - 16) Update(&zero, 1);
+        unsigned char lengthBytes[16] = { 0 };
+        for (int i = 0; i < 8; i++) lengthBytes[15 - i] = (unsigned char)(bits >> (8 * i));
+        Update(lengthBytes, sizeof(lengthBytes));
+
+        for (int i = 0; i < 8; i++) {
+            for (int j = 0; j < 8; j++) digest[i * 8 + j] = (unsigned char)(state_[i] >> (56 - 8 * j));
+        }
+    }
+
+private:
+    static uint64_t Rotr(uint64_t x, int n) { return (x >> n) | (x << (64 - n)); }
+
+    void Block(const unsigned char* block) {
+        static const uint64_t k[80] = {
+            0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+            0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+            0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+            0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+            0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+            0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+            0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+            0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+            0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+            0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+            0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+            0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+            0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+            0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+            0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+            0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+            0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+            0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+            0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+            0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+        };
+
+        uint64_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = 0;
+            for (int j = 0; j < 8; j++) w[i] = (w[i] << 8) | block[i * 8 + j];
+        }
+        for (int i = 16; i < 80; i++) {
+            uint64_t s0 = Rotr(w[i - 15], 1) ^ Rotr(w[i - 15], 8) ^ (w[i - 15] >> 7);
+            uint64_t s1 = Rotr(w[i - 2], 19) ^ Rotr(w[i - 2], 61) ^ (w[i - 2] >> 6);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint64_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+        uint64_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+        for (int i = 0; i < 80; i++) {
+            uint64_t t1 = h + (Rotr(e, 14) ^ Rotr(e, 18) ^ Rotr(e, 41)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            uint64_t t2 = (Rotr(a, 28) ^ Rotr(a, 34) ^ Rotr(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state_[0] += a; state_[1] += b; state_[2] += c; state_[3] += d;
+        state_[4] += e; state_[5] += f; state_[6] += g; state_[7] += h;
+    }
+
+    uint64_t state_[8];
+    unsigned char buffer_[kBlockSize];
+    size_t buffered_;
+    unsigned long long length_;
+};
+
+namespace ed25519 {
+
+const size_t kPublicKeySize = 32;
+const size_t kSignatureSize = 64;
+
+namespace detail {
+
+// GF(2^255 - 19) element as 16 limbs of 16 bits (TweetNaCl layout).
+typedef int64_t Gf[16];
+
+static const Gf kGf0 = { 0 };
+static const Gf kGf1 = { 1 };
+static const Gf kD = { 0x78a3, 0x1359, 0x4dca, 0x75eb, 0xd8ab, 0x4141, 0x0a4d, 0x0070,
+                       0xe898, 0x7779, 0x4079, 0x8cc7, 0xfe73, 0x2b6f, 0x6cee, 0x5203 };
+static const Gf kD2 = { 0xf159, 0x26b2, 0x9b94, 0xebd6, 0xb156, 0x8283, 0x149a, 0x00e0,
+                        0xd130, 0xeef3, 0x80f2, 0x198e, 0xfce7, 0x56df, 0xd9dc, 0x2406 };
+static const Gf kX = { 0xd51a, 0x8f25, 0x2d60, 0xc956, 0xa7b2, 0x9525, 0xc760, 0x692c,
+                       0xdc5c, 0xfdd6, 0xe231, 0xc0a4, 0x53fe, 0xcd6e, 0x36d3, 0x2169 };
+static const Gf kY = { 0x6658, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666,
+                       0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666 };
+static const Gf kI = { 0xa0b0, 0x4a0e, 0x1b27, 0xc4ee, 0xe478, 0xad2f, 0x1806, 0x2f43,
+                       0xd7a7, 0x3dfb, 0x0099, 0x2b4d, 0xdf0b, 0x4fc1, 0x2480, 0x2b83 };
+
+// Group order L, little endian.
+static const int64_t kL[32] = { 0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2,
+                                0xde, 0xf9, 0xde, 0x14, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10 };
+
+inline void Set(Gf r, const Gf a) { for (int i = 0; i < 16; i++) r[i] = a[i]; }
+
+inline void Carry(Gf o) {
+    for (int i = 0; i < 16; i++) {
+        o[i] += 65536;
+        int64_t c = o[i] >> 16;
+        o[(i + 1) * (i < 15)] += c - 1 + 37 * (c - 1) * (i == 15);
+        o[i] -= c * 65536;
+    }
+}
+
+inline void Select(Gf p, Gf q, int b) {
+    int64_t c = ~(int64_t)(b - 1);
+    for (int i = 0; i < 16; i++) {
+        int64_t t = c & (p[i] ^ q[i]);
+        p[i] ^= t;
+        q[i] ^= t;
+    }
+}
+
+inline void Pack(unsigned char* o, const Gf n) {
+    Gf m, t;
+    Set(t, n);
+    Carry(t);
+    Carry(t);
+    Carry(t);
+    for (int j = 0; j < 2; j++) {
+        m[0] = t[0] - 0xffed;
+        for (int i = 1; i < 15; i++) {
+            m[i] = t[i] - 0xffff - ((m[i - 1] >> 16) & 1);
+            m[i - 1] &= 0xffff;
+        }
+        m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+        int b = (int)((m[15] >> 16) & 1);
+        m[14] &= 0xffff;
+        Select(t, m, 1 - b);
+    }
+    for (int i = 0; i < 16; i++) {
+        o[2 * i] = (unsigned char)(t[i] & 0xff);
+        o[2 * i + 1] = (unsigned char)(t[i] >> 8);
+    }
+}
+
+inline bool Equal(const Gf a, const Gf b) {
+    unsigned char c[32], d[32];
+    Pack(c, a);
+    Pack(d, b);
+    return memcmp(c, d, 32) == 0;
+}
+
+inline int Parity(const Gf a) {
+    unsigned char d[32];
+    Pack(d, a);
+    return d[0] & 1;
+}
+
+inline void Unpack(Gf o, const unsigned char* n) {
+    for (int i = 0; i < 16; i++) o[i] = n[2 * i] + ((int64_t)n[2 * i + 1] << 8);
+    o[15] &= 0x7fff;
+}
+
+inline void Add(Gf o, const Gf a, const Gf b) { for (int i = 0; i < 16; i++) o[i] = a[i] + b[i]; }
+inline void Sub(Gf o, const Gf a, const Gf b) { for (int i = 0; i < 16; i++) o[i] = a[i] - b[i]; }
+
+inline void Mul(Gf o, const Gf a, const Gf b) {
+    int64_t t[31] = { 0 };
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 16; j++) t[i + j] += a[i] * b[j];
+    }
+    for (int i = 0; i < 15; i++) t[i] += 38 * t[i + 16];
+    for (int i = 0; i < 16; i++) o[i] = t[i];
+    Carry(o);
+    Carry(o);
+}
+
+inline void Square(Gf o, const Gf a) { Mul(o, a, a); }
+
+// a^(2^252 - 3), for the square root in point decompression.
+inline void Pow2523(Gf o, const Gf i) {
+    Gf c;
+    Set(c, i);
+    for (int a = 250; a >= 0; a--) {
+        Square(c, c);
+        if (a != 1) Mul(c, c, i);
+    }
+    Set(o, c);
+}
+
+inline void Invert(Gf o, const Gf i) {
+    Gf c;
+    Set(c, i);
+    for (int a = 253; a >= 0; a--) {
+        Square(c, c);
+        if (a != 2 && a != 4) Mul(c, c, i);
+    }
+    Set(o, c);
+}
+
+// Extended coordinates (X, Y, Z, T).
+typedef Gf Point[4];
+
+inline void PointAdd(Point p, Point q) {
+    Gf a, b, c, d, t, e, f, g, h;
+    Sub(a, p[1], p[0]);
+    Sub(t, q[1], q[0]);
+    Mul(a, a, t);
+    Add(b, p[0], p[1]);
+    Add(t, q[0], q[1]);
+    Mul(b, b, t);
+    Mul(c, p[3], q[3]);
+    Mul(c, c, kD2);
+    Mul(d, p[2], q[2]);
+    Add(d, d, d);
+    Sub(e, b, a);
+    Sub(f, d, c);
+    Add(g, d, c);
+    Add(h, b, a);
+    Mul(p[0], e, f);
+    Mul(p[1], h, g);
+    Mul(p[2], g, f);
+    Mul(p[3], e, h);
+}
+
+inline void PointSwap(Point p, Point q, int b) {
+    for (int i = 0; i < 4; i++) Select(p[i], q[i], b);
+}
+
+inline void PointPack(unsigned char* r, Point p) {
+    Gf tx, ty, zi;
+    Invert(zi, p[2]);
+    Mul(tx, p[0], zi);
+    Mul(ty, p[1], zi);
+    Pack(r, ty);
+    r[31] ^= (unsigned char)(Parity(tx) << 7);
+}
+
+inline void ScalarMult(Point p, Point q, const unsigned char* s) {
+    Set(p[0], kGf0);
+    Set(p[1], kGf1);
+    Set(p[2], kGf1);
+    Set(p[3], kGf0);
+    for (int i = 255; i >= 0; --i) {
+        int b = (s[i / 8] >> (i & 7)) & 1;
+        PointSwap(p, q, b);
+        PointAdd(q, p);
+        PointAdd(p, p);
+        PointSwap(p, q, b);
+    }
+}
+
+inline void ScalarBase(Point p, const unsigned char* s) {
+    Point q;
+    Set(q[0], kX);
+    Set(q[1], kY);
+    Set(q[2], kGf1);
+    Mul(q[3], kX, kY);
+    ScalarMult(p, q, s);
+}
+
+// r = x mod L, for a 64-byte little-endian x.
+inline void ModL(unsigned char* r, int64_t x[64]) {
+    int64_t carry;
+    for (int i = 63; i >= 32; --i) {
+        carry = 0;
+        int j;
+        for (j = i - 32; j < i - 12; ++j) {
+            x[j] += carry - 16 * x[i] * kL[j - (i - 32)];
+            carry = (x[j] + 128) >> 8;
+            x[j] -= carry * 256;
+        }
+        x[j] += carry;
+        x[i] = 0;
+    }
+    carry = 0;
+    for (int j = 0; j < 32; j++) {
+        x[j] += carry - (x[31] >> 4) * kL[j];
+        carry = x[j] >> 8;
+        x[j] &= 255;
+    }
+    for (int j = 0; j < 32; j++) x[j] -= carry * kL[j];
+    for (int i = 0; i < 32; i++) {
+        x[i + 1] += x[i] >> 8;
+        r[i] = (unsigned char)(x[i] & 255);
+    }
+}
+
+inline void Reduce(unsigned char* r) {
+    int64_t x[64];
+    for (int i = 0; i < 64; i++) x[i] = r[i];
+    memset(r, 0, 64);
+    ModL(r, x);
+}
+
+// Decompresses a public key into -A. False when it is not a curve point.
+inline bool UnpackNegative(Point r, const unsigned char p[32]) {
+    Gf t, chk, num, den, den2, den4, den6;
+    Set(r[2], kGf1);
+    Unpack(r[1], p);
+    Square(num, r[1]);
+    Mul(den, num, kD);
+    Sub(num, num, r[2]);
+    Add(den, r[2], den);
+
+    Square(den2, den);
+    Square(den4, den2);
+    Mul(den6, den4, den2);
+    Mul(t, den6, num);
+    Mul(t, t, den);
+
+    Pow2523(t, t);
+    Mul(t, t, num);
+    Mul(t, t, den);
+    Mul(t, t, den);
+    Mul(r[0], t, den);
+
+    Square(chk, r[0]);
+    Mul(chk, chk, den);
+    if (!Equal(chk, num)) Mul(r[0], r[0], kI);
+
+    Square(chk, r[0]);
+    Mul(chk, chk, den);
+    if (!Equal(chk, num)) return false;
+
+    if (Parity(r[0]) == (p[31] >> 7)) Sub(r[0], kGf0, r[0]);
+    Mul(r[3], r[0], r[1]);
+    return true;
+}
+
+// S < L, so a signature has exactly one valid encoding.
+inline bool CanonicalScalar(const unsigned char* s) {
+    for (int i = 31; i >= 0; i--) {
+        if (s[i] < kL[i]) return true;
+        if (s[i] > kL[i]) return false;
+    }
+    return false;
+}
+
+} // namespace detail
+
+// True when `signature` is a valid Ed25519 signature of `message` under
+// `publicKey`.
+inline bool Verify(const unsigned char signature[kSignatureSize], std::string_view message,
+                   const unsigned char publicKey[kPublicKeySize]) {
+    using namespace detail;
+
+    Point a;
+    if (!CanonicalScalar(signature + 32) || !UnpackNegative(a, publicKey)) return false;
+
+    // h = SHA-512(R || A || M) mod L
+    unsigned char h[Sha512::kDigestSize];
+    Sha512 sha;
+    sha.Update(signature, 32);
+    sha.Update(publicKey, kPublicKeySize);
+    sha.Update(message);
+    sha.Final(h);
+    Reduce(h);
+
+    // Check [S]B - [h]A == R
+    Point p, q;
+    ScalarMult(p, a, h);
+    ScalarBase(q, signature + 32);
+    PointAdd(p, q);
+    unsigned char r[32];
+    PointPack(r, p);
+    return memcmp(r, signature, 32) == 0;
+}
+
+} // namespace ed25519
@@ -0,0 +1,404 @@
+#pragma once
+
+// Hardware fingerprint subsystem.
+//
+// GPU, motherboard and CPU are read in-process (cpuid, registry/SMBIOS on
+// Windows, /proc and /sys on Linux) on parallel threads instead of spawning
+// one wmic process per value. The result is computed once per run and kept
+// in a small on-disk cache keyed by the boot ID, so later launches in the
+// same boot skip probing entirely.
+
+#include <string>
+#include <vector>
+#include <future>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "paths.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <dirent.h>
+#include <pwd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+struct HardwareInfo {
+    std::string hwid;
+    std::string gpu;
+    std::string motherboard;
+    std::string cpu;
+    bool fromCache = false;
+};
+
+namespace hardware {
+
+const char* const kUnknown = "Unknown";
+const char* const kCacheVersion = "1";
+const long long kBootToleranceMs = 5000;  // derived boot times this close are the same boot
+
+inline std::string Trim(const std::string& s) {
+    size_t first = s.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return "";
+    size_t last = s.find_last_not_of(" \t\r\n");
+    return s.substr(first, last - first + 1);
+}
+
+inline std::string OrUnknown(const std::string& s) {
+    std::string t = Trim(s);
+    return t.empty() ? kUnknown : t;
+}
+
+// --- WMIC FALLBACK ---
+
+// wmic prints a header line followed by the value; returns the first
+// non-blank line after the header, trimmed.
+inline std::string ParseWmicValue(const std::string& output) {
+    int lineCount = 0;
+    size_t pos = 0;
+    while (pos < output.size()) {
+        size_t end = output.find('\n', pos);
+        if (end == std::string::npos) end = output.size();
+        std::string line = Trim(output.substr(pos, end - pos));
+        pos = end + 1;
+        if (line.empty()) continue;
+        if (++lineCount == 2) return line;
+    }
+    return "";
+}
+
+#ifdef _WIN32
+inline std::string RunWmic(const char* query) {
+    std::string cmd = std::string("wmic ") + query;
+    FILE* pipe = _popen(cmd.c_str(), "r");
+    if (!pipe) return "";
+    std::string output;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        output.append(buffer, n);
+    }
+    _pclose(pipe);
+    return ParseWmicValue(output);
+}
+#endif
+
+// --- SMBIOS ---
+
+// Returns string `stringOffset` of the first structure of `type` in a raw
+// SMBIOS table (the format of both GetSystemFirmwareTable('RSMB') after its
+// 8-byte header and /sys/firmware/dmi/tables/DMI).
+inline std::string SmbiosString(const unsigned char* table, size_t length, unsigned char type, unsigned char stringOffset) {
+    size_t pos = 0;
+    while (pos + 4 <= length) {
+        unsigned char structType = table[pos];
+        unsigned char structLen = table[pos + 1];
+        if (structLen < 4 || pos + structLen > length) break;
+
+        // Strings start right after the formatted area and end with a double NUL
+        size_t strings = pos + structLen;
+        size_t next = strings;
+        while (next + 1 < length && (table[next] != 0 || table[next + 1] != 0)) next++;
+        next += 2;
+
+        if (structType == type && stringOffset < structLen) {
+            unsigned char index = table[pos + stringOffset];
+            if (index == 0) return "";
+            size_t p = strings;
+            for (unsigned char i = 1; p < length && table[p] != 0; i++) {
+                size_t len = strnlen((const char*)table + p, length - p);
+                if (i == index) return Trim(std::string((const char*)table + p, len));
+                p += len + 1;
+            }
+            return "";
+        }
+        if (structType == 127) break; // end-of-table
+        pos = next;
+    }
+    return "";
+}
+
+const unsigned char kSmbiosBaseboard = 2;
+const unsigned char kSmbiosBaseboardProduct = 0x05;
+
+// --- PLATFORM PROBES ---
+
+inline std::string CpuBrandFromCpuid() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    unsigned int regs[12] = { 0 };
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000004) return "";
+    for (unsigned int i = 0; i < 3; i++) {
+        __get_cpuid(0x80000002 + i, &regs[i * 4], &regs[i * 4 + 1], &regs[i * 4 + 2], &regs[i * 4 + 3]);
+    }
+    char brand[49] = { 0 };
+    memcpy(brand, regs, 48);
+    return Trim(brand);
+#elif defined(_MSC_VER)
+    int regs[12] = { 0 };
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if ((unsigned int)info[0] < 0x80000004) return "";
+    for (int i = 0; i < 3; i++) __cpuid(&regs[i * 4], 0x80000002 + i);
+    char brand[49] = { 0 };
+    memcpy(brand, regs, 48);
+    return Trim(brand);
+#else
+    return "";
+#endif
+}
+
+#ifdef _WIN32
+
+inline std::string RegString(HKEY root, const char* subKey, const char* value) {
+    char buffer[512];
+    DWORD size = sizeof(buffer);
+    if (RegGetValueA(root, subKey, value, RRF_RT_REG_SZ, NULL, buffer, &size) != ERROR_SUCCESS) return "";
+    return Trim(buffer);
+}
+
+inline std::string ProbeCPU() {
+    std::string cpu = CpuBrandFromCpuid();
+    if (cpu.empty()) cpu = RegString(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", "ProcessorNameString");
+    if (cpu.empty()) cpu = RunWmic("path Win32_Processor get Name");
+    return OrUnknown(cpu);
+}
+
+inline std::string ProbeMotherboard() {
+    std::string board = RegString(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\BIOS", "BaseBoardProduct");
+    if (board.empty()) {
+        UINT size = GetSystemFirmwareTable('RSMB', 0, NULL, 0);
+        if (size > 8) {
+            std::vector<unsigned char> raw(size);
+            if (GetSystemFirmwareTable('RSMB', 0, raw.data(), size) == size) {
+                board = SmbiosString(raw.data() + 8, size - 8, kSmbiosBaseboard, kSmbiosBaseboardProduct);
+            }
+        }
+    }
+    if (board.empty()) board = RunWmic("path Win32_BaseBoard get Product");
+    return OrUnknown(board);
+}
+
+inline std::string ProbeGPU() {
+    // Display adapter device class; 0000 is the primary adapter
+    std::string gpu = RegString(HKEY_LOCAL_MACHINE,
+        "SYSTEM\\CurrentControlSet\\Control\\Class\\{4d36e968-e325-11ce-bfc1-08002be10318}\\0000", "DriverDesc");
+    if (gpu.empty()) gpu = RunWmic("path Win32_VideoController get Name");
+    return OrUnknown(gpu);
+}
+
+inline std::string ComputeHWID() {
+    // Keep this format: licenses are bound server-side to exactly this string
+    char computerName[256] = { 0 };
+    char userName[256] = { 0 };
+    DWORD size = 256;
+    GetComputerNameA(computerName, &size);
+    size = 256;
+    GetUserNameA(userName, &size);
+    return std::string(computerName) + "-" + std::string(userName);
+}
+
+inline std::string BootId() {
+    DWORD bootId = 0;
+    DWORD size = sizeof(bootId);
+    if (RegGetValueA(HKEY_LOCAL_MACHINE,
+            "SYSTEM\\CurrentControlSet\\Control\\Session Manager\\Memory Management\\PrefetchParameters",
+            "BootId", RRF_RT_REG_DWORD, NULL, &bootId, &size) == ERROR_SUCCESS) {
+        return std::to_string(bootId);
+    }
+    // Fallback: boot time in milliseconds (FILETIME epoch). It comes from two
+    // clocks read one after the other, so it wobbles a little between
+    // launches; SameBoot() compares it with a tolerance.
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    ULONGLONG now = (((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime) / 10000ULL;
+    return "t" + std::to_string(now - GetTickCount64());
+}
+
+#else
+
+inline std::string ReadFirstLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    if (in) std::getline(in, line);
+    return Trim(line);
+}
+
+inline std::string ProbeCPU() {
+    std::string cpu = CpuBrandFromCpuid();
+    if (!cpu.empty()) return cpu;
+
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 10, "model name") == 0 || line.compare(0, 8, "Hardware") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) return OrUnknown(line.substr(colon + 1));
+        }
+    }
+    return kUnknown;
+}
+
+inline std::string ProbeMotherboard() {
+    std::string board = ReadFirstLine("/sys/class/dmi/id/board_name");
+    if (board.empty()) {
+        std::ifstream in("/sys/firmware/dmi/tables/DMI", std::ios::binary);
+        std::vector<unsigned char> raw((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!raw.empty()) board = SmbiosString(raw.data(), raw.size(), kSmbiosBaseboard, kSmbiosBaseboardProduct);
+    }
+    return OrUnknown(board);
+}
+
+inline std::string ProbeGPU() {
+    // The NVIDIA driver exposes the marketing name directly
+    DIR* dir = opendir("/proc/driver/nvidia/gpus");
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+            std::ifstream in(std::string("/proc/driver/nvidia/gpus/") + entry->d_name + "/information");
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.compare(0, 6, "Model:") == 0) {
+                    closedir(dir);
+                    return OrUnknown(line.substr(6));
+                }
+            }
+        }
+        closedir(dir);
+    }
+
+    // Otherwise report the PCI vendor:device of the first DRM card
+    for (int card = 0; card < 4; card++) {
+        std::string base = "/sys/class/drm/card" + std::to_string(card) + "/device/";
+        std::string vendor = ReadFirstLine(base + "vendor");
+        std::string device = ReadFirstLine(base + "device");
+        if (vendor.empty()) continue;
+
+        std::string name = vendor == "0x10de" ? "NVIDIA" : vendor == "0x1002" ? "AMD" : vendor == "0x8086" ? "Intel" : vendor;
+        return name + " " + device;
+    }
+    return kUnknown;
+}
+
+inline std::string ComputeHWID() {
+    char computerName[256] = { 0 };
+    gethostname(computerName, sizeof(computerName) - 1);
+    const char* user = getenv("USER");
+    struct passwd* pw = getpwuid(getuid());
+    if (pw && pw->pw_name) user = pw->pw_name;
+    return std::string(computerName) + "-" + (user ? user : "");
+}
+
+inline std::string BootId() {
+    return ReadFirstLine("/proc/sys/kernel/random/boot_id");
+}
+
+#endif
+
+// --- CACHE ---
+
+inline std::string CachePath() {
+    return LocalDataPath("hwinfo.cache");
+}
+
+// Boot IDs are compared exactly, except derived boot times ("t<ms>"),
+// which match within kBootToleranceMs.
+inline bool SameBoot(const std::string& cached, const std::string& current) {
+    if (cached == current) return true;
+    if (cached.size() < 2 || current.size() < 2 || cached[0] != 't' || current[0] != 't') return false;
+    long long a = strtoll(cached.c_str() + 1, NULL, 10);
+    long long b = strtoll(current.c_str() + 1, NULL, 10);
+    return a > 0 && b > 0 && llabs(a - b) <= kBootToleranceMs;
+}
+
+// One "key=value" per line. Any mismatch (version, boot, missing field)
+// is treated as a miss.
+inline bool LoadCache(const std::string& path, const std::string& bootId, HardwareInfo& info) {
+    if (path.empty() || bootId.empty()) return false;
+    std::ifstream in(path);
+    if (!in) return false;
+
+    std::string line, version, boot;
+    while (std::getline(in, line)) {
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string key = line.substr(0, eq);
+        std::string value = line.substr(eq + 1);
+        if (key == "version") version = value;
+        else if (key == "boot") boot = value;
+        else if (key == "hwid") info.hwid = value;
+        else if (key == "gpu") info.gpu = value;
+        else if (key == "motherboard") info.motherboard = value;
+        else if (key == "cpu") info.cpu = value;
+    }
+    return version == kCacheVersion && SameBoot(boot, bootId) && !info.hwid.empty() &&
+           !info.gpu.empty() && !info.motherboard.empty() && !info.cpu.empty();
+}
+
+inline void SaveCache(const std::string& path, const std::string& bootId, const HardwareInfo& info) {
+    if (path.empty() || bootId.empty()) return;
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) return;
+        out << "version=" << kCacheVersion << "\n"
+            << "boot=" << bootId << "\n"
+            << "hwid=" << info.hwid << "\n"
+            << "gpu=" << info.gpu << "\n"
+            << "motherboard=" << info.motherboard << "\n"
+            << "cpu=" << info.cpu << "\n";
+    }
+    std::remove(path.c_str());
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+// Probes everything concurrently, bypassing the cache.
+inline HardwareInfo Probe() {
+    std::future<std::string> gpu = std::async(std::launch::async, ProbeGPU);
+    std::future<std::string> board = std::async(std::launch::async, ProbeMotherboard);
+    std::future<std::string> cpu = std::async(std::launch::async, ProbeCPU);
+
+    HardwareInfo info;
+    info.hwid = ComputeHWID();
+    info.gpu = gpu.get();
+    info.motherboard = board.get();
+    info.cpu = cpu.get();
+    return info;
+}
+
+} // namespace hardware
+
+// Process-wide fingerprint: the first call loads it from the boot cache or
+// probes the machine; every later call returns the same object.
+inline const HardwareInfo& GetHardwareInfo() {
+    static HardwareInfo info;
+    static std::once_flag once;
+    std::call_once(once, [] {
+        std::string path = hardware::CachePath();
+        std::string bootId = hardware::BootId();
+
+        HardwareInfo cached;
+        if (hardware::LoadCache(path, bootId, cached) && cached.hwid == hardware::ComputeHWID()) {
+            cached.fromCache = true;
+            info = cached;
+            return;
+        }
+
+        info = hardware::Probe();
+        hardware::SaveCache(path, bootId, info);
+    });
+    return info;
+}
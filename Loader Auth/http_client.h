@@ -0,0 +1,114 @@
+#pragma once
+
+// Process-wide HTTP client for the loader.
+//
+// A thin front over the platform Transport: WinInetTransport on Windows,
+// PosixTransport (epoll) elsewhere. Both keep connections alive and pool
+// them per host:port, so callers just send requests.
+//
+// Requests that collect their body advertise the encodings this build can
+// decode (compression.h) and get the body back decoded. Streaming requests
+// (with a sink) are left alone; the caller decodes and reports the work
+// through RecordDecoded() so Stats() covers both.
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include "transport.h"
+#include "compression.h"
+
+#ifdef _WIN32
+#include "transport_wininet.h"
+#else
+#include "transport_posix.h"
+#endif
+
+class HttpClient {
+public:
+    static HttpClient& Instance() {
+        static HttpClient instance;
+        return instance;
+    }
+
+    HttpResponse Send(const HttpRequest& request) {
+        if (request.sink || !*compression::AcceptEncoding() || HasHeader(request, "Accept-Encoding")) {
+            return transport_->Send(request);
+        }
+
+        HttpRequest negotiated = request;
+        negotiated.headers.push_back({ "Accept-Encoding", compression::AcceptEncoding() });
+        HttpResponse response = transport_->Send(negotiated);
+
+        std::string encoding = response.Header("Content-Encoding");
+        if (encoding.empty() || encoding == "identity" || response.body.empty()) return response;
+
+        unsigned long long encoded = response.body.size();
+        double seconds = 0;
+        if (!compression::DecodeString(encoding, response.body, &seconds)) {
+            response.body.clear();
+            response.complete = false;
+            response.error = "Failed to decode " + encoding + " response body";
+            return response;
+        }
+        RecordDecoded(encoded, response.body.size(), seconds);
+        return response;
+    }
+
+    // Convenience form for API calls; bodies are sent as JSON.
+    HttpResponse Send(const std::string& url, const std::string& method,
+                      std::string_view body = std::string_view()) {
+        HttpRequest request;
+        request.method = method;
+        request.url = url;
+        request.body = body;
+        if (!body.empty()) request.headers.push_back({ "Content-Type", "application/json" });
+        return Send(request);
+    }
+
+    // Opens a keep-alive connection to the host of `url` ahead of the first
+    // real request (a HEAD, so no body is transferred).
+    bool Preconnect(const std::string& url) {
+        return Send(url, "HEAD").status != 0;
+    }
+
+    HttpClientStats Stats() {
+        HttpClientStats stats = transport_->Stats();
+        std::lock_guard<std::mutex> lock(decodeMutex_);
+        stats.compressedResponses = decoded_.compressedResponses;
+        stats.encodedBytes = decoded_.encodedBytes;
+        stats.decodedBytes = decoded_.decodedBytes;
+        stats.decodeSeconds = decoded_.decodeSeconds;
+        return stats;
+    }
+
+    // Counts one body decoded outside Send() (e.g. a streamed download).
+    void RecordDecoded(unsigned long long encodedBytes, unsigned long long decodedBytes, double seconds) {
+        std::lock_guard<std::mutex> lock(decodeMutex_);
+        decoded_.compressedResponses++;
+        decoded_.encodedBytes += encodedBytes;
+        decoded_.decodedBytes += decodedBytes;
+        decoded_.decodeSeconds += seconds;
+    }
+
+    // Closes every pooled connection. Safe to call more than once.
+    void Shutdown() { transport_->Shutdown(); }
+
+private:
+#ifdef _WIN32
+    HttpClient() : transport_(new WinInetTransport()) {}
+#else
+    HttpClient() : transport_(new PosixTransport()) {}
+#endif
+
+    static bool HasHeader(const HttpRequest& request, const char* name) {
+        for (const HttpHeader& header : request.headers) {
+            if (header.name == name) return true;
+        }
+        return false;
+    }
+
+    std::unique_ptr<Transport> transport_;
+    std::mutex decodeMutex_;
+    HttpClientStats decoded_;  // only the compression counters are used
+};
@@ -1,19 +1,28 @@
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include <windows.h>
-#include <wininet.h>
+#endif
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <vector>
-#include <io.h>
-#include <fcntl.h>
 #include <cstdio>
 #include <cwchar>
-
-#ifndef _O_U16TEXT
-#define _O_U16TEXT 0x20000
-#endif
-
-#pragma comment(lib, "wininet.lib")
+#include <cwctype>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <future>
+#include "json.h"
+#include "paths.h"
+#include "text_codec.h"
+#include "http_client.h"
+#include "request_policy.h"
+#include "license_lease.h"
+#include "trace.h"
+#include "log.h"
 
 // CPUID inline para MinGW
 inline void __cpuid(int* cpuInfo, int function) {
@@ -31,6 +40,11 @@ const std::wstring SERVER_HOST = L"localhost";  // ou seu domínio
 const int SERVER_PORT = 80;
 const std::wstring APP_ID = L"Scarlet External";
 const std::wstring APP_SECRET = L"00347ecb6ab1084f15649e13aed2ba1d4e2693a81ba0b97ef3ec79943fd2a0fa";
+const long long CACHE_TTL_SECONDS = 60;  // aberturas repetidas do menu dentro desse tempo não usam a rede
+// Chave pública Ed25519 dos leases (hex, aparece no log do auth-api.js); vazia desliga o lease offline
+const std::string LEASE_PUBLIC_KEY = "";
+// menu_fetcher.log (na pasta de dados) gira ao passar desse tamanho, guardando 3 arquivos; 0 desliga o log em arquivo
+const unsigned long long LOG_FILE_BYTES = 256 * 1024;
 
 // ==================================================
 // FUNÇÃO PARA OBTER HWID
@@ -38,234 +52,341 @@ const std::wstring APP_SECRET = L"00347ecb6ab1084f15649e13aed2ba1d4e2693a81ba0b9
 std::wstring GetHWID() {
     std::wstring hwid;
     
+#ifdef _WIN32
     // Obter Volume Serial Number
     DWORD volumeSerial = 0;
     if (GetVolumeInformationW(L"C:\\", NULL, 0, &volumeSerial, NULL, NULL, NULL, 0)) {
         wchar_t buffer[128];
-        swprintf(buffer, L"%08X", volumeSerial);
+        swprintf(buffer, 128, L"%08X", volumeSerial);
         hwid += buffer;
     }
+#else
+    // Sem serial de volume no Linux: primeiros 8 dígitos do machine-id
+    std::ifstream machineId("/etc/machine-id");
+    std::string id;
+    if (machineId >> id && id.size() >= 8) {
+        for (int i = 0; i < 8; i++) hwid += (wchar_t)towupper((wint_t)id[i]);
+    }
+#endif
     
     // Adicionar informações do processador
     int cpuInfo[4] = { 0 };
     __cpuid(cpuInfo, 0);
     wchar_t cpuBuffer[64];
-    swprintf(cpuBuffer, L"-%08X%08X", cpuInfo[3], cpuInfo[0]);
+    swprintf(cpuBuffer, 64, L"-%08X%08X", cpuInfo[3], cpuInfo[0]);
     hwid += cpuBuffer;
     
     return hwid;
 }
 
 // ==================================================
-// FUNÇÃO PARA URL ENCODE
+// FUNÇÃO PARA FAZER GET REQUEST
 // ==================================================
-std::wstring UrlEncode(const std::wstring& str) {
-    std::wstring encoded;
-    for (wchar_t c : str) {
-        if (iswalnum(c) || c == L'-' || c == L'_' || c == L'.' || c == L'~') {
-            encoded += c;
-        } else {
-            wchar_t buf[4];
-            swprintf(buf, L"%%%02X", (unsigned char)c);
-            encoded += buf;
-        }
+// Vai pelo HttpClient do loader (WinINet no Windows, epoll no Linux), que
+// mantém os sockets keep-alive entre as chamadas. Pode ser chamada de
+// várias threads. `status` recebe o código HTTP (0 se a requisição não
+// chegou ao servidor). São leituras idempotentes: vão com prazo, retries e
+// uma cópia extra (hedge) quando a primeira passa do p95 da rota.
+std::string HttpGet(const std::wstring& path, unsigned long* status = NULL) {
+    // Caminho em UTF-8; espaços e bytes fora do ASCII vão escapados
+    std::string url = "http://" + WideToUtf8(SERVER_HOST) + ":" + std::to_string(SERVER_PORT);
+    EncodeUrlPath(path, url);
+
+    RequestPolicy policy = RequestPolicy::Hedged();
+    policy.deadlineMs = 10000;
+    std::wstring route = path.substr(0, path.find(L'/', 6));  // "/auth/<rota>", sem appId/hwid
+    policy.endpoint.assign(route.begin(), route.end());
+
+    HttpRequest request;
+    request.url = url;
+    HttpResponse response = policy::Send(request, policy);
+    if (status) *status = response.status;
+    if (response.status == 0) {
+        logging::Error() << L"[ERRO] Falha ao conectar em " << SERVER_HOST;
+        return "";
     }
-    return encoded;
+    return response.body;
 }
 
 // ==================================================
-// FUNÇÃO PARA FAZER GET REQUEST
+// CACHE LOCAL DE USER INFO (TTL CURTO)
 // ==================================================
-std::string HttpGet(const std::wstring& path) {
-    std::string response;
-    
-    // Construir URL completa
-    std::wstring fullUrl = L"http://";
-    fullUrl += SERVER_HOST;
-    if (SERVER_PORT != 80) {
-        wchar_t portBuf[16];
-        swprintf(portBuf, L"%d", SERVER_PORT);
-        fullUrl += L":" + std::wstring(portBuf);
-    }
-    fullUrl += path;
-    
-    // Abrir sessão HTTP
-    HINTERNET hInternet = InternetOpenW(L"ScarletMenu/1.0",
-        INTERNET_OPEN_TYPE_DIRECT,
-        NULL,
-        NULL,
-        0);
-
-    if (!hInternet) {
-        std::wcerr << L"[ERRO] Falha ao abrir sessão HTTP" << std::endl;
-        return "";
-    }
+// Guarda as respostas de user e expiry (JSON compacto, uma linha cada)
+// com o horário da busca, o HWID e o app a que pertencem.
+struct UserInfoResponses {
+    std::string user;    // campos de /auth/get-user
+    std::string expiry;  // campos de /auth/get-expiry
+    bool fromCache = false;
+    bool fromLease = false;
+};
+
+std::string CacheKey(const std::wstring& hwid) {
+    return WideToUtf8(APP_ID + L"/" + hwid);
+}
 
-    // Abrir URL
-    HINTERNET hUrl = InternetOpenUrlW(hInternet,
-        fullUrl.c_str(),
-        NULL,
-        0,
-        INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE,
-        0);
-
-    if (!hUrl) {
-        std::wcerr << L"[ERRO] Falha ao abrir URL" << std::endl;
-        InternetCloseHandle(hInternet);
-        return "";
+bool LoadUserInfoCache(const std::wstring& hwid, UserInfoResponses& info) {
+    std::string path = LocalDataPath("userinfo.cache");
+    if (path.empty()) return false;
+    std::ifstream in(path);
+    if (!in) return false;
+
+    std::string line, key;
+    long long fetchedAt = 0;
+    UserInfoResponses cached;
+    while (std::getline(in, line)) {
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string name = line.substr(0, eq);
+        std::string value = line.substr(eq + 1);
+        if (name == "time") fetchedAt = strtoll(value.c_str(), NULL, 10);
+        else if (name == "key") key = value;
+        else if (name == "user") cached.user = value;
+        else if (name == "expiry") cached.expiry = value;
     }
 
-    // Ler resposta
-    char buffer[4096];
-    DWORD bytesRead;
+    long long age = (long long)time(NULL) - fetchedAt;
+    if (key != CacheKey(hwid) || age < 0 || age > CACHE_TTL_SECONDS) return false;
+    if (cached.user.empty() || cached.expiry.empty()) return false;
+
+    info = cached;
+    info.fromCache = true;
+    return true;
+}
 
-    while (InternetReadFile(hUrl, buffer, sizeof(buffer) - 1, &bytesRead) && bytesRead > 0) {
-        buffer[bytesRead] = 0;
-        response += buffer;
+void SaveUserInfoCache(const std::wstring& hwid, const UserInfoResponses& info) {
+    std::string path = LocalDataPath("userinfo.cache");
+    if (path.empty()) return;
+    if (info.user.find('\n') != std::string::npos || info.expiry.find('\n') != std::string::npos) return;
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) return;
+        out << "time=" << (long long)time(NULL) << "\n"
+            << "key=" << CacheKey(hwid) << "\n"
+            << "user=" << info.user << "\n"
+            << "expiry=" << info.expiry << "\n";
     }
+    std::remove(path.c_str());
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+// ==================================================
+// LEASE OFFLINE (ASSINADO PELO SERVIDOR)
+// ==================================================
+// Com LEASE_PUBLIC_KEY configurada, /auth/get-user-info traz um lease
+// Ed25519 com username, expiração e level deste HWID. Enquanto faltar mais
+// de um dia para ele vencer, o menu mostra esses dados sem ir ao servidor;
+// depois disso busca de novo e só usa o lease se o servidor não responder.
+LeaseStore& UserInfoLeases() {
+    static LeaseStore store(LocalDataPath("userinfo.lease"));
+    return store;
+}
+
+std::string LeaseKey(const std::wstring& hwid) {
+    return WideToUtf8(APP_SECRET) + ":" + CacheKey(hwid);
+}
+
+LeaseBinding UserInfoBinding(const std::wstring& hwid) {
+    return { lease_kind::kInfo, WideToUtf8(APP_ID), "", WideToUtf8(hwid), "" };
+}
 
-    // Limpar
-    InternetCloseHandle(hUrl);
-    InternetCloseHandle(hInternet);
+LeaseStatus LoadUserInfoLease(const std::wstring& hwid, LicenseLease& lease) {
+    if (LEASE_PUBLIC_KEY.empty()) return LeaseStatus::Missing;
+    return UserInfoLeases().Check(LeaseKey(hwid), LEASE_PUBLIC_KEY, UserInfoBinding(hwid), lease);
+}
 
-    return response;
+void SaveUserInfoLease(const std::wstring& hwid, const json::Document& doc) {
+    if (LEASE_PUBLIC_KEY.empty() || !doc.Has("lease.payload")) return;
+    LicenseLease lease;
+    lease.payload = doc.String("lease.payload");
+    lease.signature = doc.String("lease.sig");
+    UserInfoLeases().Save(LeaseKey(hwid), LEASE_PUBLIC_KEY, UserInfoBinding(hwid), lease);
+}
+
+// Monta as duas respostas a partir do lease; os dias restantes são
+// contados agora, não na emissão.
+void UserInfoFromLease(const LicenseLease& lease, UserInfoResponses& info) {
+    long long msLeft = lease.expiresMs - LeaseStore::NowMs();
+    long long daysLeft = msLeft > 0 ? (msLeft + 86400000LL - 1) / 86400000LL : 0;
+
+    std::string buffer;
+    info.user = json::Writer(buffer)
+        .Member("success", true)
+        .Member("username", lease.username)
+        .Member("created_at", lease.createdAt)
+        .Finish();
+    info.expiry = json::Writer(buffer)
+        .Member("success", true)
+        .Member("expires_at", lease.expiresAt)
+        .Member("days_remaining", std::to_string(daysLeft))
+        .Member("is_expired", msLeft <= 0)
+        .Member("subscription_type", lease.subscriptionType)
+        .Member("level", std::to_string(lease.level))
+        .Finish();
+    info.fromLease = true;
 }
 
 // ==================================================
-// PARSE SIMPLES DE JSON (apenas para demonstração)
+// BUSCA DE USER + EXPIRY
 // ==================================================
-std::string GetJsonValue(const std::string& json, const std::string& key) {
-    std::string searchKey = "\"" + key + "\":";
-    size_t pos = json.find(searchKey);
-    if (pos == std::string::npos) return "";
+// Ordem: cache local -> lease offline -> /auth/get-user-info (uma chamada)
+// -> servidores antigos: /auth/get-user e /auth/get-expiry em paralelo na
+// mesma conexão. Retorna false só quando não houve resposta do servidor
+// nem lease válido.
+bool FetchUserInfo(const std::wstring& hwid, UserInfoResponses& info) {
+    trace::Scope scope("FetchUserInfo");
+    if (LoadUserInfoCache(hwid, info)) return true;
+
+    LicenseLease lease;
+    LeaseStatus leaseStatus = LoadUserInfoLease(hwid, lease);
+    if (leaseStatus == LeaseStatus::Valid) {
+        UserInfoFromLease(lease, info);
+        return true;
+    }
 
-    pos += searchKey.length();
-    
-    // Pular espaços e aspas
-    while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\"')) pos++;
-    
-    size_t end = pos;
-    bool inString = json[pos - 1] == '\"';
-    
-    if (inString) {
-        end = json.find('\"', pos);
+    std::wstring query = APP_ID + L"/" + hwid + L"?appSecret=" + UrlEncode(APP_SECRET);
+
+    unsigned long status = 0;
+    std::string combined = HttpGet(L"/auth/get-user-info/" + query, &status);
+    if (leaseStatus == LeaseStatus::Renew && (status == 0 || status >= 500)) {
+        // Servidor fora do ar: o lease ainda vale
+        UserInfoFromLease(lease, info);
+        return true;
+    }
+    if (combined.empty()) return false;
+
+    json::Document doc;
+    doc.Parse(combined);
+    if (doc.Has("success")) {
+        // A resposta combinada traz os campos dos dois endpoints
+        info.user = combined;
+        info.expiry = combined;
+        if (doc.Bool("success")) SaveUserInfoLease(hwid, doc);
+        else if (status >= 400 && status < 500 && status != 429) UserInfoLeases().Clear();
     } else {
-        while (end < json.length() && json[end] != ',' && json[end] != '}' && json[end] != ' ') {
-            end++;
-        }
+        // Rota inexistente (servidor antigo): as duas buscas em paralelo
+        std::future<std::string> user = std::async(std::launch::async, [&query]() {
+            return HttpGet(L"/auth/get-user/" + query);
+        });
+        std::future<std::string> expiry = std::async(std::launch::async, [&query]() {
+            return HttpGet(L"/auth/get-expiry/" + query);
+        });
+        info.user = user.get();
+        info.expiry = expiry.get();
+        if (info.user.empty() || info.expiry.empty()) return false;
     }
-    
-    if (end == std::string::npos) return "";
-    
-    return json.substr(pos, end - pos);
-}
 
-bool GetJsonBool(const std::string& json, const std::string& key) {
-    std::string value = GetJsonValue(json, key);
-    return value == "true";
+    json::Document user, expiry;
+    user.Parse(info.user);
+    expiry.Parse(info.expiry);
+    if (user.Bool("success") && expiry.Bool("success")) SaveUserInfoCache(hwid, info);
+    return true;
 }
 
 // ==================================================
 // FUNÇÃO PRINCIPAL - OBTER USER E EXPIRY
 // ==================================================
 void GetUserInfo() {
-    std::wcout << L"================================================" << std::endl;
-    std::wcout << L"      SCARLET MENU - USER INFO FETCHER" << std::endl;
-    std::wcout << L"================================================" << std::endl;
-    std::wcout << std::endl;
+    logging::Info() << L"================================================";
+    logging::Info() << L"      SCARLET MENU - USER INFO FETCHER";
+    logging::Info() << L"================================================" << L"\n";
 
     // Passo 1: Obter HWID
-    std::wcout << L"[1/3] Obtendo HWID do sistema..." << std::endl;
+    logging::Info() << L"[1/3] Obtendo HWID do sistema...";
     std::wstring hwid = GetHWID();
-    std::wcout << L"      HWID: " << hwid << std::endl;
-    std::wcout << std::endl;
+    logging::Info() << L"      HWID: " << hwid << L"\n";
 
-    // Passo 2: Obter Username
-    std::wcout << L"[2/3] Buscando informações do usuário..." << std::endl;
-    
-    std::wstring getUserPath = L"/auth/get-user/" + APP_ID + L"/" + hwid + L"?appSecret=" + UrlEncode(APP_SECRET);
-    std::string userResponse = HttpGet(getUserPath);
+    // Passo 2: Obter Username e Expiry
+    logging::Info() << L"[2/3] Buscando informações do usuário...";
 
-    if (userResponse.empty()) {
-        std::wcerr << L"      [ERRO] Falha ao obter resposta do servidor" << std::endl;
+    UserInfoResponses info;
+    if (!FetchUserInfo(hwid, info)) {
+        logging::Error() << L"      [ERRO] Falha ao obter resposta do servidor";
         return;
     }
+    if (info.fromCache) {
+        logging::Info() << L"      (cache local, menos de " << CACHE_TTL_SECONDS << L"s)";
+    }
+    if (info.fromLease) {
+        logging::Info() << L"      (lease assinado pelo servidor, verificado offline)";
+    }
 
-    bool success = GetJsonBool(userResponse, "success");
+    // Parse único; os campos são lidos direto do buffer da resposta (json.h)
+    json::Document user;
+    user.Parse(info.user);
+    bool success = user.Bool("success");
     
     if (!success) {
-        std::string message = GetJsonValue(userResponse, "message");
-        std::wcout << L"      [ERRO] " << std::wstring(message.begin(), message.end()) << std::endl;
-        std::wcout << std::endl;
-        std::wcout << L"      HWID não registrado no sistema!" << std::endl;
-        std::wcout << L"      Faça login pelo Loader principal primeiro." << std::endl;
+        std::string message = user.String("message");
+        logging::Error() << L"      [ERRO] " << Utf8ToWide(message);
+        logging::Error() << L"\n      HWID não registrado no sistema!";
+        logging::Error() << L"      Faça login pelo Loader principal primeiro.";
         return;
     }
 
-    std::string username = GetJsonValue(userResponse, "username");
-    std::wcout << L"      ✓ Username: " << std::wstring(username.begin(), username.end()) << std::endl;
-    std::wcout << std::endl;
-
-    // Passo 3: Obter Expiry
-    std::wcout << L"[3/3] Buscando informações de expiração..." << std::endl;
-    
-    std::wstring getExpiryPath = L"/auth/get-expiry/" + APP_ID + L"/" + hwid + L"?appSecret=" + UrlEncode(APP_SECRET);
-    std::string expiryResponse = HttpGet(getExpiryPath);
+    // Textos do servidor vêm em UTF-8; convertidos uma vez para o console
+    std::wstring username = Utf8ToWide(user.String("username"));
+    logging::Info() << L"      ✓ Username: " << username << L"\n";
 
-    if (expiryResponse.empty()) {
-        std::wcerr << L"      [ERRO] Falha ao obter resposta do servidor" << std::endl;
-        return;
-    }
+    // Passo 3: Exibir Expiry
+    logging::Info() << L"[3/3] Informações de expiração...";
 
-    success = GetJsonBool(expiryResponse, "success");
+    json::Document expiry;
+    expiry.Parse(info.expiry);
+    success = expiry.Bool("success");
     
     if (!success) {
-        std::string message = GetJsonValue(expiryResponse, "message");
-        std::wcout << L"      [ERRO] " << std::wstring(message.begin(), message.end()) << std::endl;
+        std::string message = expiry.String("message");
+        logging::Error() << L"      [ERRO] " << Utf8ToWide(message);
         return;
     }
 
-    std::string expiresAt = GetJsonValue(expiryResponse, "expires_at");
-    std::string daysRemaining = GetJsonValue(expiryResponse, "days_remaining");
-    std::string isExpired = GetJsonValue(expiryResponse, "is_expired");
-    std::string level = GetJsonValue(expiryResponse, "level");
+    std::wstring expiresAt = Utf8ToWide(expiry.View("expires_at"));
+    std::wstring daysRemaining = Utf8ToWide(expiry.View("days_remaining"));
+    bool isExpired = expiry.Bool("is_expired");
+    std::wstring level = Utf8ToWide(expiry.View("level"));
 
-    std::wcout << L"      ✓ Expira em: " << std::wstring(expiresAt.begin(), expiresAt.end()) << std::endl;
-    std::wcout << L"      ✓ Dias restantes: " << std::wstring(daysRemaining.begin(), daysRemaining.end()) << std::endl;
-    std::wcout << L"      ✓ Level: " << std::wstring(level.begin(), level.end()) << std::endl;
-    std::wcout << L"      ✓ Status: " << (isExpired == "true" ? L"EXPIRADO" : L"ATIVO") << std::endl;
-    std::wcout << std::endl;
+    logging::Info() << L"      ✓ Expira em: " << expiresAt;
+    logging::Info() << L"      ✓ Dias restantes: " << daysRemaining;
+    logging::Info() << L"      ✓ Level: " << level;
+    logging::Info() << L"      ✓ Status: " << (isExpired ? L"EXPIRADO" : L"ATIVO") << L"\n";
 
     // Exibir resumo final
-    std::wcout << L"================================================" << std::endl;
-    std::wcout << L"           INFORMAÇÕES CARREGADAS!" << std::endl;
-    std::wcout << L"================================================" << std::endl;
-    std::wcout << L"  Usuário: " << std::wstring(username.begin(), username.end()) << std::endl;
-    std::wcout << L"  Dias restantes: " << std::wstring(daysRemaining.begin(), daysRemaining.end()) << std::endl;
-    std::wcout << L"  Level: " << std::wstring(level.begin(), level.end()) << std::endl;
-    std::wcout << L"================================================" << std::endl;
+    logging::Success() << L"================================================";
+    logging::Success() << L"           INFORMAÇÕES CARREGADAS!";
+    logging::Success() << L"================================================";
+    logging::Success() << L"  Usuário: " << username;
+    logging::Success() << L"  Dias restantes: " << daysRemaining;
+    logging::Success() << L"  Level: " << level;
+    logging::Success() << L"================================================";
 }
 
 // ==================================================
 // MAIN
 // ==================================================
 int main() {
-    // Configurar console para UTF-16
-    _setmode(_fileno(stdout), _O_U16TEXT);
-    _setmode(_fileno(stderr), _O_U16TEXT);
+    trace::StartFromEnvironment();
 
+    // O log converte o texto (UTF-8) para o console: UTF-16 no Windows, bytes no resto
+    if (LOG_FILE_BYTES > 0) logging::Logger::Instance().OpenFile(LocalDataPath("menu_fetcher.log"), LOG_FILE_BYTES);
+
+#ifdef _WIN32
     SetConsoleTitleW(L"Scarlet Menu - User Info");
+#endif
 
-    std::wcout << std::endl;
-    std::wcout << L"⚠️  IMPORTANTE: Configure SERVER_HOST, APP_ID e APP_SECRET" << std::endl;
-    std::wcout << L"   no código antes de compilar!" << std::endl;
-    std::wcout << std::endl;
+    logging::Info() << L"\n⚠️  IMPORTANTE: Configure SERVER_HOST, APP_ID e APP_SECRET";
+    logging::Info() << L"   no código antes de compilar!" << L"\n";
 
     GetUserInfo();
+    HttpClient::Instance().Shutdown();
+
+    std::ostringstream timing;
+    trace::Finish(timing);
+    logging::Lines(logging::Level::Info, timing.str());
 
-    std::wcout << std::endl;
-    std::wcout << L"Pressione ENTER para sair...";
-    std::wcin.get();
+    logging::Prompt("\nPressione ENTER para sair...");
+    std::cin.get();
 
     return 0;
 }
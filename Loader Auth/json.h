@@ -0,0 +1,498 @@
+#pragma once
+
+// Single-pass JSON reader for API responses, plus a writer for request
+// bodies.
+//
+// Parse() walks the body once and records every member (at any depth) as
+// a string_view into the original text, so lookups never rescan the body
+// and never copy. Strings are only unescaped when asked for with String().
+// The source text must outlive the Document.
+//
+// Writer appends an object into a caller-owned buffer that keeps its
+// capacity between requests; Fragment serializes constant members at
+// compile time so they are copied into the body with a single append.
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+namespace json {
+
+enum class Type { Null, Bool, Number, String, Object, Array };
+
+struct Value {
+    Type type = Type::Null;
+    std::string_view text;  // String: contents without quotes (still escaped); otherwise the raw span
+    bool escaped = false;   // String contains backslash escapes
+};
+
+// Decodes JSON string escapes (including \uXXXX surrogate pairs) to UTF-8.
+inline std::string Unescape(std::string_view s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); i++) {
+        char c = s[i];
+        if (c != '\\' || i + 1 >= s.size()) {
+            out += c;
+            continue;
+        }
+        c = s[++i];
+        switch (c) {
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+            if (i + 4 >= s.size()) return out;
+            unsigned long cp = strtoul(std::string(s.substr(i + 1, 4)).c_str(), NULL, 16);
+            i += 4;
+            if (cp >= 0xD800 && cp <= 0xDBFF && i + 6 < s.size() && s[i + 1] == '\\' && s[i + 2] == 'u') {
+                unsigned long low = strtoul(std::string(s.substr(i + 3, 4)).c_str(), NULL, 16);
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+            }
+            if (cp < 0x80) {
+                out += (char)cp;
+            } else if (cp < 0x800) {
+                out += (char)(0xC0 | (cp >> 6));
+                out += (char)(0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+                out += (char)(0xE0 | (cp >> 12));
+                out += (char)(0x80 | ((cp >> 6) & 0x3F));
+                out += (char)(0x80 | (cp & 0x3F));
+            } else {
+                out += (char)(0xF0 | (cp >> 18));
+                out += (char)(0x80 | ((cp >> 12) & 0x3F));
+                out += (char)(0x80 | ((cp >> 6) & 0x3F));
+                out += (char)(0x80 | (cp & 0x3F));
+            }
+            break;
+        }
+        default: out += c; break; // \" \\ \/
+        }
+    }
+    return out;
+}
+
+class Document {
+public:
+    static const int kMaxDepth = 32;
+
+    Document() { fields_.reserve(32); }
+
+    // Returns false on malformed input (members parsed before the error
+    // are still available).
+    bool Parse(std::string_view text) {
+        fields_.clear();
+        p_ = text.data();
+        end_ = text.data() + text.size();
+
+        SkipSpace();
+        if (p_ >= end_) return false;
+        if (*p_ == '{') return ParseObject(-1, 0) && (SkipSpace(), p_ == end_);
+        if (*p_ == '[') return ParseArray(-1, 0) && (SkipSpace(), p_ == end_);
+        return false;
+    }
+
+    // Looks up a member by dotted path, e.g. "license.success". Array
+    // elements are addressed by index ("products.0.name").
+    const Value* Find(std::string_view path) const {
+        int index = FindIndex(path);
+        return index < 0 ? NULL : &fields_[index].value;
+    }
+
+    bool Has(std::string_view path) const { return Find(path) != NULL; }
+
+    // Raw text of the value, zero-copy. For strings this is the still-escaped
+    // contents; use String() when the value may contain escapes.
+    std::string_view View(std::string_view path) const {
+        const Value* v = Find(path);
+        return v ? v->text : std::string_view();
+    }
+
+    // Decoded string value; numbers and booleans come back as their literal
+    // text and null/missing as "".
+    std::string String(std::string_view path) const {
+        const Value* v = Find(path);
+        if (!v || v->type == Type::Null) return "";
+        if (v->type == Type::String && v->escaped) return Unescape(v->text);
+        return std::string(v->text);
+    }
+
+    bool Bool(std::string_view path) const {
+        const Value* v = Find(path);
+        return v && v->type == Type::Bool && v->text == "true";
+    }
+
+    long long Int(std::string_view path, long long fallback = 0) const {
+        const Value* v = Find(path);
+        if (!v || v->type != Type::Number) return fallback;
+        return strtoll(std::string(v->text).c_str(), NULL, 10);
+    }
+
+    double Number(std::string_view path, double fallback = 0) const {
+        const Value* v = Find(path);
+        if (!v || v->type != Type::Number) return fallback;
+        return strtod(std::string(v->text).c_str(), NULL);
+    }
+
+    // True when the array at `path` holds a string equal to `value`.
+    bool ArrayContains(std::string_view path, std::string_view value) const {
+        int parent = FindIndex(path);
+        if (parent < 0 || fields_[parent].value.type != Type::Array) return false;
+        for (size_t i = parent + 1; i < fields_.size(); i++) {
+            const Field& f = fields_[i];
+            if (f.parent == parent && f.value.type == Type::String && f.value.text == value) return true;
+        }
+        return false;
+    }
+
+    size_t Size() const { return fields_.size(); }
+
+private:
+    struct Field {
+        std::string_view key;
+        Value value;
+        int parent;  // index of the enclosing object/array, -1 for the root
+    };
+
+    int FindChild(int parent, std::string_view key) const {
+        // Children always follow their parent in document order
+        if (parent >= 0 && fields_[parent].value.type == Type::Array) return FindElement(parent, key);
+        for (size_t i = parent + 1; i < fields_.size(); i++) {
+            if (fields_[i].parent == parent && fields_[i].key == key) return (int)i;
+        }
+        return -1;
+    }
+
+    int FindElement(int parent, std::string_view index) const {
+        if (index.empty() || index.size() > 9) return -1;
+        size_t n = 0;
+        for (char c : index) {
+            if (c < '0' || c > '9') return -1;
+            n = n * 10 + (size_t)(c - '0');
+        }
+        for (size_t i = parent + 1; i < fields_.size(); i++) {
+            if (fields_[i].parent == parent && n-- == 0) return (int)i;
+        }
+        return -1;
+    }
+
+    int FindIndex(std::string_view path) const {
+        int index = -1;
+        while (!path.empty()) {
+            size_t dot = path.find('.');
+            std::string_view key = path.substr(0, dot);
+            path = dot == std::string_view::npos ? std::string_view() : path.substr(dot + 1);
+
+            index = FindChild(index, key);
+            if (index < 0) return -1;
+        }
+        return index;
+    }
+
+    void SkipSpace() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) p_++;
+    }
+
+    // p_ is on the opening quote; leaves p_ after the closing quote.
+    bool ScanString(std::string_view& out, bool& escaped) {
+        const char* start = ++p_;
+        escaped = false;
+        while (p_ < end_ && *p_ != '"') {
+            if (*p_ == '\\') {
+                escaped = true;
+                p_++;
+            }
+            p_++;
+        }
+        if (p_ >= end_) return false;
+        out = std::string_view(start, p_ - start);
+        p_++;
+        return true;
+    }
+
+    bool ParseValue(int parent, std::string_view key, int depth) {
+        SkipSpace();
+        if (p_ >= end_) return false;
+
+        const char* start = p_;
+        char c = *p_;
+
+        if (c == '{' || c == '[') {
+            if (depth >= kMaxDepth) return false;
+            int index = (int)fields_.size();
+            fields_.push_back(Field{ key, Value{ c == '{' ? Type::Object : Type::Array, std::string_view(), false }, parent });
+            bool ok = c == '{' ? ParseObject(index, depth + 1) : ParseArray(index, depth + 1);
+            fields_[index].value.text = std::string_view(start, p_ - start);
+            return ok;
+        }
+
+        Value value;
+        if (c == '"') {
+            value.type = Type::String;
+            if (!ScanString(value.text, value.escaped)) return false;
+        } else if (c == 't' || c == 'f' || c == 'n') {
+            std::string_view literal = c == 't' ? "true" : c == 'f' ? "false" : "null";
+            if ((size_t)(end_ - p_) < literal.size() || std::string_view(p_, literal.size()) != literal) return false;
+            value.type = c == 'n' ? Type::Null : Type::Bool;
+            value.text = literal;
+            p_ += literal.size();
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            while (p_ < end_ && (*p_ == '-' || *p_ == '+' || *p_ == '.' || *p_ == 'e' || *p_ == 'E' || (*p_ >= '0' && *p_ <= '9'))) p_++;
+            value.type = Type::Number;
+            value.text = std::string_view(start, p_ - start);
+        } else {
+            return false;
+        }
+
+        fields_.push_back(Field{ key, value, parent });
+        return true;
+    }
+
+    // p_ is on '{'.
+    bool ParseObject(int parent, int depth) {
+        p_++;
+        SkipSpace();
+        if (p_ < end_ && *p_ == '}') {
+            p_++;
+            return true;
+        }
+        for (;;) {
+            SkipSpace();
+            if (p_ >= end_ || *p_ != '"') return false;
+            std::string_view key;
+            bool escaped;
+            if (!ScanString(key, escaped)) return false;
+
+            SkipSpace();
+            if (p_ >= end_ || *p_ != ':') return false;
+            p_++;
+            if (!ParseValue(parent, key, depth)) return false;
+
+            SkipSpace();
+            if (p_ >= end_) return false;
+            if (*p_ == ',') { p_++; continue; }
+            if (*p_ == '}') { p_++; return true; }
+            return false;
+        }
+    }
+
+    // p_ is on '['.
+    bool ParseArray(int parent, int depth) {
+        p_++;
+        SkipSpace();
+        if (p_ < end_ && *p_ == ']') {
+            p_++;
+            return true;
+        }
+        for (;;) {
+            if (!ParseValue(parent, std::string_view(), depth)) return false;
+            SkipSpace();
+            if (p_ >= end_) return false;
+            if (*p_ == ',') { p_++; continue; }
+            if (*p_ == ']') { p_++; return true; }
+            return false;
+        }
+    }
+
+    std::vector<Field> fields_;
+    const char* p_ = NULL;
+    const char* end_ = NULL;
+};
+
+// --- WRITER ---
+
+constexpr bool NeedsEscape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// Length of the prefix of `s` that can be copied without escaping.
+// Checks eight bytes at a time: a byte needs escaping when it is below
+// 0x20 or equal to '"' or '\\'.
+inline bool WordNeedsEscape(const char* p) {
+    const unsigned long long ones = 0x0101010101010101ULL;
+    const unsigned long long high = 0x8080808080808080ULL;
+    unsigned long long w;
+    memcpy(&w, p, 8);
+    unsigned long long quote = w ^ (ones * '"');
+    unsigned long long slash = w ^ (ones * '\\');
+    unsigned long long hit = ((w - ones * 0x20) & ~w) |
+                             ((quote - ones) & ~quote) |
+                             ((slash - ones) & ~slash);
+    return (hit & high) != 0;
+}
+
+inline size_t CleanPrefix(std::string_view s) {
+    size_t i = 0;
+    for (; i + 8 <= s.size(); i += 8) {
+        if (WordNeedsEscape(s.data() + i)) break;
+    }
+    // The tail is covered by one overlapping read of the last word
+    if (i + 8 > s.size() && s.size() >= 8 && i < s.size() && !WordNeedsEscape(s.data() + s.size() - 8)) {
+        return s.size();
+    }
+    while (i < s.size() && !NeedsEscape((unsigned char)s[i])) i++;
+    return i;
+}
+
+// Writes the JSON escape sequence for `c` into `seq` and returns its
+// length, or returns 0 when `c` can be emitted as is. Bytes >= 0x80 are
+// passed through, so UTF-8 input stays UTF-8.
+constexpr size_t EscapeChar(unsigned char c, char* seq) {
+    const char* hex = "0123456789abcdef";
+    if (!NeedsEscape(c)) return 0;
+    seq[0] = '\\';
+    switch (c) {
+    case '"':  seq[1] = '"';  return 2;
+    case '\\': seq[1] = '\\'; return 2;
+    case '\b': seq[1] = 'b';  return 2;
+    case '\f': seq[1] = 'f';  return 2;
+    case '\n': seq[1] = 'n';  return 2;
+    case '\r': seq[1] = 'r';  return 2;
+    case '\t': seq[1] = 't';  return 2;
+    default:
+        seq[1] = 'u';
+        seq[2] = '0';
+        seq[3] = '0';
+        seq[4] = hex[c >> 4];
+        seq[5] = hex[c & 15];
+        return 6;
+    }
+}
+
+// Appends `s` escaped as the contents of a JSON string. Unescaped runs are
+// copied in one append.
+inline void AppendEscaped(std::string& out, std::string_view s) {
+    size_t run = 0;
+    for (size_t i = CleanPrefix(s); i < s.size(); i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (!NeedsEscape(c)) continue;
+        char seq[6];
+        out.append(s.data() + run, i - run);
+        out.append(seq, EscapeChar(c, seq));
+        run = i + 1;
+    }
+    out.append(s.data() + run, s.size() - run);
+}
+
+// Comma-separated object members built at compile time:
+//
+//   constexpr auto kApp = json::Fragment<128>().Member("name", APP_NAME);
+//
+// Exceeding Capacity is a compile error when used in a constexpr.
+template <size_t Capacity>
+class Fragment {
+public:
+    constexpr Fragment() : data_(), size_(0) {}
+
+    constexpr Fragment Member(std::string_view key, std::string_view value) const {
+        Fragment out = *this;
+        if (out.size_) out.Put(',');
+        out.Put('"');
+        for (size_t i = 0; i < key.size(); i++) out.Put(key[i]);
+        out.Put('"');
+        out.Put(':');
+        out.Put('"');
+        for (size_t i = 0; i < value.size(); i++) {
+            char seq[6] = { 0 };
+            size_t n = EscapeChar((unsigned char)value[i], seq);
+            if (n == 0) out.Put(value[i]);
+            for (size_t j = 0; j < n; j++) out.Put(seq[j]);
+        }
+        out.Put('"');
+        return out;
+    }
+
+    constexpr std::string_view View() const { return std::string_view(data_, size_); }
+
+private:
+    constexpr void Put(char c) { data_[size_++] = c; }
+
+    char data_[Capacity];
+    size_t size_;
+};
+
+// Builds one JSON object into `out`, replacing its contents but keeping
+// its capacity. Keys are expected to be plain literals; values are
+// escaped.
+class Writer {
+public:
+    explicit Writer(std::string& out) : out_(out) {
+        out_.clear();
+        out_ += '{';
+    }
+
+    Writer& Member(std::string_view key, std::string_view value) {
+        // The common case (nothing to escape) is written with one resize
+        size_t clean = CleanPrefix(value);
+
+        bool done = clean == value.size();
+        char* p = Key(key, 1 + clean + (done ? 1 : 0));
+        *p++ = '"';
+        memcpy(p, value.data(), clean);
+        if (done) {
+            p[clean] = '"';
+            return *this;
+        }
+        AppendEscaped(out_, value.substr(clean));
+        out_ += '"';
+        return *this;
+    }
+
+    // Without this, string literals would convert to bool below
+    Writer& Member(std::string_view key, const char* value) {
+        return Member(key, std::string_view(value));
+    }
+
+    Writer& Member(std::string_view key, bool value) {
+        std::string_view text = value ? "true" : "false";
+        memcpy(Key(key, text.size()), text.data(), text.size());
+        return *this;
+    }
+
+    // Appends members serialized ahead of time (see Fragment).
+    template <size_t Capacity>
+    Writer& Members(const Fragment<Capacity>& fragment) {
+        return Members(fragment.View());
+    }
+
+    Writer& Members(std::string_view members) {
+        if (members.empty()) return *this;
+        if (out_.size() > 1) out_ += ',';
+        out_.append(members.data(), members.size());
+        return *this;
+    }
+
+    // Closes the object; the buffer holds the finished body.
+    const std::string& Finish() {
+        out_ += '}';
+        return out_;
+    }
+
+private:
+    // Writes `,"key":` and reserves `extra` bytes after it; returns a
+    // pointer to that space.
+    char* Key(std::string_view key, size_t extra) {
+        size_t pos = out_.size();
+        bool comma = pos > 1;
+        out_.resize(pos + comma + key.size() + 3 + extra);
+        char* p = &out_[pos];
+        if (comma) *p++ = ',';
+        *p++ = '"';
+        memcpy(p, key.data(), key.size());
+        p += key.size();
+        *p++ = '"';
+        *p++ = ':';
+        return p;
+    }
+
+    std::string& out_;
+};
+
+} // namespace json
@@ -0,0 +1,234 @@
+#pragma once
+
+// Offline license leases.
+//
+// A lease is a statement signed by the server with Ed25519: this subject
+// (license key or username) may run this app on this HWID until
+// lease_expires. The
+// client keeps the last lease it was given and authenticates from it
+// without a round trip while more than kRenewMs of it is left; after that
+// it goes back online for a fresh one, and falls back to the lease only
+// when the server can't be reached. A server refusal deletes the lease.
+//
+// Only the server's signature makes a lease valid. The file itself is
+// MAC'd like the session cache, so an edited or copied file is dropped
+// before the signature is even checked.
+
+#include <string>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include "paths.h"
+#include "sha256.h"
+#include "ed25519.h"
+#include "json.h"
+
+// Lease kinds, as issued by the server
+namespace lease_kind {
+const char kLicense[] = "license";   // subject: license key
+const char kLogin[] = "login";       // subject: username
+const char kInfo[] = "info";         // menu fetcher, subject: username
+}
+
+struct LicenseLease {
+    std::string payload;         // signed JSON, exactly as issued
+    std::string signature;       // hex Ed25519 signature of payload
+    std::string secret;          // login leases: HMAC of the password over the payload
+
+    // Payload fields
+    std::string kind;
+    std::string appId;
+    std::string subject;
+    std::string hwid;
+    std::string username;
+    std::string expiresAt;       // subscription expiry, as stored by the server
+    std::string createdAt;
+    std::string subscriptionType;
+    long long level = 0;
+    long long expiresMs = 0;     // subscription expiry, unix milliseconds
+    long long issuedAt = 0;
+    long long leaseExpires = 0;  // unix milliseconds, never after expiresMs
+};
+
+// What the lease must match to be accepted.
+struct LeaseBinding {
+    const char* kind;
+    std::string appId;           // empty: no app known yet, nothing matches
+    std::string subject;         // empty: any (menu fetcher)
+    std::string hwid;
+    std::string password;        // login leases only
+};
+
+enum class LeaseStatus {
+    Missing,   // no usable lease: authenticate online
+    Valid,     // authenticate offline
+    Renew      // still valid but ending soon: go online, keep it as a fallback
+};
+
+struct LeaseStats {
+    unsigned long offline = 0;   // launches authenticated from the lease alone
+    unsigned long renewals = 0;  // leases close to expiry, revalidated online
+    unsigned long fallbacks = 0; // server unreachable, lease accepted instead
+    unsigned long misses = 0;    // no usable lease
+    unsigned long saved = 0;     // fresh leases stored
+};
+
+class LeaseStore {
+public:
+    // --- CONFIG ---
+    static const long long kRenewMs = 24LL * 60 * 60 * 1000;  // go online once less than this is left
+    static const long long kClockSkewMs = 5 * 60 * 1000;      // a clock set before issued_at rejects the lease
+    static const int kVersion = 1;
+
+    static LeaseStore& Instance() {
+        static LeaseStore instance(LocalDataPath("lease.cache"));
+        return instance;
+    }
+
+    explicit LeaseStore(const std::string& path) : path_(path) {}
+
+    // Loads the stored lease and checks it: file MAC under `key`, server
+    // signature under `publicKeyHex` (64 hex chars) and the binding.
+    LeaseStatus Check(const std::string& key, const std::string& publicKeyHex, const LeaseBinding& binding,
+                      LicenseLease& lease) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        LicenseLease stored;
+        if (!Read(key, stored) || !Verify(publicKeyHex, stored) || !Matches(stored, binding, stored.secret)) {
+            stats_.misses++;
+            return LeaseStatus::Missing;
+        }
+
+        long long left = stored.leaseExpires - NowMs();
+        if (left <= 0 || stored.issuedAt - kClockSkewMs > NowMs()) {
+            stats_.misses++;
+            return LeaseStatus::Missing;
+        }
+
+        lease = stored;
+        if (left < kRenewMs) {
+            stats_.renewals++;
+            return LeaseStatus::Renew;
+        }
+        stats_.offline++;
+        return LeaseStatus::Valid;
+    }
+
+    // Verifies a lease from a server response and stores it. Returns false
+    // (and keeps the old file) when it doesn't verify or match `binding`.
+    bool Save(const std::string& key, const std::string& publicKeyHex, const LeaseBinding& binding,
+              LicenseLease& lease) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (path_.empty() || !Verify(publicKeyHex, lease)) return false;
+        if (lease.kind == lease_kind::kLogin) lease.secret = PasswordVerifier(binding.password, lease.payload);
+        if (!Matches(lease, binding, lease.secret)) return false;
+        if (lease.payload.find('\n') != std::string::npos) return false;
+
+        std::ostringstream body;
+        body << "version=" << kVersion << "\n"
+             << "payload=" << lease.payload << "\n"
+             << "sig=" << lease.signature << "\n"
+             << "secret=" << lease.secret << "\n";
+
+        std::string tmp = path_ + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out) return false;
+            out << body.str() << "mac=" << HmacSha256Hex(key, body.str()) << "\n";
+        }
+        std::remove(path_.c_str());
+        std::rename(tmp.c_str(), path_.c_str());
+        stats_.saved++;
+        return true;
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!path_.empty()) std::remove(path_.c_str());
+    }
+
+    void CountFallback() { std::lock_guard<std::mutex> lock(mutex_); stats_.fallbacks++; }
+
+    LeaseStats Stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    // Checks the server's signature and fills in the payload fields.
+    static bool Verify(const std::string& publicKeyHex, LicenseLease& lease) {
+        unsigned char publicKey[ed25519::kPublicKeySize];
+        unsigned char signature[ed25519::kSignatureSize];
+        if (!HexDecode(publicKeyHex, publicKey, sizeof(publicKey))) return false;
+        if (!HexDecode(lease.signature, signature, sizeof(signature))) return false;
+        if (!ed25519::Verify(signature, lease.payload, publicKey)) return false;
+
+        json::Document doc;
+        if (!doc.Parse(lease.payload) || doc.Int("v") != 1) return false;
+        lease.kind = doc.String("kind");
+        lease.appId = doc.String("appId");
+        lease.subject = doc.String("subject");
+        lease.hwid = doc.String("hwid");
+        lease.username = doc.String("username");
+        lease.expiresAt = doc.String("expires_at");
+        lease.createdAt = doc.String("created_at");
+        lease.subscriptionType = doc.String("subscription_type");
+        lease.level = doc.Int("level");
+        lease.expiresMs = doc.Int("expires_ms");
+        lease.issuedAt = doc.Int("issued_at");
+        lease.leaseExpires = doc.Int("lease_expires");
+        return !lease.kind.empty() && !lease.hwid.empty() && lease.leaseExpires > 0;
+    }
+
+    static long long NowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    // Reads the file; true when it is intact (MAC matches `key`).
+    bool Read(const std::string& key, LicenseLease& lease) {
+        if (path_.empty()) return false;
+        std::ifstream in(path_);
+        if (!in) return false;
+
+        std::string line, body, mac;
+        int version = 0;
+        while (std::getline(in, line)) {
+            size_t eq = line.find('=');
+            if (eq == std::string::npos) continue;
+            std::string name = line.substr(0, eq);
+            std::string value = line.substr(eq + 1);
+            if (name == "mac") {
+                mac = value;
+                continue;
+            }
+            body += line + "\n";
+            if (name == "version") version = atoi(value.c_str());
+            else if (name == "payload") lease.payload = value;
+            else if (name == "sig") lease.signature = value;
+            else if (name == "secret") lease.secret = value;
+        }
+        return version == kVersion && DigestEquals(mac, HmacSha256Hex(key, body)) && !lease.payload.empty();
+    }
+
+    static bool Matches(const LicenseLease& lease, const LeaseBinding& binding, const std::string& secret) {
+        if (lease.kind != binding.kind || lease.hwid != binding.hwid) return false;
+        if (binding.appId.empty() || lease.appId != binding.appId) return false;
+        if (!binding.subject.empty() && lease.subject != binding.subject) return false;
+        if (lease.kind == lease_kind::kLogin) {
+            return !secret.empty() && DigestEquals(secret, PasswordVerifier(binding.password, lease.payload));
+        }
+        return true;
+    }
+
+    // Ties a login lease to the password without storing it.
+    static std::string PasswordVerifier(const std::string& password, const std::string& payload) {
+        return HmacSha256Hex(password, "lease-password:" + payload);
+    }
+
+    std::string path_;
+    std::mutex mutex_;
+    LeaseStats stats_;
+};
@@ -0,0 +1,242 @@
+// Headless load generator for the auth backend.
+//
+// Runs N simulated loader clients through the same request code as the
+// interactive loader (AuthClient): init -> license or login -> HWID,
+// components and login log -> payload URL. Clients arrive open-loop at a
+// configurable rate (Poisson) and are served by a pool of worker threads.
+// Prints p50/p95/p99 latency per endpoint, the error rate and throughput.
+//
+//   scarlet_loadgen [--url http://127.0.0.1:8080] [--clients 1000] [--rate 200]
+//                   [--workers 64] [--mode license|login|mixed] [--product name]
+//
+// Point it at loadgen_server.js (stand-in) or a staging deployment of
+// auth-api.js; license keys and logins are synthetic.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "auth_client.h"
+#include "trace.h"
+
+// --- OPTIONS ---
+
+struct LoadOptions {
+    std::string url = "http://127.0.0.1:8080";
+    unsigned clients = 1000;
+    double rate = 200;         // arrivals per second; 0 starts every client at once
+    unsigned workers = 64;     // clients in flight at most
+    std::string mode = "license";
+    std::string product = "loadgen";
+};
+
+static bool ParseOptions(int argc, char** argv, LoadOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+        if (i + 1 >= argc) return false;
+        const char* value = argv[++i];
+        if (name == "--url") options.url = value;
+        else if (name == "--clients") options.clients = (unsigned)atoi(value);
+        else if (name == "--rate") options.rate = atof(value);
+        else if (name == "--workers") options.workers = (unsigned)atoi(value);
+        else if (name == "--mode") options.mode = value;
+        else if (name == "--product") options.product = value;
+        else return false;
+    }
+    return options.clients > 0 && options.workers > 0 && options.rate >= 0 &&
+           (options.mode == "license" || options.mode == "login" || options.mode == "mixed");
+}
+
+// --- RESULTS ---
+
+struct Samples {
+    std::vector<double> ms;
+    unsigned long errors = 0;
+};
+
+class Recorder {
+public:
+    void Add(const std::string& name, double ms, bool ok) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Samples& samples = samples_[name];
+        samples.ms.push_back(ms);
+        if (!ok) samples.errors++;
+    }
+
+    std::map<std::string, Samples> Take() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return samples_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, Samples> samples_;
+};
+
+// Nearest-rank percentile of sorted values.
+static double Percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > sorted.size()) rank = sorted.size();
+    return sorted[rank - 1];
+}
+
+static void PrintRow(const std::string& name, Samples samples) {
+    std::sort(samples.ms.begin(), samples.ms.end());
+    double errorRate = samples.ms.empty() ? 0 : 100.0 * samples.errors / samples.ms.size();
+    std::cout << std::left << std::setw(24) << name << std::right
+              << std::setw(8) << samples.ms.size()
+              << std::setw(8) << std::fixed << std::setprecision(2) << errorRate
+              << std::setw(10) << std::setprecision(2) << Percentile(samples.ms, 50)
+              << std::setw(10) << Percentile(samples.ms, 95)
+              << std::setw(10) << Percentile(samples.ms, 99) << "\n";
+}
+
+// --- SIMULATED CLIENT ---
+
+// One loader launch, as main() runs it once the user picked an option.
+// Returns true when the client got authenticated and a payload URL.
+static bool RunClient(const LoadOptions& options, unsigned index, Recorder& recorder) {
+    static const char kInitMembers[] =
+        "\"name\":\"Scarlet External\",\"ownerId\":\"loadgen\",\"secret\":\"loadgen\",\"version\":\"1.0\"";
+
+    std::ostream quiet(nullptr);  // discards the client's progress messages
+    AuthClient client(options.url, kInitMembers, "1.0", quiet);
+    client.SetObserver([&recorder](const char* endpoint, double ms, bool ok) {
+        recorder.Add(endpoint, ms, ok);
+    });
+
+    HardwareInfo hardware;
+    hardware.hwid = "LOADGEN-" + std::to_string(index);
+    hardware.gpu = "Simulated GPU";
+    hardware.motherboard = "Simulated Board";
+    hardware.cpu = "Simulated CPU";
+    client.SetHardware(hardware);
+
+    if (!client.Initialize()) return false;
+
+    bool useLogin = options.mode == "login" || (options.mode == "mixed" && index % 2 == 1);
+    std::string key = "LOADGEN-KEY-" + std::to_string(index);
+
+    if (useLogin) {
+        std::string username = "loadgen" + std::to_string(index);
+        if (!client.Login(username, "loadgen")) return false;
+        client.SendLoginLog(username);
+    } else if (client.ServerBatch()) {
+        if (!client.ActivateLicenseBatch(key)) return false;
+    } else {
+        if (!client.CheckLicense(key)) return false;
+        // Same calls as the loader against older servers, in order: an
+        // AuthClient (and its output stream) is not shared across threads
+        client.SendComponents(key);
+        client.SendLoginLog(key);
+        client.SendHWID(key);
+    }
+
+    PayloadTicket ticket;
+    return client.RequestPayload(key, options.product, "", "", ticket);
+}
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::cerr << "usage: scarlet_loadgen [--url URL] [--clients N] [--rate PER_SEC] [--workers N]\n"
+                     "                       [--mode license|login|mixed] [--product NAME]\n";
+        return 2;
+    }
+
+    trace::StartFromEnvironment();
+
+    std::cout << "[*] " << options.clients << " clients -> " << options.url << " ("
+              << options.mode << ", " << options.rate << "/s, " << options.workers << " workers)" << std::endl;
+
+    // Open-loop arrivals: exponential gaps around 1/rate, fixed seed so runs
+    // are comparable
+    std::vector<double> arrivals(options.clients, 0);
+    std::mt19937 rng(12345);
+    std::exponential_distribution<double> gap(options.rate > 0 ? options.rate : 1);
+    for (unsigned i = 1; i < options.clients && options.rate > 0; i++) arrivals[i] = arrivals[i - 1] + gap(rng);
+
+    Recorder recorder;
+    std::atomic<unsigned> next(0);
+    std::atomic<unsigned> failed(0);
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < std::min(options.workers, options.clients); w++) {
+        workers.emplace_back([&]() {
+            for (;;) {
+                unsigned index = next++;
+                if (index >= options.clients) return;
+
+                auto due = started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(arrivals[index]));
+                std::this_thread::sleep_until(due);
+
+                // Time spent waiting for a free worker after the arrival
+                auto begin = std::chrono::steady_clock::now();
+                recorder.Add("(queue delay)", std::chrono::duration<double, std::milli>(begin - due).count(), true);
+
+                bool ok = RunClient(options, index, recorder);
+                if (!ok) failed++;
+                recorder.Add("(client flow)", std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - begin).count(), ok);
+            }
+        });
+    }
+    for (std::thread& t : workers) t.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::map<std::string, Samples> results = recorder.Take();
+
+    unsigned long requests = 0, requestErrors = 0;
+    std::cout << "\n" << std::left << std::setw(24) << "endpoint" << std::right
+              << std::setw(8) << "count" << std::setw(8) << "err%"
+              << std::setw(10) << "p50 ms" << std::setw(10) << "p95 ms" << std::setw(10) << "p99 ms" << "\n";
+    for (const auto& entry : results) {
+        if (entry.first[0] == '(') continue;
+        PrintRow(entry.first, entry.second);
+        requests += entry.second.ms.size();
+        requestErrors += entry.second.errors;
+    }
+    PrintRow("(client flow)", results["(client flow)"]);
+    PrintRow("(queue delay)", results["(queue delay)"]);
+
+    HttpClientStats net = HttpClient::Instance().Stats();
+    std::cout << std::setprecision(1)
+              << "\n[*] Clients: " << options.clients - failed << " ok, " << failed << " failed ("
+              << 100.0 * failed / options.clients << "% error rate)\n"
+              << "[*] Requests: " << requests << ", " << requestErrors << " non-2xx or failed ("
+              << (requests ? 100.0 * requestErrors / requests : 0) << "%)\n"
+              << "[*] Throughput: " << options.clients / seconds << " clients/s, "
+              << requests / seconds << " requests/s over " << seconds << " s\n"
+              << "[*] Network: " << net.connectionsOpened << " connections opened, "
+              << net.connectionsReused << " reused" << std::endl;
+    PolicyStats retries = policy::Stats();
+    std::cout << "[*] Policy: " << retries.retries << " retries, " << retries.timeouts << " timeouts, "
+              << retries.circuitsOpened << " circuit opens, " << retries.failedFast << " failed fast" << std::endl;
+    if (net.tlsHandshakes > 0) {
+        std::cout << "[*] TLS: " << net.tlsHandshakes << " handshakes, " << net.tlsResumed << " resumed ("
+                  << std::setprecision(1) << 100.0 * net.ResumptionRate() << "%), early data "
+                  << net.earlyDataAccepted << "/" << net.earlyDataSent << " accepted" << std::endl;
+    }
+    if (net.compressedResponses > 0) {
+        std::cout << "[*] Compression: " << net.compressedResponses << " responses, "
+                  << std::setprecision(2) << net.CompressionRatio() << "x ratio, decode "
+                  << net.DecodeMegabytesPerSecond() << " MB/s" << std::endl;
+    }
+
+    trace::Finish(std::cout);
+    HttpClient::Instance().Shutdown();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+// Stand-in for the loader endpoints of auth-api.js, for load tests.
+//
+// Answers /auth/* with the same response shapes as the real API but keeps
+// no state and needs no Firestore. --latency adds a simulated backend
+// delay (exponentially distributed around the given mean) to every call.
+// --throttle-rate answers that fraction with 429 + Retry-After: 1, and
+// --slow-rate stalls that fraction for --slow-ms (exercises the loader's
+// retries and hedging).
+//
+//   node loadgen_server.js [--port 8080] [--latency 5] [--no-batch] [--fail-rate 0]
+//                          [--throttle-rate 0] [--slow-rate 0] [--slow-ms 1000]
+
+const http = require('http');
+const crypto = require('crypto');
+
+function option(name, fallback) {
+    const i = process.argv.indexOf(name);
+    return i >= 0 && i + 1 < process.argv.length ? process.argv[i + 1] : fallback;
+}
+
+const PORT = parseInt(option('--port', '8080'));
+const LATENCY_MS = parseFloat(option('--latency', '0'));
+const FAIL_RATE = parseFloat(option('--fail-rate', '0'));
+const THROTTLE_RATE = parseFloat(option('--throttle-rate', '0'));
+const SLOW_RATE = parseFloat(option('--slow-rate', '0'));
+const SLOW_MS = parseFloat(option('--slow-ms', '1000'));
+const FEATURES = process.argv.includes('--no-batch') ? [] : ['batch'];
+
+function ok(extra) {
+    return { status: 200, body: Object.assign({ success: true }, extra) };
+}
+
+const routes = {
+    '/auth/init': () => ok({
+        message: "Initialized",
+        session_id: crypto.randomBytes(16).toString('hex'),
+        appId: 'loadgen-app',
+        features: FEATURES
+    }),
+    '/auth/session/resume': () => ({ status: 401, body: { success: false, message: "Session expired" } }),
+    '/auth/login': (body) => ok({ message: "Logged in", username: body.username }),
+    '/auth/license': () => ok({ message: "License valid" }),
+    '/auth/hwid': () => ok({ message: "HWID updated" }),
+    '/auth/components': () => ok({ message: "Components registered" }),
+    '/auth/log-login': () => ok({ message: "Logged" }),
+    '/auth/activate-batch': () => ok({
+        message: "License valid",
+        license: { success: true },
+        hwid: { success: true },
+        components: { success: true },
+        log: { success: true }
+    }),
+    '/auth/payload/stream': (body) => ok({
+        message: "Payload ready",
+        downloadUrl: `http://127.0.0.1:${PORT}/payload/${encodeURIComponent(body.productName || '')}`,
+        etag: 'loadgen',
+        size: 0,
+        expiresIn: 30
+    })
+};
+
+function delay() {
+    if (Math.random() < SLOW_RATE) return SLOW_MS;
+    if (LATENCY_MS <= 0) return 0;
+    return -Math.log(1 - Math.random()) * LATENCY_MS;
+}
+
+const server = http.createServer((req, res) => {
+    let raw = '';
+    req.on('data', chunk => raw += chunk);
+    req.on('end', () => {
+        const route = routes[req.url.split('?')[0]];
+        let result;
+        if (req.method !== 'HEAD' && Math.random() < THROTTLE_RATE) {
+            result = { status: 429, body: { success: false, message: "Too many requests" }, headers: { 'Retry-After': '1' } };
+        } else if (req.method === 'HEAD' || req.method === 'GET') {
+            result = { status: 200, body: {} };
+        } else if (!route) {
+            result = { status: 404, body: { success: false, message: "Not found" } };
+        } else if (Math.random() < FAIL_RATE) {
+            result = { status: 500, body: { success: false, message: "Injected failure" } };
+        } else {
+            let body = {};
+            try { body = JSON.parse(raw || '{}'); } catch (e) { }
+            result = route(body);
+        }
+
+        setTimeout(() => {
+            const text = JSON.stringify(result.body);
+            res.writeHead(result.status, Object.assign({
+                'Content-Type': 'application/json',
+                'Content-Length': Buffer.byteLength(text)
+            }, result.headers));
+            res.end(req.method === 'HEAD' ? undefined : text);
+        }, delay());
+    });
+});
+
+server.keepAliveTimeout = 30000;
+server.listen(PORT, () => {
+    console.log(`[loadgen-server] listening on :${PORT} (latency ${LATENCY_MS} ms, fail rate ${FAIL_RATE}, features [${FEATURES}])`);
+});
@@ -0,0 +1,529 @@
+#pragma once
+
+// Buffered console and file logging.
+//
+// A line is built with logging::Info() << ... (Debug, Success, Warning and
+// Error alike) and queued when the statement ends. Queuing takes no lock:
+// the record is moved into a slot of a fixed ring claimed with a
+// compare-and-swap, and the writer thread is only signaled. The writer
+// drains the ring in batches. It writes each batch to the console in one
+// call per color run (one call in all on POSIX) and appends it to the log
+// file when one is open. The file rotates past a size limit.
+//
+// Colors belong to the sink: each level has one (Success green, Warning
+// yellow, Error red, Debug gray), and a line can set its own with Color().
+// They are Windows console attributes; other terminals get the matching
+// ANSI sequence, and output that is not a terminal gets none.
+//
+// Status() shows a transient line (progress) that the next line
+// overwrites; it never reaches the file. Output is asynchronous, so
+// questions to the user go through Prompt(), which writes everything
+// queued before it first.
+//
+// The console shows Info and up; SCARLET_LOG=debug (or warning, error)
+// changes that. The file gets every level.
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "text_codec.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace logging {
+
+enum class Level { Debug, Info, Success, Warning, Error };
+
+struct Record {
+    Level level = Level::Info;
+    int color = 0;          // console attribute; 0 = the level's
+    bool status = false;    // transient console line, not written to the file
+    std::chrono::system_clock::time_point time;
+    std::string text;       // UTF-8, without the final newline
+};
+
+class Logger {
+public:
+    // --- CONFIG ---
+    static const size_t kCapacity = 1024;          // queued records; a full ring makes callers wait
+    static const size_t kMaxBatch = 256;
+    static const unsigned long kIdleWakeMs = 20;   // bounds the delay of a missed signal
+    static const int kDefaultColor = 7;            // white
+
+    static Logger& Instance() {
+        static Logger instance;
+        return instance;
+    }
+
+    Logger() : slots_(new Slot[kCapacity]) {
+        for (size_t i = 0; i < kCapacity; i++) slots_[i].sequence.store(i, std::memory_order_relaxed);
+        consoleLevel_ = LevelFromEnvironment();
+#ifdef _WIN32
+        console_ = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD mode;
+        isConsole_ = GetConsoleMode(console_, &mode) != 0;
+#else
+        isConsole_ = isatty(STDOUT_FILENO) != 0;
+#endif
+        running_ = true;
+        writer_ = std::thread(&Logger::Run, this);
+    }
+
+    ~Logger() { Stop(); }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // Keeps every record in `path` too, moving it to "<path>.1" (and so on,
+    // `keepFiles` in all) once it would pass `maxBytes`.
+    bool OpenFile(const std::string& path, unsigned long long maxBytes, unsigned keepFiles = 3) {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        CloseFileLocked();
+        if (path.empty() || maxBytes == 0) return false;
+        file_ = fopen(path.c_str(), "ab");
+        if (!file_) return false;
+        fseek(file_, 0, SEEK_END);
+        long size = ftell(file_);
+        filePath_ = path;
+        fileBytes_ = size > 0 ? (unsigned long long)size : 0;
+        fileMaxBytes_ = maxBytes;
+        keepFiles_ = keepFiles < 1 ? 1 : keepFiles;
+        fileOpen_ = true;
+        return true;
+    }
+
+    bool Enabled(Level level) const {
+        return level >= consoleLevel_ || (fileOpen_.load(std::memory_order_relaxed) && level >= kFileLevel);
+    }
+
+    void Write(Record&& record) {
+        if (!record.status && !Enabled(record.level)) return;
+        Slot* slot;
+        while (!(slot = Claim())) {
+            // Full: let the writer catch up
+            wake_.notify_one();
+            std::this_thread::yield();
+        }
+        slot->record = std::move(record);
+        slot->sequence.store(slot->claimed + 1, std::memory_order_release);
+        if (idle_.load(std::memory_order_acquire)) wake_.notify_one();
+
+        // Queued while Stop() was draining: nobody else will write it
+        if (!running_.load()) DrainNow();
+    }
+
+    // Waits until everything queued before the call is written.
+    void Flush() {
+        size_t target = enqueue_.load(std::memory_order_acquire);
+        wake_.notify_one();
+        std::unique_lock<std::mutex> lock(mutex_);
+        flushed_.wait(lock, [&] { return written_ >= target || !running_.load(); });
+    }
+
+    // Flush(), then writes `text` without a newline (the cursor stays on it).
+    void Prompt(std::string_view text) {
+        Flush();
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        std::string out = ClearStatusLocked();
+        out.append(text.data(), text.size());
+        WriteConsoleText(out, kDefaultColor);
+    }
+
+    // Writes what is queued and stops the writer; later records are written
+    // by the thread that queues them.
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!writer_.joinable()) return;
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        writer_.join();
+        running_ = false;
+        flushed_.notify_all();
+        DrainNow();
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        CloseFileLocked();
+    }
+
+private:
+    static const Level kFileLevel = Level::Debug;
+
+    struct Slot {
+        std::atomic<size_t> sequence{ 0 };
+        size_t claimed = 0;
+        Record record;
+    };
+
+    // --- RING ---
+    // Bounded queue after Dmitry Vyukov's: a slot whose sequence equals the
+    // enqueue position is free; the producer that wins the position fills
+    // it and publishes it with sequence + 1. Only the writer dequeues.
+
+    Slot* Claim() {
+        size_t pos = enqueue_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[pos % kCapacity];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence == pos) {
+                if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.claimed = pos;
+                    return &slot;
+                }
+            } else if (sequence < pos) {
+                return nullptr;  // the writer has not freed it yet
+            } else {
+                pos = enqueue_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Writer side only (or under writeMutex_ once the writer is gone).
+    bool Pop(Record& record) {
+        Slot& slot = slots_[dequeue_ % kCapacity];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeue_ + 1) return false;
+        record = std::move(slot.record);
+        slot.sequence.store(dequeue_ + kCapacity, std::memory_order_release);
+        dequeue_++;
+        return true;
+    }
+
+    bool Pending() const {
+        return slots_[dequeue_ % kCapacity].sequence.load(std::memory_order_acquire) == dequeue_ + 1;
+    }
+
+    void Run() {
+        std::vector<Record> batch;
+        for (;;) {
+            Record record;
+            while (batch.size() < kMaxBatch && Pop(record)) batch.push_back(std::move(record));
+            if (!batch.empty()) {
+                {
+                    std::lock_guard<std::mutex> lock(writeMutex_);
+                    WriteBatchLocked(batch);
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                written_ += batch.size();
+                batch.clear();
+                flushed_.notify_all();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (stopping_) return;
+            idle_ = true;
+            wake_.wait_for(lock, std::chrono::milliseconds((long long)kIdleWakeMs), [this] { return stopping_ || Pending(); });
+            idle_ = false;
+        }
+    }
+
+    void DrainNow() {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        std::vector<Record> batch;
+        Record record;
+        while (Pop(record)) batch.push_back(std::move(record));
+        if (!batch.empty()) WriteBatchLocked(batch);
+    }
+
+    // --- SINKS ---
+
+    static Level LevelFromEnvironment() {
+        const char* value = getenv("SCARLET_LOG");
+        std::string name = value ? value : "";
+        if (name == "debug") return Level::Debug;
+        if (name == "warning" || name == "warn") return Level::Warning;
+        if (name == "error") return Level::Error;
+        return Level::Info;
+    }
+
+    static int LevelColor(Level level) {
+        switch (level) {
+        case Level::Debug: return 8;     // gray
+        case Level::Success: return 10;  // green
+        case Level::Warning: return 14;  // yellow
+        case Level::Error: return 12;    // red
+        default: return kDefaultColor;
+        }
+    }
+
+    static const char* LevelName(Level level) {
+        switch (level) {
+        case Level::Debug: return "DEBUG";
+        case Level::Success: return "OK   ";
+        case Level::Warning: return "WARN ";
+        case Level::Error: return "ERROR";
+        default: return "INFO ";
+        }
+    }
+
+    // Blanks a status line left on screen.
+    std::string ClearStatusLocked() {
+        if (statusWidth_ == 0) return "";
+        std::string clear = "\r" + std::string(statusWidth_, ' ') + "\r";
+        statusWidth_ = 0;
+        return clear;
+    }
+
+    void WriteBatchLocked(std::vector<Record>& batch) {
+        // Console: consecutive lines of one color become one run
+        std::vector<std::pair<int, std::string>> runs;
+        for (const Record& record : batch) {
+            if (record.level < consoleLevel_ && !record.status) continue;
+            int color = record.color ? record.color : LevelColor(record.level);
+            std::string text = ClearStatusLocked();
+            if (record.status) {
+                text += record.text;
+                statusWidth_ = record.text.size();
+            } else {
+                text += record.text;
+                text += '\n';
+            }
+            if (runs.empty() || runs.back().first != color) runs.push_back({ color, std::string() });
+            runs.back().second += text;
+        }
+        WriteConsoleRuns(runs);
+
+        if (file_) WriteFileLocked(batch);
+    }
+
+    void WriteConsoleText(const std::string& text, int color) {
+        std::vector<std::pair<int, std::string>> runs;
+        runs.push_back({ color, text });
+        WriteConsoleRuns(runs);
+    }
+
+#ifdef _WIN32
+    void WriteConsoleRuns(const std::vector<std::pair<int, std::string>>& runs) {
+        for (const auto& run : runs) {
+            DWORD written;
+            if (!isConsole_) {
+                WriteFile(console_, run.second.data(), (DWORD)run.second.size(), &written, NULL);
+                continue;
+            }
+            // The console takes UTF-16; colors are attributes set around the write
+            std::wstring wide = Utf8ToWide(run.second);
+            if (run.first != kDefaultColor) SetConsoleTextAttribute(console_, (WORD)run.first);
+            WriteConsoleW(console_, wide.data(), (DWORD)wide.size(), &written, NULL);
+            if (run.first != kDefaultColor) SetConsoleTextAttribute(console_, kDefaultColor);
+        }
+    }
+#else
+    void WriteConsoleRuns(const std::vector<std::pair<int, std::string>>& runs) {
+        // Console attribute bits are BGR, ANSI colors are RGB
+        static const int ansi[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+        std::string out;
+        for (const auto& run : runs) {
+            bool colored = isConsole_ && run.first != kDefaultColor;
+            if (colored) out += "\033[" + std::to_string((run.first & 8 ? 90 : 30) + ansi[run.first & 7]) + "m";
+            out += run.second;
+            if (colored) out += "\033[0m";
+        }
+        // write(2), not stdio: stdout may be wide-oriented (wcout)
+        size_t done = 0;
+        while (done < out.size()) {
+            ssize_t n = ::write(STDOUT_FILENO, out.data() + done, out.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;
+            done += (size_t)n;
+        }
+    }
+#endif
+
+    void WriteFileLocked(const std::vector<Record>& batch) {
+        std::string out;
+        for (const Record& record : batch) {
+            if (record.status || record.level < kFileLevel) continue;
+
+            std::time_t seconds = std::chrono::system_clock::to_time_t(record.time);
+            long millis = (long)(std::chrono::duration_cast<std::chrono::milliseconds>(
+                record.time.time_since_epoch()).count() % 1000);
+            std::tm local;
+#ifdef _WIN32
+            localtime_s(&local, &seconds);
+#else
+            localtime_r(&seconds, &local);
+#endif
+            char stamp[64];
+            size_t length = strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+            snprintf(stamp + length, sizeof(stamp) - length, ".%03ld %s ", millis, LevelName(record.level));
+
+            // One file line per text line; blank ones only space out the console
+            size_t pos = 0;
+            while (pos <= record.text.size()) {
+                size_t end = record.text.find('\n', pos);
+                if (end == std::string::npos) end = record.text.size();
+                std::string_view line(record.text.data() + pos, end - pos);
+                if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                if (line.find_first_not_of(" \t") != std::string_view::npos) {
+                    out += stamp;
+                    out.append(line.data(), line.size());
+                    out += '\n';
+                }
+                pos = end + 1;
+            }
+        }
+        if (out.empty()) return;
+
+        if (fileBytes_ > 0 && fileBytes_ + out.size() > fileMaxBytes_) RotateLocked();
+        if (!file_) return;
+        fwrite(out.data(), 1, out.size(), file_);
+        fflush(file_);
+        fileBytes_ += out.size();
+    }
+
+    // path -> path.1 -> ... -> path.<keepFiles - 1>; the oldest is dropped.
+    void RotateLocked() {
+        fclose(file_);
+        file_ = nullptr;
+        if (keepFiles_ > 1) {
+            std::remove((filePath_ + "." + std::to_string(keepFiles_ - 1)).c_str());
+            for (unsigned k = keepFiles_ - 1; k >= 1; k--) {
+                std::string from = k == 1 ? filePath_ : filePath_ + "." + std::to_string(k - 1);
+                std::rename(from.c_str(), (filePath_ + "." + std::to_string(k)).c_str());
+            }
+        } else {
+            std::remove(filePath_.c_str());
+        }
+        file_ = fopen(filePath_.c_str(), "ab");
+        fileBytes_ = 0;
+        if (!file_) fileOpen_ = false;
+    }
+
+    void CloseFileLocked() {
+        if (file_) fclose(file_);
+        file_ = nullptr;
+        fileOpen_ = false;
+    }
+
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<size_t> enqueue_{ 0 };
+    size_t dequeue_ = 0;
+
+    std::thread writer_;
+    std::mutex mutex_;                  // writer state below, flush waits
+    std::condition_variable wake_;      // records queued, stop requested
+    std::condition_variable flushed_;   // a batch was written
+    std::atomic<bool> idle_{ false };
+    std::atomic<bool> running_{ false };
+    bool stopping_ = false;
+    size_t written_ = 0;
+
+    std::mutex writeMutex_;             // console and file
+    Level consoleLevel_ = Level::Info;
+    bool isConsole_ = false;
+#ifdef _WIN32
+    HANDLE console_ = NULL;
+#endif
+    size_t statusWidth_ = 0;
+    FILE* file_ = nullptr;
+    std::atomic<bool> fileOpen_{ false };
+    std::string filePath_;
+    unsigned long long fileBytes_ = 0;
+    unsigned long long fileMaxBytes_ = 0;
+    unsigned keepFiles_ = 3;
+};
+
+// One log line, queued when it goes out of scope. With `into`, the record
+// is appended there instead (to be written later as a group).
+class Line {
+public:
+    explicit Line(Level level, std::vector<Record>* into = nullptr)
+        : into_(into), enabled_(into || Logger::Instance().Enabled(level)) {
+        record_.level = level;
+    }
+
+    ~Line() {
+        if (!enabled_) return;
+        record_.time = std::chrono::system_clock::now();
+        record_.text = stream_.str();
+        if (into_) into_->push_back(std::move(record_));
+        else Logger::Instance().Write(std::move(record_));
+    }
+
+    Line(const Line&) = delete;
+    Line& operator=(const Line&) = delete;
+
+    // A console attribute for this line instead of the level's (13 = magenta).
+    Line& Color(int color) {
+        record_.color = color;
+        return *this;
+    }
+
+    template <typename T>
+    Line& operator<<(const T& value) {
+        if (enabled_) stream_ << value;
+        return *this;
+    }
+
+    Line& operator<<(const wchar_t* text) {
+        if (enabled_) stream_ << WideToUtf8(text);
+        return *this;
+    }
+
+    Line& operator<<(const std::wstring& text) {
+        if (enabled_) stream_ << WideToUtf8(text);
+        return *this;
+    }
+
+private:
+    Record record_;
+    std::vector<Record>* into_;
+    bool enabled_;
+    std::ostringstream stream_;
+};
+
+inline Line Debug() { return Line(Level::Debug); }
+inline Line Info() { return Line(Level::Info); }
+inline Line Success() { return Line(Level::Success); }
+inline Line Warning() { return Line(Level::Warning); }
+inline Line Error() { return Line(Level::Error); }
+
+// Queues text that may span several lines (e.g. what an ostream-based
+// helper wrote); a final newline is dropped and empty text is skipped.
+inline void Lines(Level level, std::string text) {
+    if (!text.empty() && text.back() == '\n') text.pop_back();
+    if (text.empty()) return;
+    Record record;
+    record.level = level;
+    record.time = std::chrono::system_clock::now();
+    record.text = std::move(text);
+    Logger::Instance().Write(std::move(record));
+}
+
+// Queues records collected with Line(level, &records), in order.
+inline void Write(std::vector<Record>& records) {
+    for (Record& record : records) Logger::Instance().Write(std::move(record));
+    records.clear();
+}
+
+// Replaces the transient status line on the console.
+inline void Status(std::string text) {
+    Record record;
+    record.status = true;
+    record.text = std::move(text);
+    Logger::Instance().Write(std::move(record));
+}
+
+inline void Flush() { Logger::Instance().Flush(); }
+inline void Prompt(std::string_view text) { Logger::Instance().Prompt(text); }
+
+} // namespace logging
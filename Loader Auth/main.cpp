@@ -1,528 +1,568 @@
 #include <iostream>
 #include <string>
-#include <windows.h>
-#include <wininet.h>
 #include <sstream>
 #include <ctime>
 #include <vector>
-
-#pragma comment(lib, "wininet.lib")
+#include <future>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include "http_client.h"
+#include "request_policy.h"
+#include "auth_client.h"
+#include "hardware.h"
+#include "download.h"
+#include "delta.h"
+#include "artifact_cache.h"
+#include "json.h"
+#include "session_cache.h"
+#include "license_lease.h"
+#include "telemetry.h"
+#include "platform.h"
+#include "trace.h"
+#include "log.h"
 
 
 using namespace std;
 
 // --- CONFIG ---
-const string APP_NAME = "Scarlet External";
-const string APP_VERSION = "1.0";
-const string OWNER_ID = "1"; // Your user ID
-const string APP_SECRET = "00347ecb6ab1084f15649e13aed2ba1d4e2693a81ba0b97ef3ec79943fd2a0fa"; // Your app secret
+constexpr char APP_NAME[] = "Scarlet External";
+constexpr char APP_VERSION[] = "1.0";
+constexpr char OWNER_ID[] = "1"; // Your user ID
+constexpr char APP_SECRET[] = "00347ecb6ab1084f15649e13aed2ba1d4e2693a81ba0b97ef3ec79943fd2a0fa"; // Your app secret
 const string API_URL = "http://localhost"; // Change to your server URL in production
+// Server's Ed25519 lease key (hex, logged by auth-api.js at startup); empty disables offline leases
+constexpr char LEASE_PUBLIC_KEY[] = "";
+// How long the exit waits for queued login logs / component reports; what is left goes out next launch
+constexpr unsigned long TELEMETRY_FLUSH_MS = 2000;
+// Products downloading at once when several are injected (each may use several connections)
+constexpr size_t PARALLEL_DOWNLOADS = 3;
+// Signed URLs live 30 s; a download that would start on an older one asks for a new URL
+constexpr double TICKET_MAX_AGE_MS = 20000;
+// loader.log (in the app data folder) rotates past this size, keeping 3 files; 0 = no log file
+constexpr unsigned long long LOG_FILE_BYTES = 1024 * 1024;
+
+// /auth/init body members, serialized (and escaped) at compile time
+constexpr auto INIT_MEMBERS = json::Fragment<256>()
+    .Member("name", APP_NAME)
+    .Member("ownerId", OWNER_ID)
+    .Member("secret", APP_SECRET)
+    .Member("version", APP_VERSION);
 
 // --- GLOBALS ---
-string sessionId = "";
-string appId = "";
-string currentUser = "";
+AuthClient auth(API_URL, INIT_MEMBERS.View(), APP_VERSION);
 
 // --- HELPER FUNCTIONS ---
 
-string GetHWID() {
-    // Simple HWID based on computer name + username
-    char computerName[256];
-    char userName[256];
-    DWORD size = 256;
-    
-    GetComputerNameA(computerName, &size);
-    size = 256;
-    GetUserNameA(userName, &size);
-    
-    string hwid = string(computerName) + "-" + string(userName);
-    return hwid;
-}
-
-string ExecCommand(const char* cmd) {
-    char buffer[128];
-    string result = "";
-    FILE* pipe = _popen(cmd, "r");
-    if (!pipe) return "Unknown";
-    while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-        result += buffer;
-    }
-    _pclose(pipe);
-    
-    // Clean result (remove newlines and extra spaces)
-    string cleanResult = "";
-    bool foundContent = false;
-    stringstream ss(result);
-    string line;
-    
-    // Skip first line (header) and take the second line (value)
-    int lineCount = 0;
-    while (getline(ss, line)) {
-        if (line.empty() || line.find_first_not_of(" \t\r\n") == string::npos) continue;
-        lineCount++;
-        if (lineCount == 2) {
-            // Trim whitespace
-            size_t first = line.find_first_not_of(" \t\r\n");
-            size_t last = line.find_last_not_of(" \t\r\n");
-            if (first != string::npos && last != string::npos) {
-                cleanResult = line.substr(first, (last - first + 1));
-            }
-            break; 
-        }
-    }
-    
-    if (cleanResult.empty()) return "Unknown";
-    return cleanResult;
-}
+// Hardware values are probed once per run (or loaded from the boot cache)
+// by GetHardwareInfo() in hardware.h.
 
-string GetGPU() {
-    return ExecCommand("wmic path Win32_VideoController get Name");
+string GetHWID() {
+    return GetHardwareInfo().hwid;
 }
 
-string GetMotherboard() {
-    return ExecCommand("wmic path Win32_BaseBoard get Product");
+// Key for the session and lease cache MACs; ties the files to this app and machine.
+string SessionCacheKey() {
+    return string(APP_SECRET) + ":" + hardware::ComputeHWID();
 }
 
-string GetCPU() {
-    return ExecCommand("wmic path Win32_Processor get Name");
+void PrintBanner() {
+    logging::Info().Color(13) << R"(
+    ╔═══════════════════════════════════════╗
+    ║     SCARLET AUTH LOADER v1.0          ║
+    ║     Secure Authentication System      ║
+    ╚═══════════════════════════════════════╝
+    )"; // Magenta
 }
 
-string HttpRequest(const string& url, const string& method, const string& postData = "") {
-    HINTERNET hInternet = InternetOpenA("ScarletAuthLoader/1.0", INTERNET_OPEN_TYPE_DIRECT, NULL, NULL, 0);
-    if (!hInternet) return "";
-
-    // Parse URL
-    URL_COMPONENTSA urlComp;
-    ZeroMemory(&urlComp, sizeof(urlComp));
-    urlComp.dwStructSize = sizeof(urlComp);
-    
-    char szHostName[256];
-    char szUrlPath[1024];
-    urlComp.lpszHostName = szHostName;
-    urlComp.dwHostNameLength = sizeof(szHostName);
-    urlComp.lpszUrlPath = szUrlPath;
-    urlComp.dwUrlPathLength = sizeof(szUrlPath);
-    
-    InternetCrackUrlA(url.c_str(), 0, 0, &urlComp);
-    
-    HINTERNET hConnect = InternetConnectA(hInternet, szHostName, urlComp.nPort, 
-        NULL, NULL, INTERNET_SERVICE_HTTP, 0, 0);
-    
-    if (!hConnect) {
-        InternetCloseHandle(hInternet);
-        return "";
+// Where FetchPayload() reports. A single product logs as it goes; in a
+// batch each product collects its lines in its own buffer, logged once it
+// is done, and adds the bytes it writes to the shared progress counter.
+struct FetchReport {
+    vector<logging::Record>* buffer = nullptr;
+    atomic<unsigned long long>* progress = nullptr;
+
+    logging::Line Info() const { return logging::Line(logging::Level::Info, buffer); }
+    logging::Line Error() const { return logging::Line(logging::Level::Error, buffer); }
+};
+
+// Resolves `productName` to a local file. The artifact cache is revalidated
+// first: an unchanged product costs one small request and no download.
+// `prefetched` is a ticket from a batch request, used instead of asking for
+// one. Returns the path of the payload, or "" on failure (already reported).
+string FetchPayload(const string& licenseKey, const string& productName, const string& fallbackPath,
+                    const PayloadTicket* prefetched = nullptr, const FetchReport& report = FetchReport()) {
+    ArtifactCache& cache = ArtifactCache::Instance();
+    ArtifactEntry cached;
+    bool haveCached = cache.Enabled() && cache.Lookup(productName, cached);
+    
+    // The cached copy's hash lets the server offer a patch instead of the whole file
+    string baseSha256 = haveCached && delta::Supported() ? cached.sha256 : "";
+    PayloadTicket ticket;
+    bool granted;
+    if (prefetched) {
+        ticket = *prefetched;
+        granted = ticket.notModified || !ticket.downloadUrl.empty();
+    } else {
+        report.Info() << "[*] Requesting payload from server...";
+        granted = auth.RequestPayload(licenseKey, productName, haveCached ? cached.etag : "", baseSha256, ticket);
     }
-
-    HINTERNET hRequest = HttpOpenRequestA(hConnect, method.c_str(), szUrlPath, 
-        NULL, NULL, NULL, INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE, 0);
     
-    if (!hRequest) {
-        InternetCloseHandle(hConnect);
-        InternetCloseHandle(hInternet);
-        return "";
+    if (ticket.notModified) {
+        cache.Touch(productName);
+        report.Info() << "[+] Payload unchanged, using cached copy (" << cached.size << " bytes)";
+        return cache.BlobPath(cached.etag);
     }
-
-    // Send request
-    const char* headers = "Content-Type: application/json\r\n";
-    BOOL result;
     
-    if (method == "POST" && !postData.empty()) {
-        result = HttpSendRequestA(hRequest, headers, -1, 
-            (LPVOID)postData.c_str(), postData.length());
-    } else {
-        result = HttpSendRequestA(hRequest, NULL, 0, NULL, 0);
-    }
-
-    if (!result) {
-        InternetCloseHandle(hRequest);
-        InternetCloseHandle(hConnect);
-        InternetCloseHandle(hInternet);
+    if (!granted) {
+        report.Error() << "[-] Failed to get payload URL. Make sure the product file is uploaded.";
+        report.Error() << "    Response: " << ticket.response;
         return "";
     }
-
-    // Read response
-    char buffer[4096];
-    DWORD bytesRead;
-    string response = "";
-
-    while (InternetReadFile(hRequest, buffer, sizeof(buffer) - 1, &bytesRead) && bytesRead > 0) {
-        buffer[bytesRead] = 0;
-        response += buffer;
-    }
-
-    InternetCloseHandle(hRequest);
-    InternetCloseHandle(hConnect);
-    InternetCloseHandle(hInternet);
-
-    return response;
-}
-
-bool InitializeAuth() {
-    cout << "[*] Initializing authentication..." << endl;
     
-    string postData = "{\"name\":\"" + APP_NAME + "\",\"ownerId\":\"" + OWNER_ID + 
-                      "\",\"secret\":\"" + APP_SECRET + "\",\"version\":\"" + APP_VERSION + "\"}";
+    // Content hash reported by the server (newer servers only)
+    string etag = ticket.etag;
     
-    string response = HttpRequest(API_URL + "/auth/init", "POST", postData);
+    if (!prefetched) report.Info() << "[+] Payload URL obtained (expires in 30 seconds)";
     
-    // Parse session_id
-    size_t pos = response.find("\"session_id\":\"");
-    if (pos != string::npos) {
-        pos += 14;
-        size_t endPos = response.find("\"", pos);
-        sessionId = response.substr(pos, endPos - pos);
-        cout << "[+] Session initialized: " << sessionId.substr(0, 8) << "..." << endl;
-        
-        // Parse appId
-        pos = response.find("\"appId\":\"");
-        if (pos != string::npos) {
-            pos += 9;
-            endPos = response.find("\"", pos);
-            appId = response.substr(pos, endPos - pos);
-            cout << "[+] App ID: " << appId << endl;
+    string destPath = cache.Enabled() ? cache.StagingPath(productName) : fallbackPath;
+    if (!ticket.patchUrl.empty() && haveCached && !etag.empty()) {
+        string instead = ticket.size > 0 ? " instead of " + to_string(ticket.size) : "";
+        report.Info() << "[*] Applying update patch (" << ticket.patchSize << " bytes" << instead << ")...";
+        PatchResult patch;
+        {
+            trace::Scope scope("ApplyPatch");
+            patch = ApplyPatch(cache.BlobPath(cached.etag), ticket.patchUrl, destPath, ticket.sha256, report.progress);
+        }
+        if (patch.ok && cache.Commit(productName, etag, "", patch.sha256)) {
+            report.Info() << "[+] Payload patched (" << patch.bytes << " bytes from a " << patch.patchBytes << "-byte patch, "
+            << (int)patch.SavedPercent() << "% less to download, " << (int)(patch.seconds * 1000) << " ms)";
+            report.Info() << "[+] SHA-256 verified";
+            return cache.BlobPath(etag);
         }
         
-        return true;
+        report.Error() << "[-] Patch failed (" << (patch.ok ? "cache commit failed" : patch.error)
+            << "), falling back to the full download";
+        // The signed URL from the first answer may have run out while patching
+        if (!auth.RequestPayload(licenseKey, productName, "", "", ticket)) {
+            report.Error() << "[-] Failed to get payload URL.";
+            return "";
+        }
     }
     
-    cout << "[-] Failed to initialize. Response: " << response << endl;
-    return false;
-}
-
-bool Login(const string& username, const string& password) {
-    if (sessionId.empty()) {
-        cout << "[-] Session not initialized!" << endl;
-        return false;
-    }
-
-    cout << "[*] Logging in as " << username << "..." << endl;
+    report.Info() << "[*] Downloading payload...";
     
-    string hwid = GetHWID();
-    string postData = "{\"username\":\"" + username + "\",\"password\":\"" + password + 
-                      "\",\"session_id\":\"" + sessionId + "\",\"hwid\":\"" + hwid + 
-                      "\",\"appId\":\"" + appId + "\"}";
+    // Older servers can't short-circuit; let the storage host answer 304 instead
+    DownloadOptions options;
+    options.sha256 = ticket.sha256;
+    options.progress = report.progress;
+    if (haveCached) {
+        if (cached.etag[0] == '"' || cached.etag.compare(0, 2, "W/") == 0) options.ifNoneMatch = cached.etag;
+        options.ifModifiedSince = cached.lastModified;
+    }
     
-    string response = HttpRequest(API_URL + "/auth/login", "POST", postData);
+    DownloadResult download;
+    {
+        trace::Scope scope("DownloadPayload");
+        download = DownloadToFile(ticket.downloadUrl, destPath, options);
+    }
     
-    // Check for success
-    if (response.find("\"success\":true") != string::npos) {
-        currentUser = username;
-        cout << "[+] Login successful! Welcome, " << username << endl;
-        return true;
+    if (!download.ok) {
+        report.Error() << "[-] " << download.error << "!";
+        return "";
     }
     
-    cout << "[-] Login failed. Response: " << response << endl;
-    return false;
-}
-
-bool CheckLicense(const string& licenseKey) {
-    if (sessionId.empty()) {
-        cout << "[-] Session not initialized!" << endl;
-        return false;
+    if (download.notModified) {
+        cache.Touch(productName);
+        report.Info() << "[+] Payload unchanged, using cached copy (" << cached.size << " bytes)";
+        return cache.BlobPath(cached.etag);
     }
-
-    cout << "[*] Checking license key..." << endl;
     
-    string hwid = GetHWID();
-    string postData = "{\"key\":\"" + licenseKey + "\",\"session_id\":\"" + sessionId + 
-                      "\",\"hwid\":\"" + hwid + "\",\"appId\":\"" + appId + "\"}";
+    report.Info() << "[+] Payload downloaded (" << download.bytes << " bytes in "
+        << (int)(download.seconds * 1000) << " ms, "
+        << download.MegabytesPerSecond() << " MB/s, "
+        << download.connections << " connection(s))";
+    if (download.verified) {
+        report.Info() << "[+] SHA-256 verified (" << download.hashSeconds * 1000 << " ms of hashing"
+            << (Sha256::Accelerated() ? ", SHA-NI" : "") << ", overlapped with the transfer)";
+    } else {
+        report.Info() << "[*] Server sent no SHA-256 for this product; integrity not verified";
+    }
+    if (!download.encoding.empty()) {
+        report.Info() << "[+] Transfer was " << download.encoding << ": " << download.encodedBytes << " bytes on the wire, "
+            << download.CompressionRatio() << "x, decoded at " << download.DecodeMegabytesPerSecond() << " MB/s";
+    }
     
-    string response = HttpRequest(API_URL + "/auth/license", "POST", postData);
+    if (!cache.Enabled()) return destPath;
     
-    if (response.find("\"success\":true") != string::npos) {
-        cout << "[+] License valid!" << endl;
-        return true;
+    if (etag.empty()) etag = download.etag;
+    if (!cache.Commit(productName, etag, download.lastModified, download.sha256)) {
+        // Not cacheable (no validator); run it from the staging file
+        remove(fallbackPath.c_str());
+        if (rename(destPath.c_str(), fallbackPath.c_str()) != 0) return destPath;
+        return fallbackPath;
     }
-    
-    cout << "[-] Invalid license. Response: " << response << endl;
-    return false;
+    return cache.BlobPath(etag);
 }
 
-bool SendHWID(const string& licenseKey) {
-    if (sessionId.empty() || appId.empty()) {
-        cout << "[-] Session not initialized!" << endl;
-        return false;
-    }
-    
-    string hwid = GetHWID();
-    string postData = "{\"appId\":\"" + appId + "\",\"key\":\"" + licenseKey + 
-                      "\",\"hwid\":\"" + hwid + "\",\"session_id\":\"" + sessionId + "\"}";
-    
-    string response = HttpRequest(API_URL + "/auth/hwid", "POST", postData);
-    
-    if (response.find("\"success\":true") != string::npos) {
-        cout << "[+] HWID sent successfully" << endl;
-        return true;
+// Run copy of the payload; products after the first of a batch get numbered ones.
+string TempPayloadPath(size_t index = 0) {
+    string name = index == 0 ? "payload_temp" : "payload_temp_" + to_string(index);
+#ifdef _WIN32
+    return platform::TempDirectory() + "\\" + name + ".exe";
+#else
+    return platform::TempDirectory() + "/" + name;
+#endif
+}
+
+double MillisecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Splits the "Product Name(s)" answer on commas, dropping blanks and repeats.
+vector<string> ParseProductList(const string& line) {
+    vector<string> products;
+    stringstream in(line);
+    string name;
+    while (getline(in, name, ',')) {
+        size_t first = name.find_first_not_of(" \t");
+        if (first == string::npos) continue;
+        name = name.substr(first, name.find_last_not_of(" \t") - first + 1);
+        if (find(products.begin(), products.end(), name) == products.end()) products.push_back(name);
     }
-    
-    cout << "[-] Failed to send HWID" << endl;
-    return false;
+    return products;
 }
 
-bool SendComponents(const string& licenseKey) {
-    if (sessionId.empty() || appId.empty()) {
-        cout << "[-] Session not initialized!" << endl;
-        return false;
+// Fetches several products at once: the signed URLs of all of them come
+// from one /auth/payload/batch call, then up to PARALLEL_DOWNLOADS products
+// download at a time under a single progress line. A product whose URL is
+// older than TICKET_MAX_AGE_MS when its turn comes (or whose server has no
+// batch endpoint) asks for its own. Returns each product's path, "" for
+// the ones that failed (already reported).
+vector<string> FetchPayloads(const string& licenseKey, const vector<string>& products) {
+    auto started = chrono::steady_clock::now();
+    ArtifactCache& cache = ArtifactCache::Instance();
+    
+    vector<PayloadRequest> requests;
+    for (const string& name : products) {
+        ArtifactEntry cached;
+        bool haveCached = cache.Enabled() && cache.Lookup(name, cached);
+        requests.push_back({ name, haveCached ? cached.etag : "", haveCached && delta::Supported() ? cached.sha256 : "" });
     }
     
-    cout << "[*] Collecting hardware information..." << endl;
-    
-    string hwid = GetHWID();
-    string gpu = GetGPU();
-    string mobo = GetMotherboard();
-    string cpu = GetCPU();
-    
-    cout << "[+] GPU: " << gpu << endl;
-    cout << "[+] Motherboard: " << mobo << endl;
-    cout << "[+] CPU: " << cpu << endl;
-    
-    string postData = "{\"appId\":\"" + appId + "\",\"key\":\"" + licenseKey + 
-                      "\",\"hwid\":\"" + hwid + "\",\"gpu\":\"" + gpu + 
-                      "\",\"motherboard\":\"" + mobo + "\",\"cpu\":\"" + cpu + 
-                      "\",\"session_id\":\"" + sessionId + "\"}";
+    vector<PayloadTicket> tickets;
+    vector<bool> granted;
+    bool batched = false;
+    if (auth.ServerPayloadBatch() && products.size() <= AuthClient::kMaxBatchProducts) {
+        logging::Info() << "[*] Requesting " << products.size() << " payload URLs in one request...";
+        batched = auth.RequestPayloads(licenseKey, requests, tickets, granted);
+    }
+    auto ticketsIssued = chrono::steady_clock::now();
+    
+    unsigned long long totalBytes = 0;
+    if (batched) {
+        size_t urls = 0;
+        for (size_t i = 0; i < products.size(); i++) {
+            if (!granted[i]) continue;
+            urls++;
+            if (!tickets[i].notModified) totalBytes += tickets[i].size;
+        }
+        logging::Info() << "[+] " << urls << "/" << products.size() << " payload URL(s) obtained (expire in 30 seconds)";
+    } else {
+        logging::Info() << "[*] Each product requests its own payload URL";
+    }
     
-    string response = HttpRequest(API_URL + "/auth/components", "POST", postData);
+    vector<string> paths(products.size());
+    atomic<unsigned long long> progress{ 0 };
+    atomic<size_t> next{ 0 }, done{ 0 }, failed{ 0 };
+    mutex consoleMutex;
     
-    if (response.find("\"success\":true") != string::npos) {
-        cout << "[+] Hardware components registered successfully" << endl;
-        return true;
+    auto worker = [&]() {
+        for (;;) {
+            size_t i = next++;
+            if (i >= products.size()) return;
+            
+            // A URL issued long ago may run out mid-download; ask again instead
+            bool fresh = batched && MillisecondsSince(ticketsIssued) < TICKET_MAX_AGE_MS;
+            if (batched && !fresh) logging::Debug() << "[*] " << products[i] << ": payload URL is stale, asking again";
+            vector<logging::Record> log;
+            FetchReport report;
+            report.buffer = &log;
+            report.progress = &progress;
+            paths[i] = FetchPayload(licenseKey, products[i], TempPayloadPath(i), fresh ? &tickets[i] : nullptr, report);
+            
+            // The product's lines stay together under its header
+            lock_guard<mutex> lock(consoleMutex);
+            if (paths[i].empty()) failed++;
+            logging::Line(paths[i].empty() ? logging::Level::Error : logging::Level::Info)
+                << "--- " << products[i] << (paths[i].empty() ? " (failed)" : "") << " ---";
+            logging::Write(log);
+            done++;
+        }
+    };
+    
+    vector<thread> workers;
+    for (size_t i = 0; i < min(PARALLEL_DOWNLOADS, products.size()); i++) workers.emplace_back(worker);
+    
+    // Aggregate progress over every product in flight
+    while (done < products.size()) {
+        this_thread::sleep_for(chrono::milliseconds(250));
+        double seconds = MillisecondsSince(started) / 1000;
+        double megabytes = progress / (1024.0 * 1024.0);
+        lock_guard<mutex> lock(consoleMutex);
+        if (done >= products.size()) break;
+        ostringstream status;
+        status << "[*] " << done << "/" << products.size() << " done, " << (int)megabytes;
+        if (totalBytes > 0) status << "/" << (int)(totalBytes / (1024 * 1024));
+        status << " MB, " << (int)(seconds > 0 ? megabytes / seconds : 0) << " MB/s";
+        logging::Status(status.str());
     }
+    for (thread& t : workers) t.join();
     
-    cout << "[-] Failed to register components" << endl;
-    return false;
+    double totalMs = MillisecondsSince(started);
+    logging::Line(failed ? logging::Level::Error : logging::Level::Success)
+        << "[" << (failed ? "-" : "+") << "] " << products.size() - failed << "/" << products.size()
+        << " product(s) ready, " << progress / 1024 << " KB written in " << (int)totalMs << " ms wall time";
+    return paths;
 }
 
-bool SendLoginLog(const string& username_or_key) {
-    if (sessionId.empty() || appId.empty()) {
-        cout << "[-] Session not initialized!" << endl;
-        return false;
+// Copies a fetched payload to its run path and starts it; the copy is
+// removed once the payload exits.
+void RunPayload(const string& payloadPath, const string& tempPath) {
+    // Run a private copy so the cached artifact stays intact
+    if (payloadPath != tempPath && !platform::CopyFileTo(payloadPath, tempPath)) {
+        logging::Error() << "[-] Failed to write temp file!";
+        return;
     }
+    logging::Info() << "[*] Executing payload...";
     
-    string hwid = GetHWID();
-    string postData = "{\"appId\":\"" + appId + "\",\"username_or_key\":\"" + username_or_key + 
-                      "\",\"hwid\":\"" + hwid + "\",\"session_id\":\"" + sessionId + "\"}";
-    
-    string response = HttpRequest(API_URL + "/auth/log-login", "POST", postData);
-    
-    if (response.find("\"success\":true") != string::npos) {
-        cout << "[+] Login logged successfully" << endl;
-        return true;
+    if (platform::LaunchAndDeleteOnExit(tempPath)) {
+        logging::Success() << "[+] Payload injected successfully!";
+    } else {
+        logging::Error() << "[-] Failed to execute payload!";
     }
-    
-    cout << "[-] Failed to log login" << endl;
-    return false;
-}
-
-void SetConsoleColor(int color) {
-    SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), color);
-}
-
-void PrintBanner() {
-    SetConsoleColor(13); // Magenta
-    cout << R"(
-    ╔═══════════════════════════════════════╗
-    ║     SCARLET AUTH LOADER v1.0          ║
-    ║     Secure Authentication System      ║
-    ╚═══════════════════════════════════════╝
-    )" << endl;
-    SetConsoleColor(7); // White
 }
 
 int main() {
+    auto startupBegin = chrono::steady_clock::now();
+    trace::StartFromEnvironment();
+    if (LOG_FILE_BYTES > 0) logging::Logger::Instance().OpenFile(LocalDataPath("loader.log"), LOG_FILE_BYTES);
     PrintBanner();
     
-    // Initialize
-    if (!InitializeAuth()) {
-        cout << "\n[!] Failed to connect to authentication server." << endl;
-        cout << "Press any key to exit...";
-        cin.get();
-        return 1;
-    }
-
-    cout << "\n=== Authentication Menu ===" << endl;
-    cout << "1. Login with Username/Password" << endl;
-    cout << "2. Activate License Key" << endl;
-    cout << "Choose option: ";
+    // --- STARTUP PIPELINE ---
+    // Session init, a warm connection to the API host and hardware probing
+    // don't need user input, so they run while the menu is on screen.
+    double initMs = 0, hardwareMs = 0;
+    ostringstream initLog;
+    auth.EnableSessionCache(&SessionCache::Instance(), SessionCacheKey());
+    if (LEASE_PUBLIC_KEY[0]) auth.EnableLeases(&LeaseStore::Instance(), SessionCacheKey(), LEASE_PUBLIC_KEY);
+    auth.EnableTelemetry(&TelemetryQueue::Instance());
+    future<bool> initDone = async(launch::async, [&]() {
+        bool ok = auth.Initialize(initLog);
+        initMs = MillisecondsSince(startupBegin);
+        return ok;
+    });
+    future<void> hardwareDone = async(launch::async, [&]() {
+        trace::Scope scope("GetHardwareInfo");
+        GetHardwareInfo();
+        hardwareMs = MillisecondsSince(startupBegin);
+    });
+    future<void> warmupDone = async(launch::async, []() {
+        HttpClient::Instance().Preconnect(API_URL + "/");
+        // leftovers from a previous run, if any
+        for (size_t i = 0; i < AuthClient::kMaxBatchProducts; i++) remove(TempPayloadPath(i).c_str());
+    });
+
+    logging::Info() << "\n=== Authentication Menu ===";
+    logging::Info() << "1. Login with Username/Password";
+    logging::Info() << "2. Activate License Key";
+    logging::Prompt("Choose option: ");
     
     int choice;
     cin >> choice;
     cin.ignore(); // Clear newline
 
-    bool authenticated = false;
+    string username, password;
     string licenseKey = ""; // Store for later use
 
     if (choice == 1) {
-        string username, password;
-        cout << "\nUsername: ";
+        logging::Prompt("\nUsername: ");
         getline(cin, username);
-        cout << "Password: ";
+        logging::Prompt("Password: ");
         getline(cin, password);
-        
-        authenticated = Login(username, password);
-        if (authenticated) {
-            SendLoginLog(username);
-        }
     }
     else if (choice == 2) {
-        cout << "\nLicense Key: ";
+        logging::Prompt("\nLicense Key: ");
         getline(cin, licenseKey);
-        
-        authenticated = CheckLicense(licenseKey);
-        if (authenticated) {
-            SendHWID(licenseKey);
-            SendComponents(licenseKey);
-            SendLoginLog(licenseKey);
+    }
+
+    // A signed lease with enough time left authenticates without waiting
+    // for the server; the session is only joined once something needs it
+    auto inputDone = chrono::steady_clock::now();
+    string subject = choice == 1 ? username : licenseKey;
+    LeaseStatus leaseStatus = LeaseStatus::Missing;
+    if (choice == 1) leaseStatus = auth.CheckLease(lease_kind::kLogin, username, password, hardware::ComputeHWID());
+    else if (choice == 2) leaseStatus = auth.CheckLease(lease_kind::kLicense, licenseKey, "", hardware::ComputeHWID());
+
+    bool startupJoined = false, initialized = false;
+    auto joinStartup = [&]() {
+        if (!startupJoined) {
+            startupJoined = true;
+            initialized = initDone.get();
+            hardwareDone.get();
+            auth.SetHardware(GetHardwareInfo());
+            warmupDone.get();
+            logging::Lines(logging::Level::Info, initLog.str());
         }
+        return initialized;
+    };
+
+    bool authenticated = leaseStatus == LeaseStatus::Valid;
+
+    // Credentials go out as soon as the session and hardware info are ready
+    if (!authenticated && !joinStartup() && leaseStatus != LeaseStatus::Renew) {
+        logging::Error() << "\n[!] Failed to connect to authentication server.";
+        logging::Prompt("Press any key to exit...");
+        cin.get();
+        return 1;
     }
-    else {
-        cout << "[-] Invalid option!" << endl;
+
+    // Online check, unless the lease already settled it or the server is unreachable
+    if (!authenticated && initialized) {
+        if (choice == 1) {
+            authenticated = auth.Login(username, password);
+            if (authenticated) {
+                auth.SendLoginLog(username);
+            }
+        }
+        else if (choice == 2) {
+            if (auth.ServerBatch()) {
+                authenticated = auth.ActivateLicenseBatch(licenseKey);
+            } else {
+                authenticated = auth.CheckLicense(licenseKey);
+                if (authenticated) {
+                    // Older server: components and the login log are only queued,
+                    // the HWID binding is the one call left to wait for
+                    auth.SendComponents(licenseKey);
+                    auth.SendLoginLog(licenseKey);
+                    auth.SendHWID(licenseKey);
+                }
+            }
+        }
+        else {
+            logging::Error() << "[-] Invalid option!";
+        }
     }
+    if (!authenticated && leaseStatus == LeaseStatus::Renew) authenticated = auth.FallBackToLease();
+    double authMs = MillisecondsSince(inputDone);
 
     if (authenticated) {
-        SetConsoleColor(10); // Green
-        cout << "\n╔═══════════════════════════════════════╗" << endl;
-        cout << "║      AUTHENTICATION SUCCESSFUL!       ║" << endl;
-        cout << "╚═══════════════════════════════════════╝\n" << endl;
-        SetConsoleColor(7);
+        logging::Success() << "\n╔═══════════════════════════════════════╗\n"
+                           << "║      AUTHENTICATION SUCCESSFUL!       ║\n"
+                           << "╚═══════════════════════════════════════╝\n";
         
-        cout << "[*] Starting application..." << endl;
-        Sleep(1000);
-        cout << "[+] Application loaded successfully!" << endl;
+        if (leaseStatus == LeaseStatus::Valid) {
+            logging::Info() << "[*] Authenticated from the license lease " << (int)authMs << " ms after input (no server round trip)";
+        } else {
+            logging::Info() << "[*] Authenticated " << (int)authMs << " ms after input (session ready at "
+                            << (int)initMs << " ms, hardware at " << (int)hardwareMs << " ms after launch)";
+        }
+        logging::Info() << "[+] Application loaded successfully!";
         
         // Your application logic here
-        cout << "\n[INFO] Your HWID: " << GetHWID() << endl;
+        logging::Info() << "\n[INFO] Your HWID: " << GetHWID();
         
         // === NOVO: Menu de Injeção ===
-        cout << "\n=== Injection Menu ===" << endl;
-        cout << "1. Inject Payload (Download from server)" << endl;
-        cout << "2. Skip injection" << endl;
-        cout << "Choose option: ";
+        logging::Info() << "\n=== Injection Menu ===";
+        logging::Info() << "1. Inject Payload (Download from server)";
+        logging::Info() << "2. Skip injection";
+        logging::Prompt("Choose option: ");
         
         int injectChoice;
         cin >> injectChoice;
         cin.ignore();
         
-        if (injectChoice == 1) {
-            cout << "\n[*] Preparing to inject payload..." << endl;
-            cout << "Product Name (must match uploaded file): ";
-            string productName;
-            getline(cin, productName);
-            
-            cout << "[*] Requesting payload from server..." << endl;
-            
-            string hwid = GetHWID();
-            string postData = "{\"appId\":\"" + appId + "\",\"key\":\"" + licenseKey + 
-                              "\",\"hwid\":\"" + hwid + "\",\"productName\":\"" + productName + 
-                              "\",\"session_id\":\"" + sessionId + "\"}";
-            
-            string response = HttpRequest(API_URL + "/auth/payload/stream", "POST", postData);
+        // Lease launches join the session here; the login is still logged
+        bool online = joinStartup();
+        if (online && leaseStatus == LeaseStatus::Valid) auth.SendLoginLog(subject);
+        
+        if (injectChoice == 1 && !online) {
+            logging::Error() << "[-] Failed to connect to authentication server.";
+        }
+        else if (injectChoice == 1) {
+            logging::Info() << "\n[*] Preparing to inject payload...";
+            logging::Prompt("Product Name(s), comma-separated (must match uploaded files): ");
+            string productLine;
+            getline(cin, productLine);
+            vector<string> products = ParseProductList(productLine);
+            if (products.size() > AuthClient::kMaxBatchProducts) {
+                logging::Info() << "[*] Only the first " << AuthClient::kMaxBatchProducts << " products are fetched";
+                products.resize(AuthClient::kMaxBatchProducts);
+            }
             
-            // Parse downloadUrl
-            size_t pos = response.find("\"downloadUrl\":\"");
-            if (pos != string::npos) {
-                pos += 15;
-                size_t endPos = response.find("\"", pos);
-                string downloadUrl = response.substr(pos, endPos - pos);
-                
-                cout << "[+] Payload URL obtained (expires in 30 seconds)" << endl;
-                cout << "[*] Downloading payload..." << endl;
-                
-                // Download file
-                HINTERNET hInternet = InternetOpenA("ScarletLoader/1.0", INTERNET_OPEN_TYPE_DIRECT, NULL, NULL, 0);
-                if (hInternet) {
-                    HINTERNET hUrl = InternetOpenUrlA(hInternet, downloadUrl.c_str(), NULL, 0, 
-                        INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE, 0);
-                    
-                    if (hUrl) {
-                        // Read file into memory
-                        vector<char> fileData;
-                        char buffer[4096];
-                        DWORD bytesRead;
-                        
-                        while (InternetReadFile(hUrl, buffer, sizeof(buffer), &bytesRead) && bytesRead > 0) {
-                            fileData.insert(fileData.end(), buffer, buffer + bytesRead);
-                        }
-                        
-                        InternetCloseHandle(hUrl);
-                        
-                        if (!fileData.empty()) {
-                            cout << "[+] Payload downloaded (" << fileData.size() << " bytes)" << endl;
-                            
-                            // Save to temp file for execution
-                            string tempPath = getenv("TEMP");
-                            tempPath += "\\payload_temp.exe";
-                            
-                            FILE* fp = fopen(tempPath.c_str(), "wb");
-                            if (fp) {
-                                fwrite(fileData.data(), 1, fileData.size(), fp);
-                                fclose(fp);
-                                
-                                cout << "[*] Executing payload..." << endl;
-                                
-                                // Execute
-                                STARTUPINFOA si;
-                                PROCESS_INFORMATION pi;
-                                ZeroMemory(&si, sizeof(si));
-                                si.cb = sizeof(si);
-                                ZeroMemory(&pi, sizeof(pi));
-                                
-                                if (CreateProcessA(tempPath.c_str(), NULL, NULL, NULL, FALSE, 
-                                    CREATE_NEW_CONSOLE, NULL, NULL, &si, &pi)) {
-                                    
-                                    SetConsoleColor(10);
-                                    cout << "[+] Payload injected successfully!" << endl;
-                                    SetConsoleColor(7);
-                                    
-                                    CloseHandle(pi.hProcess);
-                                    CloseHandle(pi.hThread);
-                                    
-                                    // Optional: Delete temp file after short delay
-                                    Sleep(2000);
-                                    DeleteFileA(tempPath.c_str());
-                                } else {
-                                    SetConsoleColor(12);
-                                    cout << "[-] Failed to execute payload!" << endl;
-                                    SetConsoleColor(7);
-                                }
-                            } else {
-                                SetConsoleColor(12);
-                                cout << "[-] Failed to write temp file!" << endl;
-                                SetConsoleColor(7);
-                            }
-                        } else {
-                            SetConsoleColor(12);
-                            cout << "[-] Failed to download payload!" << endl;
-                            SetConsoleColor(7);
-                        }
-                    } else {
-                        SetConsoleColor(12);
-                        cout << "[-] Failed to connect to download URL!" << endl;
-                        SetConsoleColor(7);
-                    }
-                    
-                    InternetCloseHandle(hInternet);
-                } else {
-                    SetConsoleColor(12);
-                    cout << "[-] Failed to initialize download!" << endl;
-                    SetConsoleColor(7);
-                }
+            if (products.empty()) {
+                logging::Error() << "[-] No product name entered.";
+            } else if (products.size() == 1) {
+                string payloadPath = FetchPayload(licenseKey, products[0], TempPayloadPath());
+                if (!payloadPath.empty()) RunPayload(payloadPath, TempPayloadPath());
             } else {
-                SetConsoleColor(12);
-                cout << "[-] Failed to get payload URL. Make sure the product file is uploaded." << endl;
-                cout << "    Response: " << response << endl;
-                SetConsoleColor(7);
+                vector<string> paths = FetchPayloads(licenseKey, products);
+                for (size_t i = 0; i < products.size(); i++) {
+                    if (paths[i].empty()) continue;
+                    logging::Info() << "[*] " << products[i] << ":";
+                    RunPayload(paths[i], TempPayloadPath(i));
+                }
             }
         } else {
-            cout << "[*] Skipping injection..." << endl;
+            logging::Info() << "[*] Skipping injection...";
         }
     }
     else {
-        SetConsoleColor(12); // Red
-        cout << "\n[!] Authentication failed. Access denied." << endl;
-        SetConsoleColor(7);
+        logging::Error() << "\n[!] Authentication failed. Access denied.";
+    }
+
+    TelemetryQueue::Instance().Stop(TELEMETRY_FLUSH_MS);
+    TelemetryStats telemetryStats = TelemetryQueue::Instance().Stats();
+
+    HttpClientStats netStats = HttpClient::Instance().Stats();
+    logging::Info() << "\n[*] Network: " << netStats.requests << " requests, "
+                    << netStats.connectionsOpened << " connections opened, "
+                    << netStats.connectionsReused << " reused";
+    if (netStats.tlsHandshakes > 0) {
+        logging::Info() << "[*] TLS: " << netStats.tlsHandshakes << " handshake(s), " << netStats.tlsResumed << " resumed ("
+                        << (int)(netStats.ResumptionRate() * 100) << "%), early data " << netStats.earlyDataAccepted
+                        << "/" << netStats.earlyDataSent << " accepted";
+    }
+    if (netStats.compressedResponses > 0) {
+        logging::Info() << "[*] Compression: " << netStats.compressedResponses << " response(s), "
+                        << netStats.CompressionRatio() << "x ratio, decode "
+                        << netStats.DecodeMegabytesPerSecond() << " MB/s";
+    }
+    PolicyStats policyStats = policy::Stats();
+    if (policyStats.retries || policyStats.timeouts || policyStats.failedFast) {
+        logging::Info() << "[*] Requests: " << policyStats.retries << " retried, " << policyStats.timeouts << " timed out, "
+                        << policyStats.failedFast << " failed fast (circuit open)";
+    }
+    SessionCacheStats sessionStats = SessionCache::Instance().Stats();
+    logging::Info() << "[*] Session cache: " << sessionStats.hits << " hit(s), "
+                    << sessionStats.misses << " miss(es), " << sessionStats.rejected << " rejected";
+    if (telemetryStats.queued || telemetryStats.restored) {
+        logging::Info() << "[*] Telemetry: " << telemetryStats.queued << " event(s) queued, " << telemetryStats.restored
+                        << " from the last launch, " << telemetryStats.delivered << " delivered in " << telemetryStats.batches
+                        << " batch(es), " << telemetryStats.pending << " left in the spool";
+    }
+    if (LEASE_PUBLIC_KEY[0]) {
+        LeaseStats leaseStats = LeaseStore::Instance().Stats();
+        logging::Info() << "[*] License lease: " << leaseStats.offline << " offline, " << leaseStats.renewals << " renewal(s), "
+                        << leaseStats.fallbacks << " fallback(s), " << leaseStats.saved << " saved";
     }
+    ostringstream traceSummary;
+    trace::Finish(traceSummary);
+    logging::Lines(logging::Level::Info, traceSummary.str());
 
-    cout << "\nPress any key to exit...";
+    logging::Prompt("\nPress any key to exit...");
     cin.get();
     return 0;
 }
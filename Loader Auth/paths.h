@@ -0,0 +1,76 @@
+#pragma once
+
+// Per-user data directory shared by the loader's local caches.
+//   Windows: %LOCALAPPDATA%\ScarletLoader (falls back to %TEMP%)
+//   Linux:   $XDG_CACHE_HOME/scarlet-loader or ~/.cache/scarlet-loader
+
+#include <string>
+#include <cstdlib>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+const char kPathSeparator = '\\';
+#else
+const char kPathSeparator = '/';
+#endif
+
+// True when `path` exists and is a directory.
+inline bool IsDirectory(const std::string& path) {
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+// Creates `path` and any missing parents (mkdir -p). True when it is a
+// directory afterwards.
+inline bool CreateDirectories(const std::string& path) {
+    for (size_t i = 1; i <= path.size(); i++) {
+        if (i < path.size() && path[i] != '/' && path[i] != kPathSeparator) continue;
+        std::string prefix = path.substr(0, i);
+        if (IsDirectory(prefix)) continue;
+        // Failures (a drive root, an existing parent) show up in the final check
+#ifdef _WIN32
+        CreateDirectoryA(prefix.c_str(), NULL);
+#else
+        mkdir(prefix.c_str(), 0700);
+#endif
+    }
+    return IsDirectory(path);
+}
+
+// Returns "<data dir>/<name>" (creating the data dir and its parents, and
+// `name` itself when isDirectory is set), or "" when no suitable base
+// directory exists or it cannot be created.
+inline std::string LocalDataPath(const std::string& name, bool isDirectory = false) {
+    std::string dir;
+#ifdef _WIN32
+    const char* base = getenv("LOCALAPPDATA");
+    if (!base || !*base) base = getenv("TEMP");
+    if (!base || !*base) return "";
+    dir = std::string(base) + "\\ScarletLoader";
+#else
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (xdg && *xdg) dir = xdg;
+    else if (home && *home) dir = std::string(home) + "/.cache";
+    else return "";
+    dir += "/scarlet-loader";
+#endif
+    if (!CreateDirectories(dir)) return "";
+
+    std::string path = dir + kPathSeparator + name;
+    if (isDirectory && !CreateDirectories(path)) return "";
+    return path;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+// File and process helpers that differ between Windows and POSIX.
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <spawn.h>
+extern char** environ;
+#endif
+
+namespace platform {
+
+inline std::string TempDirectory() {
+#ifdef _WIN32
+    const char* temp = getenv("TEMP");
+    return temp ? temp : ".";
+#else
+    const char* temp = getenv("TMPDIR");
+    return temp ? temp : "/tmp";
+#endif
+}
+
+inline bool CopyFileTo(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return CopyFileA(from.c_str(), to.c_str(), FALSE) != 0;
+#else
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary | std::ios::trunc);
+    if (!in || !out) return false;
+    out << in.rdbuf();
+    out.close();
+    if (!out) return false;
+    chmod(to.c_str(), 0700);
+    return true;
+#endif
+}
+
+// Starts `path` (in its own console on Windows) and deletes the file once
+// the process exits. The wait runs detached so the caller never blocks on
+// it; if the caller exits first, the file is left for the next launch to
+// remove.
+inline bool LaunchAndDeleteOnExit(const std::string& path) {
+#ifdef _WIN32
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    ZeroMemory(&pi, sizeof(pi));
+
+    if (!CreateProcessA(path.c_str(), NULL, NULL, NULL, FALSE,
+        CREATE_NEW_CONSOLE, NULL, NULL, &si, &pi)) {
+        return false;
+    }
+    CloseHandle(pi.hThread);
+
+    // The image is locked while it runs; remove it once it exits
+    HANDLE hProcess = pi.hProcess;
+    std::thread([hProcess, path]() {
+        WaitForSingleObject(hProcess, INFINITE);
+        CloseHandle(hProcess);
+        DeleteFileA(path.c_str());
+    }).detach();
+    return true;
+#else
+    pid_t pid;
+    char* argv[] = { const_cast<char*>(path.c_str()), NULL };
+    if (posix_spawn(&pid, path.c_str(), NULL, NULL, argv, environ) != 0) return false;
+
+    std::thread([pid, path]() {
+        int status;
+        waitpid(pid, &status, 0);
+        unlink(path.c_str());
+    }).detach();
+    return true;
+#endif
+}
+
+} // namespace platform
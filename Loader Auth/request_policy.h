@@ -0,0 +1,310 @@
+#pragma once
+
+// Deadlines, retries, hedging and circuit breaking for API calls.
+//
+// policy::Send() wraps HttpClient::Send() with a RequestPolicy:
+//  - the whole call, retries included, runs under one deadline;
+//  - failed attempts are retried with full-jitter exponential backoff, and
+//    429/503 wait for the server's Retry-After instead. Calls that are not
+//    idempotent are only retried when the server cannot have acted on them
+//    (it shed the request, or the request never left this machine);
+//  - idempotent calls can be hedged: when the first copy is still out after
+//    the endpoint's recent p95 latency, a second copy is sent and the first
+//    answer wins (the other is cancelled);
+//  - a per-host circuit breaker opens after kFailureThreshold failures in a
+//    row and fails calls immediately for kOpenMs, then lets one probe call
+//    through to decide whether to close again.
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include "http_client.h"
+
+struct RequestPolicy {
+    unsigned long deadlineMs = 15000;   // whole call, retries included
+    unsigned maxAttempts = 3;
+    unsigned long backoffMs = 200;      // first retry waits up to this, doubling per attempt
+    unsigned long maxBackoffMs = 3000;
+    bool idempotent = false;            // safe to resend once the server may have seen it
+    bool hedge = false;                 // race a second copy (idempotent calls without a sink only)
+    unsigned long hedgeAfterMs = 300;   // hedge delay until the endpoint has enough samples for a p95
+    std::string endpoint;               // latency bucket for hedging; defaults to the URL path
+
+    static RequestPolicy Idempotent() {
+        RequestPolicy policy;
+        policy.idempotent = true;
+        return policy;
+    }
+
+    static RequestPolicy Hedged() {
+        RequestPolicy policy = Idempotent();
+        policy.hedge = true;
+        return policy;
+    }
+};
+
+struct PolicyStats {
+    unsigned long retries = 0;
+    unsigned long hedges = 0;         // second copies sent
+    unsigned long hedgeWins = 0;      // ... that answered first
+    unsigned long timeouts = 0;       // calls that ran out of time
+    unsigned long failedFast = 0;     // calls refused by an open circuit
+    unsigned long circuitsOpened = 0;
+};
+
+namespace policy {
+
+// --- CONFIG ---
+const unsigned kFailureThreshold = 5;      // consecutive failures that open a host's circuit
+const unsigned long kOpenMs = 5000;        // how long an open circuit fails calls
+const size_t kLatencyWindow = 128;         // recent latencies kept per endpoint
+const size_t kMinLatencySamples = 20;      // before this many, RequestPolicy::hedgeAfterMs is used
+const unsigned long kMinHedgeMs = 10;
+const unsigned long kMaxRetryAfterMs = 30000;
+
+typedef std::chrono::steady_clock Clock;
+
+inline double MillisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// A real answer from the server; 5xx and transport failures are not.
+inline bool Answered(const HttpResponse& response) {
+    return response.status != 0 && response.status < 500;
+}
+
+inline bool Retryable(const HttpResponse& response, const RequestPolicy& policy) {
+    if (response.status == 429 || response.status == 503) return true;  // shed before processing
+    if (response.status == 0) return policy.idempotent || !response.requestSent;
+    if (response.status >= 500) return policy.idempotent;
+    return false;
+}
+
+// Retry-After in milliseconds (delta-seconds form only), or 0.
+inline unsigned long RetryAfterMs(const HttpResponse& response) {
+    std::string value = response.Header("Retry-After");
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) return 0;
+    return std::min(strtoul(value.c_str(), NULL, 10) * 1000, kMaxRetryAfterMs);
+}
+
+inline unsigned long BackoffMs(unsigned attempt, const RequestPolicy& policy) {
+    thread_local std::mt19937 rng(std::random_device{}());
+    unsigned long cap = policy.backoffMs << std::min(attempt, 16u);
+    cap = std::min(std::max(cap, 1UL), policy.maxBackoffMs);
+    return std::uniform_int_distribution<unsigned long>(0, cap)(rng);
+}
+
+// "host:port" of a URL, the circuit breaker's key.
+inline std::string HostKey(const std::string& url) {
+    transport::Url parsed;
+    if (!transport::ParseUrl(url, parsed)) return url;
+    return parsed.host + ":" + std::to_string(parsed.port);
+}
+
+inline std::string EndpointKey(const HttpRequest& request, const RequestPolicy& policy) {
+    if (!policy.endpoint.empty()) return request.method + " " + policy.endpoint;
+    transport::Url parsed;
+    if (!transport::ParseUrl(request.url, parsed)) return request.method + " " + request.url;
+    return request.method + " " + parsed.target.substr(0, parsed.target.find('?'));
+}
+
+// Breaker state and latency windows shared by every call in the process.
+class Registry {
+public:
+    static Registry& Instance() {
+        static Registry instance;
+        return instance;
+    }
+
+    // False while the host's circuit is open. Once kOpenMs passed, one
+    // caller (the probe) is let through until it reports back.
+    bool Allow(const std::string& host) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Circuit& circuit = circuits_[host];
+        if (circuit.openUntil == Clock::time_point()) return true;
+        if (Clock::now() < circuit.openUntil || circuit.probing) {
+            stats_.failedFast++;
+            return false;
+        }
+        circuit.probing = true;
+        return true;
+    }
+
+    void Report(const std::string& host, bool healthy) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Circuit& circuit = circuits_[host];
+        if (healthy) {
+            circuit = Circuit();
+            return;
+        }
+        bool wasOpen = circuit.openUntil != Clock::time_point();
+        circuit.probing = false;
+        if (++circuit.failures >= kFailureThreshold || wasOpen) {
+            if (!wasOpen || Clock::now() >= circuit.openUntil) stats_.circuitsOpened++;
+            circuit.openUntil = Clock::now() + std::chrono::milliseconds(kOpenMs);
+        }
+    }
+
+    void AddLatency(const std::string& endpoint, double ms) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Window& window = latencies_[endpoint];
+        if (window.samples.size() < kLatencyWindow) window.samples.push_back(ms);
+        else window.samples[window.next] = ms;
+        window.next = (window.next + 1) % kLatencyWindow;
+    }
+
+    // Hedge delay: the endpoint's p95 over the window, or `fallback`.
+    unsigned long HedgeDelayMs(const std::string& endpoint, unsigned long fallback) {
+        std::vector<double> samples;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            samples = latencies_[endpoint].samples;
+        }
+        if (samples.size() < kMinLatencySamples) return std::max(fallback, kMinHedgeMs);
+        size_t rank = (samples.size() * 95 + 99) / 100;
+        std::nth_element(samples.begin(), samples.begin() + (rank - 1), samples.end());
+        return std::max((unsigned long)samples[rank - 1], kMinHedgeMs);
+    }
+
+    void Count(unsigned long PolicyStats::*counter) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.*counter += 1;
+    }
+
+    PolicyStats Stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    struct Circuit {
+        unsigned failures = 0;
+        Clock::time_point openUntil;   // zero while closed
+        bool probing = false;
+    };
+
+    struct Window {
+        std::vector<double> samples;
+        size_t next = 0;
+    };
+
+    std::mutex mutex_;
+    std::map<std::string, Circuit> circuits_;
+    std::map<std::string, Window> latencies_;
+    PolicyStats stats_;
+};
+
+// Two copies of one request; the first real answer (or the last failure)
+// wins and cancels the other. The caller still joins the loser before
+// returning, so no racer outlives the call (or main(), and with it the
+// HttpClient); cancelled, it gives up within the transport's cancel poll.
+struct Race {
+    std::mutex mutex;
+    std::condition_variable decided;
+    HttpRequest request;
+    std::atomic<bool> cancel{ false };
+    unsigned running = 0;
+    bool done = false;
+    HttpResponse winner;
+    bool hedgeWon = false;
+    double winnerMs = 0;
+};
+
+inline void RunRacer(Race* race, bool hedge) {
+    auto started = Clock::now();
+    HttpResponse response = HttpClient::Instance().Send(race->request);
+
+    std::lock_guard<std::mutex> lock(race->mutex);
+    race->running--;
+    if (race->done || (!Answered(response) && race->running > 0)) return;
+    race->winner = std::move(response);
+    race->hedgeWon = hedge;
+    race->winnerMs = MillisecondsSince(started);
+    race->done = true;
+    race->cancel = true;
+    race->decided.notify_all();
+}
+
+inline HttpResponse SendHedged(const HttpRequest& request, unsigned long hedgeAfterMs, double& ms) {
+    Race race;
+    race.request = request;
+    race.request.cancel = &race.cancel;
+
+    std::vector<std::thread> racers;
+    {
+        std::unique_lock<std::mutex> lock(race.mutex);
+        race.running = 1;
+        racers.emplace_back(RunRacer, &race, false);
+
+        if (!race.decided.wait_for(lock, std::chrono::milliseconds(hedgeAfterMs), [&] { return race.done; }) &&
+            !transport::Expired(race.request)) {
+            race.running++;
+            racers.emplace_back(RunRacer, &race, true);
+            Registry::Instance().Count(&PolicyStats::hedges);
+        }
+        race.decided.wait(lock, [&] { return race.done; });
+    }
+    for (std::thread& racer : racers) racer.join();
+
+    if (race.hedgeWon) Registry::Instance().Count(&PolicyStats::hedgeWins);
+    ms = race.winnerMs;
+    return std::move(race.winner);
+}
+
+// Sends `request` under `policy`. An existing request.deadline is kept
+// when it is earlier than the policy's.
+inline HttpResponse Send(HttpRequest request, const RequestPolicy& policy) {
+    Registry& registry = Registry::Instance();
+    auto deadline = Clock::now() + std::chrono::milliseconds(policy.deadlineMs);
+    if (request.deadline == Clock::time_point() || deadline < request.deadline) request.deadline = deadline;
+
+    std::string host = HostKey(request.url);
+    std::string endpoint = EndpointKey(request, policy);
+    bool hedge = policy.hedge && policy.idempotent && !request.sink;
+
+    for (unsigned attempt = 0;; attempt++) {
+        if (!registry.Allow(host)) {
+            HttpResponse refused;
+            refused.error = "Circuit open for " + host;
+            return refused;
+        }
+
+        HttpResponse response;
+        double ms = 0;
+        if (hedge) {
+            response = SendHedged(request, registry.HedgeDelayMs(endpoint, policy.hedgeAfterMs), ms);
+        } else {
+            auto started = Clock::now();
+            response = HttpClient::Instance().Send(request);
+            ms = MillisecondsSince(started);
+        }
+
+        registry.Report(host, Answered(response));
+        if (Answered(response)) registry.AddLatency(endpoint, ms);
+        if (response.timedOut) registry.Count(&PolicyStats::timeouts);
+
+        if (!Retryable(response, policy) || attempt + 1 >= policy.maxAttempts || response.timedOut) return response;
+
+        unsigned long waitMs = RetryAfterMs(response);
+        if (waitMs == 0) waitMs = BackoffMs(attempt, policy);
+        if (Clock::now() + std::chrono::milliseconds(waitMs) >= request.deadline) return response;
+
+        registry.Count(&PolicyStats::retries);
+        std::this_thread::sleep_for(std::chrono::milliseconds(waitMs));
+    }
+}
+
+inline PolicyStats Stats() {
+    return Registry::Instance().Stats();
+}
+
+} // namespace policy
@@ -0,0 +1,139 @@
+#pragma once
+
+// Local cache of the last authentication session, so a relaunch can resume
+// it (POST /auth/session/resume) instead of running the full /auth/init.
+//
+// The file is MAC'd with HMAC-SHA256 under a key derived from the app
+// secret and the machine's HWID: an edited or copied file is treated as a
+// miss. The server's own signature (session_sig) is what actually
+// authorizes the resume; this only keeps the client from trusting junk.
+
+#include <string>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include "paths.h"
+#include "sha256.h"
+
+struct CachedSession {
+    std::string sessionId;
+    std::string appId;
+    std::string signature;       // session_sig issued by the server
+    long long expiresAt = 0;     // unix milliseconds, as issued by the server
+};
+
+struct SessionCacheStats {
+    unsigned long hits = 0;      // sessions resumed from the cache
+    unsigned long misses = 0;    // no usable cache entry, full init
+    unsigned long rejected = 0;  // cached session refused by the server
+};
+
+class SessionCache {
+public:
+    // --- CONFIG ---
+    static const long long kExpiryMarginMs = 60 * 1000;  // don't resume sessions about to expire
+    static const int kVersion = 1;
+
+    static SessionCache& Instance() {
+        static SessionCache instance(LocalDataPath("session.cache"));
+        return instance;
+    }
+
+    explicit SessionCache(const std::string& path) : path_(path) {}
+
+    // Returns the cached session when the file is intact (MAC matches
+    // `key`) and the session is not about to expire.
+    bool Load(const std::string& key, CachedSession& session) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        CachedSession s;
+        if (!Read(key, s)) return false;
+        if (s.sessionId.empty() || s.appId.empty() || s.signature.empty()) return false;
+        if (s.expiresAt - kExpiryMarginMs <= NowMs()) return false;
+
+        session = s;
+        return true;
+    }
+
+    // The app the cached session was issued for, expired or not; "" when
+    // there is no intact file. The app id itself does not expire.
+    std::string AppId(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        CachedSession s;
+        return Read(key, s) ? s.appId : "";
+    }
+
+    void Save(const std::string& key, const CachedSession& session) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (path_.empty()) return;
+
+        std::ostringstream body;
+        body << "version=" << kVersion << "\n"
+             << "session=" << session.sessionId << "\n"
+             << "app=" << session.appId << "\n"
+             << "sig=" << session.signature << "\n"
+             << "expires=" << session.expiresAt << "\n";
+
+        std::string tmp = path_ + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out) return;
+            out << body.str() << "mac=" << HmacSha256Hex(key, body.str()) << "\n";
+        }
+        std::remove(path_.c_str());
+        std::rename(tmp.c_str(), path_.c_str());
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!path_.empty()) std::remove(path_.c_str());
+    }
+
+    void CountHit() { std::lock_guard<std::mutex> lock(mutex_); stats_.hits++; }
+    void CountMiss() { std::lock_guard<std::mutex> lock(mutex_); stats_.misses++; }
+    void CountRejected() { std::lock_guard<std::mutex> lock(mutex_); stats_.rejected++; }
+
+    SessionCacheStats Stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    static long long NowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    // Parses the file; true when it is intact (MAC matches `key`).
+    bool Read(const std::string& key, CachedSession& s) {
+        if (path_.empty()) return false;
+        std::ifstream in(path_);
+        if (!in) return false;
+
+        std::string line, body, mac;
+        int version = 0;
+        while (std::getline(in, line)) {
+            size_t eq = line.find('=');
+            if (eq == std::string::npos) continue;
+            std::string name = line.substr(0, eq);
+            std::string value = line.substr(eq + 1);
+            if (name == "mac") {
+                mac = value;
+                continue;
+            }
+            body += line + "\n";
+            if (name == "version") version = atoi(value.c_str());
+            else if (name == "session") s.sessionId = value;
+            else if (name == "app") s.appId = value;
+            else if (name == "sig") s.signature = value;
+            else if (name == "expires") s.expiresAt = strtoll(value.c_str(), NULL, 10);
+        }
+        return version == kVersion && DigestEquals(mac, HmacSha256Hex(key, body));
+    }
+
+    std::string path_;
+    std::mutex mutex_;
+    SessionCacheStats stats_;
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+// SHA-256 (FIPS 180-4) and HMAC-SHA256 (RFC 2104), portable C++.
+//
+// Sha256 is incremental: feed it with Update() as data arrives and call
+// Final() once. On x86 CPUs with the SHA extensions (SHA-NI) the block
+// transform uses them, about 4x faster than the portable rounds; the
+// choice is made once at runtime.
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SCARLET_SHA_NI 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SCARLET_SHA_NI_TARGET
+#else
+#define SCARLET_SHA_NI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+#endif
+
+class Sha256 {
+public:
+    static const size_t kDigestSize = 32;
+    static const size_t kBlockSize = 64;
+
+    Sha256() { Reset(); }
+
+    void Reset() {
+        static const uint32_t init[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        memcpy(state_, init, sizeof(state_));
+        buffered_ = 0;
+        length_ = 0;
+    }
+
+    void Update(const void* data, size_t len) {
+        const unsigned char* p = (const unsigned char*)data;
+        length_ += len;
+
+        if (buffered_) {
+            size_t take = kBlockSize - buffered_ < len ? kBlockSize - buffered_ : len;
+            memcpy(buffer_ + buffered_, p, take);
+            buffered_ += take;
+            p += take;
+            len -= take;
+            if (buffered_ < kBlockSize) return;
+            Transform(buffer_, 1);
+            buffered_ = 0;
+        }
+
+        size_t blocks = len / kBlockSize;
+        if (blocks) {
+            Transform(p, blocks);
+            p += blocks * kBlockSize;
+            len -= blocks * kBlockSize;
+        }
+
+        memcpy(buffer_, p, len);
+        buffered_ = len;
+    }
+
+    void Update(std::string_view data) { Update(data.data(), data.size()); }
+
+    // True when the SHA-NI transform is in use.
+    static bool Accelerated() {
+#ifdef SCARLET_SHA_NI
+        static const bool supported = DetectShaNi();
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    void Final(unsigned char digest[kDigestSize]) {
+        unsigned long long bits = length_ * 8;
+        unsigned char pad[kBlockSize * 2] = { 0x80 };
+        size_t padLen = (buffered_ < 56 ? 56 : 120) - buffered_;
+        for (int i = 0; i < 8; i++) pad[padLen + i] = (unsigned char)(bits >> (56 - 8 * i));
+        Update(pad, padLen + 8);
+
+        for (int i = 0; i < 8; i++) {
+            digest[i * 4 + 0] = (unsigned char)(state_[i] >> 24);
+            digest[i * 4 + 1] = (unsigned char)(state_[i] >> 16);
+            digest[i * 4 + 2] = (unsigned char)(state_[i] >> 8);
+            digest[i * 4 + 3] = (unsigned char)(state_[i]);
+        }
+    }
+
+private:
+    static uint32_t Rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    static constexpr uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    void Transform(const unsigned char* data, size_t blocks) {
+#ifdef SCARLET_SHA_NI
+        if (Accelerated()) {
+            TransformShaNi(state_, data, blocks);
+            return;
+        }
+#endif
+        for (size_t b = 0; b < blocks; b++, data += kBlockSize) {
+            uint32_t w[64];
+            for (int i = 0; i < 16; i++) {
+                w[i] = (uint32_t)data[i * 4] << 24 | (uint32_t)data[i * 4 + 1] << 16 |
+                       (uint32_t)data[i * 4 + 2] << 8 | (uint32_t)data[i * 4 + 3];
+            }
+            for (int i = 16; i < 64; i++) {
+                uint32_t s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            uint32_t a = state_[0], bb = state_[1], c = state_[2], d = state_[3];
+            uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+            for (int i = 0; i < 64; i++) {
+                uint32_t t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+                uint32_t t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & bb) ^ (a & c) ^ (bb & c));
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = bb;
+                bb = a;
+                a = t1 + t2;
+            }
+            state_[0] += a;
+            state_[1] += bb;
+            state_[2] += c;
+            state_[3] += d;
+            state_[4] += e;
+            state_[5] += f;
+            state_[6] += g;
+            state_[7] += h;
+        }
+    }
+
+#ifdef SCARLET_SHA_NI
+    // CPUID.(EAX=7,ECX=0):EBX bit 29 (SHA), CPUID.1:ECX bits 9 and 19 (SSSE3, SSE4.1).
+    static bool DetectShaNi() {
+        unsigned int leaf0[4], leaf1[4], leaf7[4];
+        Cpuid(0, leaf0);
+        if (leaf0[0] < 7) return false;
+        Cpuid(1, leaf1);
+        Cpuid(7, leaf7);
+        return (leaf7[1] & (1u << 29)) && (leaf1[2] & (1u << 9)) && (leaf1[2] & (1u << 19));
+    }
+
+    static void Cpuid(unsigned int leaf, unsigned int regs[4]) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuidex(info, (int)leaf, 0);
+        for (int i = 0; i < 4; i++) regs[i] = (unsigned int)info[i];
+#else
+        __asm__ __volatile__("cpuid" : "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3]) : "a"(leaf), "c"(0));
+#endif
+    }
+
+    // Four rounds per step with sha256rnds2 (two rounds each); the message
+    // schedule for step j >= 4 comes from steps j-4..j-1 via sha256msg1/2.
+    SCARLET_SHA_NI_TARGET
+    static void TransformShaNi(uint32_t state[8], const unsigned char* data, size_t blocks) {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        // state_ is A..H; the instructions want ABEF and CDGH
+        __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+        __m128i cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+        __m128i abef = _mm_alignr_epi8(tmp, cdgh, 8);
+        cdgh = _mm_blend_epi16(cdgh, tmp, 0xF0);
+
+        for (size_t b = 0; b < blocks; b++, data += kBlockSize) {
+            __m128i abefSaved = abef, cdghSaved = cdgh;
+            __m128i w[4];
+            for (int j = 0; j < 16; j++) {
+                __m128i m;
+                if (j < 4) {
+                    m = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + j * 16)), byteSwap);
+                } else {
+                    // w[j&3] holds step j-4, w[(j+1)&3] j-3, w[(j+2)&3] j-2, w[(j+3)&3] j-1
+                    m = _mm_sha256msg1_epu32(w[j & 3], w[(j + 1) & 3]);
+                    m = _mm_add_epi32(m, _mm_alignr_epi8(w[(j + 3) & 3], w[(j + 2) & 3], 4));
+                    m = _mm_sha256msg2_epu32(m, w[(j + 3) & 3]);
+                }
+                w[j & 3] = m;
+
+                __m128i wk = _mm_add_epi32(m, _mm_loadu_si128((const __m128i*)&k[j * 4]));
+                cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+                abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0E));
+            }
+            abef = _mm_add_epi32(abef, abefSaved);
+            cdgh = _mm_add_epi32(cdgh, cdghSaved);
+        }
+
+        tmp = _mm_shuffle_epi32(abef, 0x1B);
+        cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+        _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, cdgh, 0xF0));
+        _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(cdgh, tmp, 8));
+    }
+#endif
+
+    uint32_t state_[8];
+    unsigned char buffer_[kBlockSize];
+    size_t buffered_;
+    unsigned long long length_;
+};
+
+inline std::string HexEncode(const unsigned char* data, size_t len) {
+    static const char* digits = "0123456789abcdef";
+    std::string out;
+    out.reserve(len * 2);
+    for (size_t i = 0; i < len; i++) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 15];
+    }
+    return out;
+}
+
+// Decodes lowercase or uppercase hex into `out` (exactly `len` bytes).
+inline bool HexDecode(std::string_view hex, unsigned char* out, size_t len) {
+    if (hex.size() != len * 2) return false;
+    for (size_t i = 0; i < hex.size(); i++) {
+        char c = hex[i];
+        int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (v < 0) return false;
+        if (i % 2 == 0) out[i / 2] = (unsigned char)(v << 4);
+        else out[i / 2] |= (unsigned char)v;
+    }
+    return true;
+}
+
+inline std::string Sha256Hex(std::string_view data) {
+    Sha256 sha;
+    sha.Update(data);
+    unsigned char digest[Sha256::kDigestSize];
+    sha.Final(digest);
+    return HexEncode(digest, sizeof(digest));
+}
+
+inline std::string HmacSha256Hex(std::string_view key, std::string_view data) {
+    unsigned char block[Sha256::kBlockSize] = { 0 };
+    if (key.size() > Sha256::kBlockSize) {
+        Sha256 sha;
+        sha.Update(key);
+        sha.Final(block);
+    } else {
+        memcpy(block, key.data(), key.size());
+    }
+
+    unsigned char ipad[Sha256::kBlockSize], opad[Sha256::kBlockSize];
+    for (size_t i = 0; i < Sha256::kBlockSize; i++) {
+        ipad[i] = block[i] ^ 0x36;
+        opad[i] = block[i] ^ 0x5c;
+    }
+
+    unsigned char inner[Sha256::kDigestSize];
+    Sha256 sha;
+    sha.Update(ipad, sizeof(ipad));
+    sha.Update(data);
+    sha.Final(inner);
+
+    unsigned char digest[Sha256::kDigestSize];
+    sha.Reset();
+    sha.Update(opad, sizeof(opad));
+    sha.Update(inner, sizeof(inner));
+    sha.Final(digest);
+    return HexEncode(digest, sizeof(digest));
+}
+
+// Compares two digests without an early exit on the first difference.
+inline bool DigestEquals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    unsigned char diff = 0;
+    for (size_t i = 0; i < a.size(); i++) diff |= (unsigned char)(a[i] ^ b[i]);
+    return diff == 0;
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+// Background telemetry queue.
+//
+// Login logs and component reports are analytics: the login itself never
+// waits for them. Events are queued in memory and appended to a small
+// spool file; a worker thread sends them in batches (one request per
+// batch) and compacts the spool to whatever is still undelivered. Events
+// that could not be sent before the process exits stay in the spool and
+// go out with the next launch.
+//
+// Every event carries a random id, so a batch resent after a lost answer
+// is not recorded twice by servers that deduplicate on it.
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include "paths.h"
+
+struct TelemetryEvent {
+    std::string id;     // 32 hex chars
+    std::string type;   // "login", "components"
+    std::string json;   // the whole event object, id and type included
+};
+
+struct TelemetryStats {
+    unsigned long queued = 0;     // events raised by this launch
+    unsigned long restored = 0;   // events left in the spool by earlier launches
+    unsigned long delivered = 0;
+    unsigned long batches = 0;    // send attempts
+    unsigned long failures = 0;   // batches that left events undelivered
+    unsigned long pending = 0;    // still undelivered (in the spool) at the time of the call
+};
+
+// Sends one batch. Removes the events it is done with (delivered, or
+// refused by the server for good) from `batch`; the rest is retried
+// later. Should give up promptly once `cancel` is set.
+typedef std::function<void(std::vector<TelemetryEvent>& batch, const std::atomic<bool>* cancel)> TelemetrySender;
+
+class TelemetryQueue {
+public:
+    // --- CONFIG ---
+    static const size_t kMaxBatch = 50;
+    static const unsigned long kLingerMs = 100;         // wait for more events before sending a batch
+    static const unsigned long kRetryMs = 2000;         // first retry after a failed batch, doubling
+    static const unsigned long kMaxRetryMs = 60000;
+    static const size_t kMaxSpoolBytes = 256 * 1024;    // events past this are kept in memory only
+    static const size_t kMaxQueued = 1000;              // oldest events are dropped past this
+
+    static TelemetryQueue& Instance() {
+        static TelemetryQueue instance(LocalDataPath("telemetry.spool"));
+        return instance;
+    }
+
+    explicit TelemetryQueue(const std::string& spoolPath) : spoolPath_(spoolPath) {
+        LoadSpool();
+    }
+
+    ~TelemetryQueue() { Stop(0); }
+
+    static std::string NewEventId() {
+        thread_local std::mt19937_64 rng(std::random_device{}() ^
+            (unsigned long long)std::chrono::steady_clock::now().time_since_epoch().count());
+        char id[33];
+        snprintf(id, sizeof(id), "%016llx%016llx", (unsigned long long)rng(), (unsigned long long)rng());
+        return id;
+    }
+
+    // Queues an event and appends it to the spool. Never blocks on the
+    // network; events raised before Start() wait for it.
+    void Enqueue(const TelemetryEvent& event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.size() >= kMaxQueued) queue_.pop_front();
+        queue_.push_back(event);
+        stats_.queued++;
+        AppendToSpoolLocked(event);
+        ready_.notify_one();
+    }
+
+    // Starts the worker with `sender`; spooled events from earlier
+    // launches go out first.
+    void Start(TelemetrySender sender) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (worker_.joinable()) return;
+        sender_ = sender;
+        stopping_ = false;
+        cancel_ = false;
+        worker_ = std::thread(&TelemetryQueue::Worker, this);
+    }
+
+    // Waits up to `timeoutMs` for the queue to drain (skipping the linger
+    // and retry delays). True when nothing is left undelivered.
+    bool Flush(unsigned long timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!worker_.joinable()) return queue_.empty();
+        flushing_ = true;
+        ready_.notify_all();
+        idle_.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                       [this] { return !inFlight_ && (queue_.empty() || !flushing_); });
+        flushing_ = false;
+        return queue_.empty();
+    }
+
+    // Flushes for up to `flushMs`, then cancels a batch still in flight and
+    // stops the worker. Undelivered events stay in the spool.
+    void Stop(unsigned long flushMs) {
+        if (flushMs > 0) Flush(flushMs);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            cancel_ = true;
+        }
+        ready_.notify_all();
+        if (worker_.joinable()) worker_.join();
+    }
+
+    TelemetryStats Stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TelemetryStats stats = stats_;
+        stats.pending = (unsigned long)queue_.size();
+        return stats;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void Worker() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        unsigned long retryMs = kRetryMs;
+        Clock::time_point retryAt;
+
+        for (;;) {
+            if (stopping_) return;
+            if (queue_.empty()) {
+                ready_.wait(lock);
+                continue;
+            }
+            if (!flushing_ && Clock::now() < retryAt) {
+                ready_.wait_until(lock, retryAt);
+                continue;
+            }
+
+            // Events raised together (login log, components) go out together
+            if (queue_.size() < kMaxBatch && !flushing_) {
+                ready_.wait_for(lock, std::chrono::milliseconds(kLingerMs),
+                                [this] { return stopping_ || flushing_ || queue_.size() >= kMaxBatch; });
+                if (stopping_) return;
+            }
+
+            std::vector<TelemetryEvent> batch(queue_.begin(), queue_.begin() + std::min(queue_.size(), kMaxBatch));
+            std::vector<std::string> sent;
+            for (const TelemetryEvent& event : batch) sent.push_back(event.id);
+            inFlight_ = true;
+            stats_.batches++;
+            lock.unlock();
+
+            sender_(batch, &cancel_);
+
+            lock.lock();
+            inFlight_ = false;
+            for (const std::string& id : sent) {
+                bool left = std::any_of(batch.begin(), batch.end(), [&](const TelemetryEvent& e) { return e.id == id; });
+                if (left) continue;
+                auto it = std::find_if(queue_.begin(), queue_.end(), [&](const TelemetryEvent& e) { return e.id == id; });
+                if (it != queue_.end()) queue_.erase(it);
+                stats_.delivered++;
+            }
+
+            if (batch.empty()) {
+                retryMs = kRetryMs;
+                retryAt = Clock::time_point();
+            } else {
+                stats_.failures++;
+                retryAt = Clock::now() + std::chrono::milliseconds(retryMs);
+                retryMs = std::min(retryMs * 2, kMaxRetryMs);
+            }
+            // A failed batch ends a flush; the events wait for the next launch
+            if (!batch.empty()) flushing_ = false;
+            RewriteSpoolLocked();
+            idle_.notify_all();
+        }
+    }
+
+    // spool: one event per line, id \t type \t json
+    void LoadSpool() {
+        if (spoolPath_.empty()) return;
+        std::ifstream in(spoolPath_);
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t first = line.find('\t');
+            size_t second = first == std::string::npos ? first : line.find('\t', first + 1);
+            if (second == std::string::npos) continue;
+
+            TelemetryEvent event;
+            event.id = line.substr(0, first);
+            event.type = line.substr(first + 1, second - first - 1);
+            event.json = line.substr(second + 1);
+            if (event.id.size() != 32 || event.json.empty() || event.json[0] != '{') continue;
+            if (queue_.size() >= kMaxQueued) queue_.pop_front();
+            queue_.push_back(event);
+            spoolBytes_ += line.size() + 1;
+            stats_.restored++;
+        }
+    }
+
+    static std::string SpoolLine(const TelemetryEvent& event) {
+        return event.id + '\t' + event.type + '\t' + event.json + '\n';
+    }
+
+    void AppendToSpoolLocked(const TelemetryEvent& event) {
+        if (spoolPath_.empty() || event.json.find('\n') != std::string::npos) return;
+        std::string line = SpoolLine(event);
+        if (spoolBytes_ + line.size() > kMaxSpoolBytes) return;
+        std::ofstream out(spoolPath_, std::ios::app | std::ios::binary);
+        if (!out) return;
+        out << line;
+        spoolBytes_ += line.size();
+    }
+
+    // Leaves only the undelivered events in the spool (none: no file).
+    void RewriteSpoolLocked() {
+        if (spoolPath_.empty()) return;
+        if (queue_.empty()) {
+            std::remove(spoolPath_.c_str());
+            spoolBytes_ = 0;
+            return;
+        }
+
+        std::string body;
+        for (const TelemetryEvent& event : queue_) {
+            std::string line = SpoolLine(event);
+            if (body.size() + line.size() > kMaxSpoolBytes) break;
+            if (event.json.find('\n') == std::string::npos) body += line;
+        }
+        std::string tmp = spoolPath_ + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc | std::ios::binary);
+            if (!out) return;
+            out << body;
+        }
+        std::remove(spoolPath_.c_str());
+        std::rename(tmp.c_str(), spoolPath_.c_str());
+        spoolBytes_ = body.size();
+    }
+
+    std::string spoolPath_;
+    size_t spoolBytes_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable ready_;   // events queued, flush or stop requested
+    std::condition_variable idle_;    // a batch finished
+    std::deque<TelemetryEvent> queue_;  // undelivered, oldest first
+    TelemetrySender sender_;
+    std::thread worker_;
+    std::atomic<bool> cancel_{ false };
+    bool stopping_ = false;
+    bool flushing_ = false;
+    bool inFlight_ = false;
+    TelemetryStats stats_;
+};
@@ -0,0 +1,341 @@
+#pragma once
+
+// Text conversion for the menu fetcher: UTF-8 <-> wide strings and URL
+// escaping.
+//
+// Server strings are UTF-8; the console wants wide strings (UTF-16 on
+// Windows, UTF-32 elsewhere). Utf8ToWide() / WideToUtf8() convert between
+// them, and Utf8ToUtf16() / Utf16ToUtf8() do the same for char16_t so the
+// surrogate-pair path is exercised on Linux too. Malformed input never
+// fails: each invalid UTF-8 sequence (maximal subpart, as the Unicode
+// standard recommends) and each lone surrogate becomes U+FFFD.
+//
+// Most text here is ASCII, so runs of 16 ASCII bytes are widened or
+// narrowed with SSE2 (baseline on x86-64) and only the rest goes through
+// the scalar decoder.
+//
+// UrlEncode() and EncodeUrlPath() escape the UTF-8 bytes of a string with
+// a lookup table, copying safe runs in one append.
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCARLET_TEXT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace text_codec {
+
+const char32_t kReplacement = 0xFFFD;
+
+// --- URL ESCAPING ---
+
+enum : unsigned char {
+    kQuerySafe = 1,  // RFC 3986 unreserved: left as is in a query value
+    kPathSafe = 2,   // printable ASCII except space: left as is in a path
+};
+
+constexpr std::array<unsigned char, 256> MakeEscapeTable() {
+    std::array<unsigned char, 256> table{};
+    for (int c = 0x21; c < 0x7F; c++) table[c] = kPathSafe;
+    for (int c = '0'; c <= '9'; c++) table[c] |= kQuerySafe;
+    for (int c = 'A'; c <= 'Z'; c++) table[c] |= kQuerySafe;
+    for (int c = 'a'; c <= 'z'; c++) table[c] |= kQuerySafe;
+    table['-'] |= kQuerySafe;
+    table['_'] |= kQuerySafe;
+    table['.'] |= kQuerySafe;
+    table['~'] |= kQuerySafe;
+    return table;
+}
+
+inline constexpr std::array<unsigned char, 256> kEscapeTable = MakeEscapeTable();
+
+// Appends `text` to `out`, escaping every byte whose table entry lacks `safe`.
+inline void PercentEncode(std::string_view text, unsigned char safe, std::string& out) {
+    static const char digits[] = "0123456789ABCDEF";
+    const size_t n = text.size();
+    size_t i = 0;
+    while (i < n) {
+        size_t start = i;
+        while (i < n && (kEscapeTable[(unsigned char)text[i]] & safe)) i++;
+        out.append(text.data() + start, i - start);
+        if (i == n) break;
+        unsigned char b = (unsigned char)text[i++];
+        const char escaped[3] = { '%', digits[b >> 4], digits[b & 15] };
+        out.append(escaped, 3);
+    }
+}
+
+// --- UTF-8 ---
+
+// Decodes the sequence at s[0] (n >= 1 bytes available) into `cp` and
+// returns its length. An invalid sequence gives U+FFFD and the length of
+// its maximal subpart, always at least 1.
+inline size_t DecodeUtf8(const unsigned char* s, size_t n, char32_t& cp) {
+    unsigned char b = s[0];
+    if (b < 0x80) {
+        cp = b;
+        return 1;
+    }
+    size_t len;
+    if (b >= 0xC2 && b <= 0xDF) { len = 2; cp = b & 0x1F; }
+    else if (b >= 0xE0 && b <= 0xEF) { len = 3; cp = b & 0x0F; }
+    else if (b >= 0xF0 && b <= 0xF4) { len = 4; cp = b & 0x07; }
+    else {
+        cp = kReplacement;
+        return 1;
+    }
+
+    // The second byte's range rules out overlong forms, surrogates and code points past U+10FFFF
+    unsigned char lo = 0x80, hi = 0xBF;
+    if (b == 0xE0) lo = 0xA0;
+    else if (b == 0xED) hi = 0x9F;
+    else if (b == 0xF0) lo = 0x90;
+    else if (b == 0xF4) hi = 0x8F;
+
+    for (size_t k = 1; k < len; k++) {
+        if (k >= n || s[k] < lo || s[k] > hi) {
+            cp = kReplacement;
+            return k;
+        }
+        cp = (cp << 6) | (s[k] & 0x3F);
+        lo = 0x80;
+        hi = 0xBF;
+    }
+    return len;
+}
+
+// Writes `cp` (a valid scalar value) as UTF-8; returns the byte count.
+inline size_t EncodeUtf8(char32_t cp, char* out) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// --- ASCII RUNS (SSE2) ---
+
+#ifdef SCARLET_TEXT_SSE2
+// Index of the lowest set bit of a non-zero 16-bit mask.
+inline size_t LowestBit(unsigned mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t)__builtin_ctz(mask);
+#else
+    size_t bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+#endif
+
+// Widens the leading ASCII bytes of `s` into `out`, 16 at a time; returns
+// how many were done. The block with the first non-ASCII byte is stored
+// whole (the caller overwrites the tail), so `out` needs room for 16
+// units past the returned count.
+template <typename Char>
+inline size_t WidenAscii(const unsigned char* s, size_t n, Char* out) {
+    static_assert(sizeof(Char) == 2 || sizeof(Char) == 4, "UTF-16 or UTF-32 code units");
+    size_t i = 0;
+#ifdef SCARLET_TEXT_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        if (sizeof(Char) == 2) {
+            _mm_storeu_si128((__m128i*)(out + i), lo);
+            _mm_storeu_si128((__m128i*)(out + i + 8), hi);
+        } else {
+            _mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128((__m128i*)(out + i + 4), _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128((__m128i*)(out + i + 8), _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128((__m128i*)(out + i + 12), _mm_unpackhi_epi16(hi, zero));
+        }
+        unsigned nonAscii = (unsigned)_mm_movemask_epi8(bytes);
+        if (nonAscii) return i + LowestBit(nonAscii);
+    }
+#else
+    (void)s;
+    (void)n;
+    (void)out;
+#endif
+    return i;
+}
+
+// The reverse: narrows the leading code units below 0x80, with the same
+// 16 bytes of slack in `out`.
+template <typename Char>
+inline size_t NarrowAscii(const Char* s, size_t n, char* out) {
+    static_assert(sizeof(Char) == 2 || sizeof(Char) == 4, "UTF-16 or UTF-32 code units");
+    size_t i = 0;
+#ifdef SCARLET_TEXT_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i packed, ascii;  // ascii: 0xFF per byte whose unit is below 0x80
+        if (sizeof(Char) == 2) {
+            const __m128i high = _mm_set1_epi16((short)0xFF80);
+            __m128i a = _mm_loadu_si128((const __m128i*)(s + i));
+            __m128i b = _mm_loadu_si128((const __m128i*)(s + i + 8));
+            ascii = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_and_si128(a, high), zero),
+                                    _mm_cmpeq_epi16(_mm_and_si128(b, high), zero));
+            packed = _mm_packus_epi16(a, b);
+        } else {
+            const __m128i high = _mm_set1_epi32((int)0xFFFFFF80);
+            __m128i a = _mm_loadu_si128((const __m128i*)(s + i));
+            __m128i b = _mm_loadu_si128((const __m128i*)(s + i + 4));
+            __m128i c = _mm_loadu_si128((const __m128i*)(s + i + 8));
+            __m128i d = _mm_loadu_si128((const __m128i*)(s + i + 12));
+            ascii = _mm_packs_epi16(
+                _mm_packs_epi32(_mm_cmpeq_epi32(_mm_and_si128(a, high), zero), _mm_cmpeq_epi32(_mm_and_si128(b, high), zero)),
+                _mm_packs_epi32(_mm_cmpeq_epi32(_mm_and_si128(c, high), zero), _mm_cmpeq_epi32(_mm_and_si128(d, high), zero)));
+            packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        }
+        _mm_storeu_si128((__m128i*)(out + i), packed);
+        unsigned nonAscii = ~(unsigned)_mm_movemask_epi8(ascii) & 0xFFFF;
+        if (nonAscii) return i + LowestBit(nonAscii);
+    }
+#else
+    (void)s;
+    (void)n;
+    (void)out;
+#endif
+    return i;
+}
+
+// --- CONVERSIONS ---
+// kVectorized = false is the plain scalar loop, kept for the benchmarks
+// and as the reference the SSE2 path is checked against.
+
+template <typename Char, bool kVectorized = true>
+std::basic_string<Char> FromUtf8(std::string_view utf8) {
+    static_assert(sizeof(Char) == 2 || sizeof(Char) == 4, "UTF-16 or UTF-32 code units");
+    const unsigned char* s = (const unsigned char*)utf8.data();
+    const size_t n = utf8.size();
+
+    // Never more code units than bytes: a 4-byte sequence is at most a surrogate pair
+    std::basic_string<Char> out(n, Char());
+    Char* p = &out[0];
+    size_t i = 0, o = 0;
+    while (i < n) {
+        if (kVectorized) {
+            size_t done = WidenAscii(s + i, n - i, p + o);
+            i += done;
+            o += done;
+            if (i == n) break;
+        }
+        if (s[i] < 0x80) {
+            p[o++] = (Char)s[i++];
+            continue;
+        }
+        // Non-ASCII text tends to come in runs; stay scalar until the next ASCII byte
+        do {
+            char32_t cp;
+            i += DecodeUtf8(s + i, n - i, cp);
+            if (sizeof(Char) == 2 && cp >= 0x10000) {
+                cp -= 0x10000;
+                p[o++] = (Char)(0xD800 + (cp >> 10));
+                p[o++] = (Char)(0xDC00 + (cp & 0x3FF));
+            } else {
+                p[o++] = (Char)cp;
+            }
+        } while (i < n && s[i] >= 0x80);
+    }
+    out.resize(o);
+    return out;
+}
+
+template <typename Char, bool kVectorized = true>
+std::string ToUtf8(std::basic_string_view<Char> text) {
+    static_assert(sizeof(Char) == 2 || sizeof(Char) == 4, "UTF-16 or UTF-32 code units");
+    const Char* s = text.data();
+    const size_t n = text.size();
+
+    // 3 bytes per UTF-16 unit (a pair is 4 bytes for 2 units), 4 per UTF-32 unit
+    std::string out(n * (sizeof(Char) == 2 ? 3 : 4), '\0');
+    char* p = &out[0];
+    size_t i = 0, o = 0;
+    while (i < n) {
+        if (kVectorized) {
+            size_t done = NarrowAscii(s + i, n - i, p + o);
+            i += done;
+            o += done;
+            if (i == n) break;
+        }
+        do {
+            char32_t cp = (char32_t)s[i++];  // a negative wchar_t wraps past U+10FFFF
+            if (sizeof(Char) == 4) {
+                if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) cp = kReplacement;
+            } else if (cp >= 0xD800 && cp <= 0xDFFF) {
+                char32_t low = i < n ? (char32_t)s[i] : 0;
+                if (cp <= 0xDBFF && low >= 0xDC00 && low <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    i++;
+                } else {
+                    cp = kReplacement;
+                }
+            }
+            o += EncodeUtf8(cp, p + o);
+        } while (i < n && (char32_t)s[i] >= 0x80);
+    }
+    out.resize(o);
+    return out;
+}
+
+} // namespace text_codec
+
+// Wide strings are UTF-16 on Windows and UTF-32 elsewhere.
+inline std::wstring Utf8ToWide(std::string_view utf8) {
+    return text_codec::FromUtf8<wchar_t>(utf8);
+}
+
+inline std::string WideToUtf8(std::wstring_view text) {
+    return text_codec::ToUtf8<wchar_t>(text);
+}
+
+inline std::u16string Utf8ToUtf16(std::string_view utf8) {
+    return text_codec::FromUtf8<char16_t>(utf8);
+}
+
+inline std::string Utf16ToUtf8(std::u16string_view text) {
+    return text_codec::ToUtf8<char16_t>(text);
+}
+
+// Escapes a query value (its UTF-8 bytes); only RFC 3986 unreserved
+// characters are left as is.
+inline std::string UrlEncode(std::string_view utf8) {
+    std::string encoded;
+    encoded.reserve(utf8.size() + utf8.size() / 2);
+    text_codec::PercentEncode(utf8, text_codec::kQuerySafe, encoded);
+    return encoded;
+}
+
+inline std::wstring UrlEncode(const std::wstring& str) {
+    return Utf8ToWide(UrlEncode(WideToUtf8(str)));
+}
+
+// Appends `path` to `url` as UTF-8; spaces and bytes outside the printable ASCII range go escaped.
+inline void EncodeUrlPath(std::wstring_view path, std::string& url) {
+    text_codec::PercentEncode(WideToUtf8(path), text_codec::kPathSafe, url);
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+// OpenSSL client context for the POSIX transport (-DSCARLET_OPENSSL).
+//
+// One SSL_CTX per process: peer certificates are checked against the
+// system trust store (SSL_CERT_FILE / SSL_CERT_DIR override it) and the
+// host name, TLS 1.2 is the floor.
+//
+// Session tickets the server hands out are kept per host:port and offered
+// on the next connection, so only the first connection to a host pays a
+// full handshake. They are also written to "tls_sessions.cache" (mode 0600)
+// so the next launch resumes as well. Each ticket is used once: TLS 1.3
+// servers may refuse a reused ticket, and always refuse early data on one.
+// A ticket the server no longer accepts just costs a full handshake.
+//
+// Resumed TLS 1.3 sessions whose ticket allows it can carry the request in
+// the first flight (early data, 0-RTT). Early data can be replayed by an
+// attacker, so the transport only uses it for GET/HEAD without a body.
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include "paths.h"
+
+class TlsContext {
+public:
+    // --- CONFIG ---
+    static const size_t kTicketsPerHost = 4;
+    static const size_t kMaxHosts = 32;                // hosts kept in the ticket file
+    static const size_t kMaxTicketBytes = 16 * 1024;   // a serialized session is usually < 2 KB
+
+    explicit TlsContext(const std::string& ticketPath) : ticketPath_(ticketPath) {
+        ctx_ = SSL_CTX_new(TLS_client_method());
+        if (!ctx_) return;
+        SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+        SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER, NULL);
+        SSL_CTX_set_default_verify_paths(ctx_);
+        SSL_CTX_set_mode(ctx_, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+        // The internal cache is server-side only; tickets go through OnNewSession()
+        SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx_, &TlsContext::OnNewSession);
+        SSL_CTX_set_app_data(ctx_, this);
+
+        keyIndex_ = SSL_get_ex_new_index(0, NULL, NULL, NULL, &TlsContext::FreeKey);
+        bio_ = NewSocketMethod();
+        Load();
+    }
+
+    ~TlsContext() {
+        Save();
+        for (auto& entry : tickets_) {
+            for (SSL_SESSION* session : entry.second) SSL_SESSION_free(session);
+        }
+        if (ctx_) SSL_CTX_free(ctx_);
+        if (bio_) BIO_meth_free(bio_);
+    }
+
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    bool Ok() const { return ctx_ && bio_ && keyIndex_ >= 0; }
+
+    // A client SSL over the connected socket `fd`, set up for `host` and
+    // offering the newest unused ticket for `key` (host:port). NULL on
+    // failure.
+    SSL* Open(int fd, const std::string& host, const std::string& key) {
+        if (!Ok()) return NULL;
+        SSL* ssl = SSL_new(ctx_);
+        if (!ssl) return NULL;
+
+        BIO* bio = BIO_new(bio_);
+        if (!bio) {
+            SSL_free(ssl);
+            return NULL;
+        }
+        BIO_set_fd(bio, fd, BIO_NOCLOSE);
+        SSL_set_bio(ssl, bio, bio);
+        SSL_set_ex_data(ssl, keyIndex_, new std::string(key));
+
+        // SNI only for names; certificates for IP literals are matched by address
+        unsigned char addr[16];
+        bool literal = inet_pton(AF_INET, host.c_str(), addr) == 1 || inet_pton(AF_INET6, host.c_str(), addr) == 1;
+        if (!literal) SSL_set_tlsext_host_name(ssl, host.c_str());
+        if (!SSL_set1_host(ssl, host.c_str())) {
+            SSL_free(ssl);
+            return NULL;
+        }
+
+        if (SSL_SESSION* session = TakeTicket(key)) {
+            SSL_set_session(ssl, session);
+            SSL_SESSION_free(session);
+        }
+        SSL_set_connect_state(ssl);
+        return ssl;
+    }
+
+    // Writes the ticket file if tickets changed since the last save.
+    void Save() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!dirty_ || ticketPath_.empty()) return;
+        dirty_ = false;
+
+        // one ticket per line: host:port \t DER as hex
+        std::string body;
+        static const char* digits = "0123456789abcdef";
+        for (const auto& entry : tickets_) {
+            for (SSL_SESSION* session : entry.second) {
+                int size = i2d_SSL_SESSION(session, NULL);
+                if (size <= 0 || (size_t)size > kMaxTicketBytes) continue;
+                std::vector<unsigned char> der((size_t)size);
+                unsigned char* out = der.data();
+                i2d_SSL_SESSION(session, &out);
+
+                body += entry.first;
+                body += '\t';
+                for (unsigned char c : der) {
+                    body += digits[c >> 4];
+                    body += digits[c & 15];
+                }
+                body += '\n';
+            }
+        }
+
+        if (body.empty()) {
+            std::remove(ticketPath_.c_str());
+            return;
+        }
+        // The tickets resume sessions: keep the file private to the user
+        std::string tmp = ticketPath_ + ".tmp";
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0) return;
+        bool written = write(fd, body.data(), body.size()) == (ssize_t)body.size();
+        close(fd);
+        if (!written || std::rename(tmp.c_str(), ticketPath_.c_str()) != 0) std::remove(tmp.c_str());
+    }
+
+private:
+    // --- TICKETS ---
+
+    static bool Expired(SSL_SESSION* session) {
+        return (long long)SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) <= (long long)time(NULL);
+    }
+
+    SSL_SESSION* TakeTicket(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = tickets_.find(key);
+        if (it == tickets_.end()) return NULL;
+        while (!it->second.empty()) {
+            SSL_SESSION* session = it->second.back();
+            it->second.pop_back();
+            dirty_ = true;
+            if (!Expired(session) && SSL_SESSION_is_resumable(session)) return session;
+            SSL_SESSION_free(session);
+        }
+        return NULL;
+    }
+
+    // Takes ownership of `session`.
+    void StoreTicketLocked(const std::string& key, SSL_SESSION* session) {
+        if (tickets_.size() >= kMaxHosts && tickets_.find(key) == tickets_.end()) {
+            SSL_SESSION_free(session);
+            return;
+        }
+        std::deque<SSL_SESSION*>& list = tickets_[key];
+        if (list.size() >= kTicketsPerHost) {
+            SSL_SESSION_free(list.front());
+            list.pop_front();
+        }
+        list.push_back(session);
+        dirty_ = true;
+    }
+
+    static int OnNewSession(SSL* ssl, SSL_SESSION* session) {
+        TlsContext* self = (TlsContext*)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+        const std::string* key = (const std::string*)SSL_get_ex_data(ssl, self->keyIndex_);
+        if (!key || !SSL_SESSION_is_resumable(session)) return 0;
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        self->StoreTicketLocked(*key, session);
+        return 1;  // we keep the reference
+    }
+
+    static void FreeKey(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*) {
+        delete (std::string*)ptr;
+    }
+
+    void Load() {
+        if (ticketPath_.empty()) return;
+        std::ifstream in(ticketPath_);
+        std::string line;
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (std::getline(in, line)) {
+            size_t tab = line.find('\t');
+            if (tab == std::string::npos || tab == 0) continue;
+            std::string hex = line.substr(tab + 1);
+            if (hex.empty() || hex.size() % 2 || hex.size() / 2 > kMaxTicketBytes) continue;
+
+            std::vector<unsigned char> der(hex.size() / 2);
+            bool valid = true;
+            for (size_t i = 0; i < der.size() && valid; i++) {
+                int hi = HexValue(hex[2 * i]), lo = HexValue(hex[2 * i + 1]);
+                valid = hi >= 0 && lo >= 0;
+                der[i] = (unsigned char)(hi << 4 | lo);
+            }
+            if (!valid) continue;
+
+            const unsigned char* p = der.data();
+            SSL_SESSION* session = d2i_SSL_SESSION(NULL, &p, (long)der.size());
+            if (!session) continue;
+            if (Expired(session) || !SSL_SESSION_is_resumable(session)) {
+                SSL_SESSION_free(session);
+                continue;
+            }
+            StoreTicketLocked(line.substr(0, tab), session);
+        }
+        dirty_ = false;
+        ERR_clear_error();
+    }
+
+    static int HexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // --- SOCKET BIO ---
+    // OpenSSL's socket BIO writes with write(2), which raises SIGPIPE on a
+    // socket the server closed. This one is the same BIO writing with
+    // send(MSG_NOSIGNAL), like the plain-HTTP path.
+
+    static int SocketWrite(BIO* bio, const char* data, int len) {
+        int fd = -1;
+        BIO_get_fd(bio, &fd);
+        errno = 0;
+        ssize_t n = send(fd, data, (size_t)len, MSG_NOSIGNAL);
+        BIO_clear_retry_flags(bio);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) BIO_set_retry_write(bio);
+        return (int)n;
+    }
+
+    static int SocketPuts(BIO* bio, const char* str) {
+        return SocketWrite(bio, str, (int)strlen(str));
+    }
+
+    static BIO_METHOD* NewSocketMethod() {
+        const BIO_METHOD* base = BIO_s_socket();
+        BIO_METHOD* method = BIO_meth_new(BIO_TYPE_SOCKET, "socket (MSG_NOSIGNAL)");
+        if (!method) return NULL;
+        BIO_meth_set_write(method, &TlsContext::SocketWrite);
+        BIO_meth_set_puts(method, &TlsContext::SocketPuts);
+        BIO_meth_set_read(method, BIO_meth_get_read(base));
+        BIO_meth_set_ctrl(method, BIO_meth_get_ctrl(base));
+        BIO_meth_set_create(method, BIO_meth_get_create(base));
+        BIO_meth_set_destroy(method, BIO_meth_get_destroy(base));
+        return method;
+    }
+
+    std::string ticketPath_;
+    SSL_CTX* ctx_ = NULL;
+    BIO_METHOD* bio_ = NULL;
+    int keyIndex_ = -1;
+
+    std::mutex mutex_;
+    std::map<std::string, std::deque<SSL_SESSION*>> tickets_;  // oldest first
+    bool dirty_ = false;
+};
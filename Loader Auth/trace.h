@@ -0,0 +1,242 @@
+#pragma once
+
+// Request and step timing.
+//
+// Off by default; set SCARLET_TRACE=<file> (and call
+// trace::StartFromEnvironment()) to turn it on. When on, every HTTP
+// request records its phases (DNS, connect, time to first byte,
+// transfer) and every traced step (trace::Scope) its duration. Durations
+// are aggregated into per-name histograms, and trace::Finish() writes all
+// events as Chrome trace JSON (chrome://tracing, Perfetto) and prints a
+// summary. When off, a Scope or a phase costs one relaxed atomic load.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+namespace trace {
+
+typedef std::chrono::steady_clock Clock;
+
+inline std::atomic<bool> g_enabled{ false };
+
+inline bool Enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+// Durations in microseconds, log-linear buckets: each power of two is split
+// into kSubBuckets, so a percentile (reported as its bucket's upper bound)
+// is within 25% of the true value.
+struct Histogram {
+    static const int kSubBuckets = 4;
+    static const int kBuckets = 42 * kSubBuckets;
+
+    uint64_t buckets[kBuckets] = { 0 };
+    uint64_t count = 0;
+    uint64_t totalUs = 0;
+    uint64_t maxUs = 0;
+
+    static int BucketFor(uint64_t us) {
+        int shift = 0;
+        while ((us >> shift) >= 2 * kSubBuckets) shift++;
+        int bucket = shift * kSubBuckets + (int)(us >> shift);
+        return bucket < kBuckets ? bucket : kBuckets - 1;
+    }
+
+    static uint64_t UpperBound(int bucket) {
+        if (bucket < 2 * kSubBuckets) return (uint64_t)bucket + 1;
+        int shift = bucket / kSubBuckets - 1;
+        return (uint64_t)(bucket - shift * kSubBuckets + 1) << shift;
+    }
+
+    void Add(uint64_t us) {
+        buckets[BucketFor(us)]++;
+        count++;
+        totalUs += us;
+        if (us > maxUs) maxUs = us;
+    }
+
+    uint64_t PercentileUs(double p) const {
+        if (count == 0) return 0;
+        uint64_t rank = (uint64_t)(p / 100.0 * count + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            seen += buckets[i];
+            if (seen >= rank) return std::min(UpperBound(i), maxUs);
+        }
+        return maxUs;
+    }
+};
+
+struct Event {
+    std::string name;
+    const char* category;
+    uint32_t thread;
+    uint64_t startUs;
+    uint64_t durationUs;
+};
+
+class Tracer {
+public:
+    static const size_t kMaxEvents = 1000000;  // histograms keep counting past this
+
+    static Tracer& Instance() {
+        static Tracer instance;
+        return instance;
+    }
+
+    void Start(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        path_ = path;
+        epoch_ = Clock::now();
+        g_enabled.store(true, std::memory_order_relaxed);
+    }
+
+    void Record(const std::string& name, const char* category, Clock::time_point start, Clock::time_point end) {
+        uint64_t startUs = start > epoch_ ? (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(start - epoch_).count() : 0;
+        uint64_t durationUs = end > start ? (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() : 0;
+        uint32_t thread = ThreadId();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        histograms_[name].Add(durationUs);
+        if (events_.size() < kMaxEvents) events_.push_back({ name, category, thread, startUs, durationUs });
+    }
+
+    std::map<std::string, Histogram> Histograms() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return histograms_;
+    }
+
+    // Writes the Chrome trace file and prints the histogram summary.
+    void Finish(std::ostream& out) {
+        if (!Enabled()) return;
+        g_enabled.store(false, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!path_.empty()) WriteChromeTrace();
+
+        out << "\n[*] Timing (" << events_.size() << " events" << (path_.empty() ? "" : ", trace: " + path_) << ")\n";
+        out << "    " << std::left << std::setw(32) << "name" << std::right << std::setw(8) << "count"
+            << std::setw(11) << "p50 ms" << std::setw(11) << "p95 ms" << std::setw(11) << "max ms" << "\n";
+        for (const auto& entry : histograms_) {
+            const Histogram& h = entry.second;
+            out << "    " << std::left << std::setw(32) << entry.first << std::right << std::setw(8) << h.count
+                << std::fixed << std::setprecision(2)
+                << std::setw(11) << h.PercentileUs(50) / 1000.0
+                << std::setw(11) << h.PercentileUs(95) / 1000.0
+                << std::setw(11) << h.maxUs / 1000.0 << "\n";
+        }
+        out.flush();
+    }
+
+private:
+    Tracer() : epoch_(Clock::now()) {}
+
+    static uint32_t ThreadId() {
+        static std::atomic<uint32_t> next{ 1 };
+        thread_local uint32_t id = next++;
+        return id;
+    }
+
+    static void WriteEscaped(FILE* f, const std::string& s) {
+        for (unsigned char c : s) {
+            if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+            else if (c < 0x20) fprintf(f, "\\u%04x", c);
+            else fputc(c, f);
+        }
+    }
+
+    void WriteChromeTrace() {
+        FILE* f = fopen(path_.c_str(), "w");
+        if (!f) return;
+        fputs("{\"traceEvents\":[\n", f);
+        for (size_t i = 0; i < events_.size(); i++) {
+            const Event& e = events_[i];
+            fputs("{\"name\":\"", f);
+            WriteEscaped(f, e.name);
+            fprintf(f, "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu}%s\n",
+                e.category, e.thread, (unsigned long long)e.startUs, (unsigned long long)e.durationUs,
+                i + 1 < events_.size() ? "," : "");
+        }
+        fputs("],\"displayTimeUnit\":\"ms\"}\n", f);
+        fclose(f);
+    }
+
+    std::mutex mutex_;
+    std::string path_;
+    Clock::time_point epoch_;
+    std::vector<Event> events_;
+    std::map<std::string, Histogram> histograms_;
+};
+
+// Turns tracing on when SCARLET_TRACE is set; its value is the trace file.
+inline void StartFromEnvironment() {
+    const char* path = getenv("SCARLET_TRACE");
+    if (path && *path) Tracer::Instance().Start(path);
+}
+
+inline void Finish(std::ostream& out) {
+    Tracer::Instance().Finish(out);
+}
+
+inline Clock::time_point Now() {
+    return Enabled() ? Clock::now() : Clock::time_point();
+}
+
+// Records [start, end] under `name` when tracing is on and both ends were
+// taken (Now() returns a zero time point while tracing is off).
+inline void Record(const std::string& name, const char* category, Clock::time_point start, Clock::time_point end) {
+    if (!Enabled() || start == Clock::time_point() || end == Clock::time_point()) return;
+    Tracer::Instance().Record(name, category, start, end);
+}
+
+// Times the enclosing block as a named step.
+class Scope {
+public:
+    explicit Scope(const char* name, const char* category = "step") : name_(name), category_(category), start_(Now()) {}
+    ~Scope() { if (start_ != Clock::time_point()) Record(name_, category_, start_, Clock::now()); }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name_;
+    const char* category_;
+    Clock::time_point start_;
+};
+
+// Phase timestamps of one HTTP request, filled in by the transport. Any
+// phase that did not happen (DNS cache hit, reused connection) stays zero.
+struct RequestTiming {
+    Clock::time_point start;
+    Clock::time_point dnsStart, dnsEnd;
+    Clock::time_point connectStart, connectEnd;
+    Clock::time_point tlsStart, tlsEnd;   // TLS handshake, POSIX transport only
+    Clock::time_point sent;          // request fully written
+    Clock::time_point firstByte;     // status line and headers received
+    Clock::time_point end;           // body complete
+
+    // Emits "http <phase>" events and a "<method> <path>" span covering
+    // the whole request. The query string is dropped (it can carry secrets).
+    void Commit(const std::string& method, const std::string& target) {
+        if (!Enabled() || start == Clock::time_point()) return;
+        if (end == Clock::time_point()) end = Clock::now();
+
+        std::string path = target.substr(0, target.find('?'));
+        Record(method + " " + path, "http", start, end);
+        Record("http dns", "http", dnsStart, dnsEnd);
+        Record("http connect", "http", connectStart, connectEnd);
+        Record("http tls", "http", tlsStart, tlsEnd);
+        Record("http ttfb", "http", sent, firstByte);
+        Record("http transfer", "http", firstByte, end);
+    }
+};
+
+} // namespace trace
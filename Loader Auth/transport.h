@@ -0,0 +1,198 @@
+#pragma once
+
+// Transport interface for the loader's HTTP traffic.
+//
+// Auth, download and fetcher code talk to a Transport and never to a
+// platform API, so the same logic runs on the WinINet backend
+// (transport_wininet.h) and on the epoll backend used on Linux
+// (transport_posix.h). HttpClient (http_client.h) picks the backend.
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <cctype>
+
+struct HttpHeader {
+    std::string name;
+    std::string value;
+};
+
+// Receives the response body as it arrives. Returning false aborts the
+// transfer (the response is then not `complete`).
+typedef std::function<bool(const char* data, size_t size)> BodySink;
+
+struct HttpResponse;
+
+// Called once the status and headers are known, before any body byte.
+// Returning false skips the body (the response is then not `complete`).
+typedef std::function<bool(const HttpResponse& response)> HeadersCallback;
+
+struct HttpRequest {
+    std::string method = "GET";
+    std::string url;
+    std::string_view body;            // must outlive Send()
+    std::vector<HttpHeader> headers;
+    BodySink sink;                    // when set, the body is streamed here instead of collected
+    HeadersCallback onHeaders;        // optional
+
+    // The request fails with a "timed out" error once this passes (default:
+    // no overall limit, only the transport's per-wait timeouts).
+    std::chrono::steady_clock::time_point deadline;
+    // Polled while waiting on the network; setting it abandons the request.
+    const std::atomic<bool>* cancel = nullptr;
+};
+
+struct HttpResponse {
+    unsigned long status = 0;         // 0 when the request never reached the server
+    std::string body;                 // empty when a sink was given
+    std::vector<HttpHeader> headers;
+    bool complete = false;            // the whole body was received
+    std::string error;                // transport-level failure, if any
+    bool requestSent = false;         // false: the server never saw the request, replaying it is safe
+    bool timedOut = false;            // the request's deadline passed
+
+    bool ok() const { return status >= 200 && status < 300; }
+
+    // Case-insensitive header lookup; "" when absent.
+    std::string Header(std::string_view name) const {
+        for (const HttpHeader& h : headers) {
+            if (h.name.size() != name.size()) continue;
+            bool same = true;
+            for (size_t i = 0; i < name.size() && same; i++) {
+                same = tolower((unsigned char)h.name[i]) == tolower((unsigned char)name[i]);
+            }
+            if (same) return h.value;
+        }
+        return "";
+    }
+
+    unsigned long long ContentLength() const {
+        std::string value = Header("Content-Length");
+        return value.empty() ? 0 : strtoull(value.c_str(), NULL, 10);
+    }
+};
+
+struct HttpClientStats {
+    unsigned long requests = 0;
+    unsigned long failures = 0;
+    unsigned long connectionsOpened = 0;  // new TCP connections
+    unsigned long connectionsReused = 0;  // requests served on an existing keep-alive socket
+
+    // Bodies that arrived with a Content-Encoding (filled in by HttpClient)
+    unsigned long compressedResponses = 0;
+    unsigned long long encodedBytes = 0;  // bytes on the wire
+    unsigned long long decodedBytes = 0;  // bytes after decoding
+    double decodeSeconds = 0;             // decoder time, summed over threads
+
+    // https connections. WinINet (SChannel) resumes sessions on its own and
+    // does not say when, so there only tlsHandshakes is counted.
+    unsigned long tlsHandshakes = 0;      // full and resumed
+    unsigned long tlsResumed = 0;         // handshakes that resumed a cached session
+    unsigned long earlyDataSent = 0;      // requests sent as TLS 1.3 early data
+    unsigned long earlyDataAccepted = 0;  // ...and not rejected by the server
+
+    double ResumptionRate() const { return tlsHandshakes ? (double)tlsResumed / tlsHandshakes : 0; }
+    double CompressionRatio() const { return encodedBytes ? (double)decodedBytes / encodedBytes : 0; }
+    double DecodeMegabytesPerSecond() const {
+        return decodeSeconds > 0 ? (decodedBytes / (1024.0 * 1024.0)) / decodeSeconds : 0;
+    }
+};
+
+class Transport {
+public:
+    virtual ~Transport() {}
+
+    virtual HttpResponse Send(const HttpRequest& request) = 0;
+    virtual HttpClientStats Stats() = 0;
+
+    // Closes every pooled connection. Safe to call more than once.
+    virtual void Shutdown() = 0;
+};
+
+namespace transport {
+
+// Read sizes for streamed bodies: doubled while reads come back full,
+// halved when they come back short.
+const size_t kMinReadSize = 64 * 1024;
+const size_t kMaxReadSize = 1024 * 1024;
+
+inline size_t NextReadSize(size_t current, size_t lastRead) {
+    if (lastRead == current && current < kMaxReadSize) return current * 2;
+    if (lastRead < current / 4 && current > kMinReadSize) return current / 2;
+    return current;
+}
+
+struct Url {
+    bool https = false;
+    std::string host;
+    unsigned short port = 0;
+    std::string target;  // path and query, always starting with '/'
+};
+
+// Splits "http[s]://host[:port][/path][?query]". Returns false for other
+// schemes or a missing host.
+inline bool ParseUrl(std::string_view url, Url& out) {
+    size_t pos;
+    if (url.compare(0, 7, "http://") == 0) {
+        out.https = false;
+        pos = 7;
+    } else if (url.compare(0, 8, "https://") == 0) {
+        out.https = true;
+        pos = 8;
+    } else {
+        return false;
+    }
+
+    size_t end = url.find_first_of("/?#", pos);
+    std::string_view authority = url.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+    size_t colon = authority.rfind(':');
+    if (colon != std::string_view::npos && authority.find(']') == std::string_view::npos) {
+        out.host = std::string(authority.substr(0, colon));
+        out.port = (unsigned short)atoi(std::string(authority.substr(colon + 1)).c_str());
+    } else {
+        out.host = std::string(authority);
+        out.port = out.https ? 443 : 80;
+    }
+    if (out.host.empty() || out.port == 0) return false;
+
+    out.target = end == std::string_view::npos ? "/" : std::string(url.substr(end));
+    size_t hash = out.target.find('#');
+    if (hash != std::string::npos) out.target.erase(hash);
+    if (out.target.empty() || out.target[0] != '/') out.target.insert(0, "/");
+    return true;
+}
+
+inline bool Expired(const HttpRequest& request) {
+    return request.deadline != std::chrono::steady_clock::time_point() &&
+           std::chrono::steady_clock::now() >= request.deadline;
+}
+
+inline bool Cancelled(const HttpRequest& request) {
+    return request.cancel && request.cancel->load();
+}
+
+// Milliseconds left before the request's deadline, capped at `cap` (and
+// `cap` when there is no deadline). 0 once it passed.
+inline unsigned long RemainingMs(const HttpRequest& request, unsigned long cap) {
+    if (request.deadline == std::chrono::steady_clock::time_point()) return cap;
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(request.deadline - std::chrono::steady_clock::now()).count();
+    if (left <= 0) return 0;
+    return (unsigned long)left < cap ? (unsigned long)left : cap;
+}
+
+// Names a failed request's error after its deadline or cancel flag when
+// one of those is what stopped it.
+inline void Interrupted(const HttpRequest& request, HttpResponse& response) {
+    if (Expired(request)) {
+        response.timedOut = true;
+        response.error = "Request timed out";
+    } else if (Cancelled(request)) {
+        response.error = "Request cancelled";
+    }
+}
+
+} // namespace transport
@@ -0,0 +1,746 @@
+#pragma once
+
+// POSIX backend of the Transport interface: HTTP/1.1 over non-blocking
+// sockets driven by epoll.
+//
+// Connections are kept alive and pooled per host:port (bounded, evicted
+// after sitting idle), resolved addresses are cached, and a request that
+// finds its pooled socket closed by the server is retried once on a fresh
+// connection: always when the request could not be written, and only for
+// idempotent requests once it was. A request's deadline and cancel flag
+// are checked around every wait on the socket.
+//
+// https needs a build with OpenSSL (-DSCARLET_OPENSSL, tls_openssl.h);
+// without it https URLs are refused. TLS sessions are resumed from cached
+// tickets across connections and launches, and a resumed connection sends
+// an idempotent request (GET/HEAD, no body) as TLS 1.3 early data when the
+// ticket allows it. Early data the server rejects is sent again once the
+// handshake completes.
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include "transport.h"
+#include "trace.h"
+#ifdef SCARLET_OPENSSL
+#include <memory>
+#include "tls_openssl.h"
+#endif
+
+class PosixTransport : public Transport {
+public:
+    // --- CONFIG ---
+    static const size_t kMaxIdleConnections = 8;
+    static const int kIdleTimeoutMs = 30000;
+    static const int kIoTimeoutMs = 30000;            // per wait on the socket
+    static const int kCancelPollMs = 50;              // how soon a cancelled request notices
+    static const int kDnsTtlMs = 60000;
+    static const size_t kMaxHeaderBytes = 64 * 1024;
+    static const size_t kMaxReserve = 16 * 1024 * 1024;  // cap on Content-Length preallocation
+    static const size_t kInlineBodyLimit = 64 * 1024;     // bodies up to this go out with the headers
+
+    PosixTransport() {}
+    ~PosixTransport() { Shutdown(); }
+    PosixTransport(const PosixTransport&) = delete;
+    PosixTransport& operator=(const PosixTransport&) = delete;
+
+    HttpResponse Send(const HttpRequest& request) override {
+        HttpResponse response;
+
+        transport::Url url;
+        if (!transport::ParseUrl(request.url, url)) {
+            response.error = "Invalid URL";
+            CountRequest(false, false);
+            return response;
+        }
+#ifdef SCARLET_OPENSSL
+        if (url.https && !Tls()) {
+            response.error = "Failed to set up TLS";
+            CountRequest(false, false);
+            return response;
+        }
+#else
+        if (url.https) {
+            response.error = "HTTPS needs a build with OpenSSL (-DSCARLET_OPENSSL)";
+            CountRequest(false, false);
+            return response;
+        }
+#endif
+
+        trace::RequestTiming timing;
+        timing.start = trace::Now();
+
+        for (int attempt = 0; attempt < 2; attempt++) {
+            Connection conn;
+            conn.request = &request;
+            bool reused = false;
+            if (!Acquire(url, conn, reused, timing)) {
+                response.error = "Failed to connect";
+                transport::Interrupted(request, response);
+                CountRequest(false, false);
+                timing.Commit(request.method, url.target);
+                return response;
+            }
+
+            bool keepAlive = false;
+            Outcome outcome = Exchange(conn, url, request, response, keepAlive, timing);
+
+            // A pooled socket the server already closed fails before the
+            // first response byte. Exchange() only reports that as stale
+            // when replaying is safe: the request never got out, or it is
+            // idempotent. Anything else is left to the caller's policy.
+            if (outcome == kStale && reused && attempt == 0 && !transport::Expired(request) && !transport::Cancelled(request)) {
+                Close(conn);
+                response = HttpResponse();
+                continue;
+            }
+
+            if (outcome == kDone && keepAlive) Release(conn);
+            else Close(conn);
+
+            if (outcome != kDone && response.error.empty()) response.error = "Connection failed";
+            if (outcome != kDone) transport::Interrupted(request, response);
+            CountRequest(response.complete, !reused);
+            timing.Commit(request.method, url.target);
+            return response;
+        }
+        return response;
+    }
+
+    HttpClientStats Stats() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    void Shutdown() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Connection& conn : idle_) Close(conn);
+        idle_.clear();
+        dns_.clear();
+#ifdef SCARLET_OPENSSL
+        if (tls_) tls_->Save();
+#endif
+    }
+
+private:
+    struct Connection {
+        int fd = -1;
+        int epfd = -1;
+        std::string key;
+        std::chrono::steady_clock::time_point lastUsed;
+        const HttpRequest* request = nullptr;  // request in flight, for its deadline and cancel flag
+#ifdef SCARLET_OPENSSL
+        SSL* ssl = nullptr;
+        bool handshakeDone = false;
+#endif
+    };
+
+    struct Address {
+        sockaddr_storage addr;
+        socklen_t len;
+        int family;
+    };
+
+    struct Resolved {
+        std::vector<Address> addresses;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    enum Outcome { kDone, kStale, kFailed };
+
+    // Buffered reader over a non-blocking socket.
+    class Reader {
+    public:
+        explicit Reader(const Connection& conn) : conn_(conn) {}
+
+        const char* Data() const { return data_.data() + begin_; }
+        size_t Available() const { return end_ - begin_; }
+        void Consume(size_t n) { begin_ += n; }
+        bool Eof() const { return eof_; }
+        size_t Received() const { return received_; }
+
+        // Reads at least one more byte (up to `want`). False on EOF,
+        // error or timeout.
+        bool Fill(size_t want) {
+            if (begin_ == end_) begin_ = end_ = 0;
+            if (data_.size() - end_ < want) {
+                if (begin_ > 0) {
+                    memmove(&data_[0], &data_[begin_], end_ - begin_);
+                    end_ -= begin_;
+                    begin_ = 0;
+                }
+                if (data_.size() - end_ < want) data_.resize(end_ + want);
+            }
+
+#ifdef SCARLET_OPENSSL
+            if (conn_.ssl) return FillTls(want);
+#endif
+            for (;;) {
+                ssize_t n = recv(conn_.fd, &data_[end_], want, 0);
+                if (n > 0) {
+                    end_ += (size_t)n;
+                    received_ += (size_t)n;
+                    return true;
+                }
+                if (n == 0) {
+                    eof_ = true;
+                    return false;
+                }
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+                if (!WaitFor(conn_, EPOLLIN)) return false;
+            }
+        }
+
+        bool ReadLine(std::string& line) {
+            size_t scanned = 0;
+            for (;;) {
+                const char* start = Data();
+                size_t avail = Available();
+                for (size_t i = scanned ? scanned - 1 : 0; i + 1 < avail; i++) {
+                    if (start[i] == '\r' && start[i + 1] == '\n') {
+                        line.assign(start, i);
+                        Consume(i + 2);
+                        return true;
+                    }
+                }
+                scanned = avail;
+                if (avail > kMaxHeaderBytes || !Fill(4096)) return false;
+            }
+        }
+
+    private:
+#ifdef SCARLET_OPENSSL
+        bool FillTls(size_t want) {
+            for (;;) {
+                ERR_clear_error();
+                int n = SSL_read(conn_.ssl, &data_[end_], (int)std::min<size_t>(want, INT_MAX));
+                if (n > 0) {
+                    end_ += (size_t)n;
+                    received_ += (size_t)n;
+                    return true;
+                }
+                int error = SSL_get_error(conn_.ssl, n);
+                if (error == SSL_ERROR_ZERO_RETURN) {
+                    eof_ = true;  // close_notify; a bare TCP close is a truncation
+                    return false;
+                }
+                if (error == SSL_ERROR_SYSCALL && errno == EINTR) continue;
+                if (!WaitForTls(conn_, error)) return false;
+            }
+        }
+#endif
+
+        const Connection& conn_;
+        std::vector<char> data_;
+        size_t begin_ = 0;
+        size_t end_ = 0;
+        size_t received_ = 0;
+        bool eof_ = false;
+    };
+
+    // Waits up to kIoTimeoutMs, cut short by the request's deadline or
+    // cancel flag. False on timeout.
+    static bool WaitFor(const Connection& conn, uint32_t events) {
+        epoll_event ev = {};
+        ev.events = events;
+        ev.data.fd = conn.fd;
+        if (epoll_ctl(conn.epfd, EPOLL_CTL_MOD, conn.fd, &ev) != 0) return false;
+
+        auto waitEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(kIoTimeoutMs);
+        for (;;) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(waitEnd - std::chrono::steady_clock::now()).count();
+            if (left <= 0) return false;
+            int timeout = (int)left;
+            if (conn.request) {
+                if (transport::Expired(*conn.request) || transport::Cancelled(*conn.request)) return false;
+                timeout = (int)transport::RemainingMs(*conn.request, (unsigned long)timeout);
+                if (conn.request->cancel) timeout = std::min(timeout, kCancelPollMs);
+            }
+
+            epoll_event out;
+            int n = epoll_wait(conn.epfd, &out, 1, timeout);
+            if (n > 0) return true;   // errors and hangups surface on the next recv/send
+            if (n < 0 && errno != EINTR) return false;
+        }
+    }
+
+
+    static bool SendAll(const Connection& conn, const char* data, size_t len) {
+#ifdef SCARLET_OPENSSL
+        if (conn.ssl) return SendAllTls(conn, data, len);
+#endif
+        while (len > 0) {
+            ssize_t n = send(conn.fd, data, len, MSG_NOSIGNAL);
+            if (n > 0) {
+                data += n;
+                len -= (size_t)n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                if (!WaitFor(conn, EPOLLOUT)) return false;
+                continue;
+            }
+            return false;
+        }
+        return true;
+    }
+
+#ifdef SCARLET_OPENSSL
+    // Waits for what OpenSSL asked for; false for any other error.
+    static bool WaitForTls(const Connection& conn, int error) {
+        if (error == SSL_ERROR_WANT_READ) return WaitFor(conn, EPOLLIN);
+        if (error == SSL_ERROR_WANT_WRITE) return WaitFor(conn, EPOLLOUT);
+        return false;
+    }
+
+    static bool SendAllTls(const Connection& conn, const char* data, size_t len) {
+        while (len > 0) {
+            ERR_clear_error();
+            int n = SSL_write(conn.ssl, data, (int)std::min<size_t>(len, INT_MAX));
+            if (n > 0) {
+                data += n;
+                len -= (size_t)n;
+                continue;
+            }
+            int error = SSL_get_error(conn.ssl, n);
+            if (error == SSL_ERROR_SYSCALL && errno == EINTR) continue;
+            if (!WaitForTls(conn, error)) return false;
+        }
+        return true;
+    }
+
+    // Runs the handshake on a new TLS connection. When `early` is given and
+    // the resumed ticket takes that many bytes of early data, they go out
+    // in the first flight; `earlySent` / `earlyAccepted` tell what became
+    // of them (rejected early data has to be sent again).
+    bool Handshake(Connection& conn, const std::string* early, bool& earlySent, bool& earlyAccepted,
+                   std::string& error) {
+        earlySent = earlyAccepted = false;
+        SSL_SESSION* session = SSL_get_session(conn.ssl);
+        if (early && session && SSL_SESSION_get_max_early_data(session) >= early->size()) {
+            size_t offset = 0;
+            while (offset < early->size()) {
+                ERR_clear_error();
+                size_t written = 0;
+                if (SSL_write_early_data(conn.ssl, early->data() + offset, early->size() - offset, &written)) {
+                    offset += written;
+                    continue;
+                }
+                int code = SSL_get_error(conn.ssl, 0);
+                if (code == SSL_ERROR_SYSCALL && errno == EINTR) continue;
+                if (!WaitForTls(conn, code)) {
+                    error = "TLS handshake failed";
+                    return false;
+                }
+            }
+            earlySent = true;
+        }
+
+        for (;;) {
+            ERR_clear_error();
+            int n = SSL_do_handshake(conn.ssl);
+            if (n == 1) break;
+            int code = SSL_get_error(conn.ssl, n);
+            if (code == SSL_ERROR_SYSCALL && errno == EINTR) continue;
+            if (!WaitForTls(conn, code)) {
+                long verify = SSL_get_verify_result(conn.ssl);
+                error = verify != X509_V_OK
+                    ? std::string("TLS certificate rejected: ") + X509_verify_cert_error_string(verify)
+                    : "TLS handshake failed";
+                return false;
+            }
+        }
+
+        conn.handshakeDone = true;
+        earlyAccepted = earlySent && SSL_get_early_data_status(conn.ssl) == SSL_EARLY_DATA_ACCEPTED;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.tlsHandshakes++;
+        if (SSL_session_reused(conn.ssl)) stats_.tlsResumed++;
+        if (earlySent) stats_.earlyDataSent++;
+        if (earlyAccepted) stats_.earlyDataAccepted++;
+        return true;
+    }
+
+    // Created on the first https request, so plain-HTTP runs never read
+    // the ticket file.
+    TlsContext* Tls() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!tls_) tls_.reset(new TlsContext(LocalDataPath("tls_sessions.cache")));
+        return tls_->Ok() ? tls_.get() : nullptr;
+    }
+#endif
+
+    // Requests that may go out twice even if the server acted on the first.
+    static bool Idempotent(const HttpRequest& request) {
+        return (request.method == "GET" || request.method == "HEAD") && request.body.empty();
+    }
+
+    static bool ContainsToken(std::string value, const char* token) {
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return (char)tolower(c); });
+        return value.find(token) != std::string::npos;
+    }
+
+    Outcome Exchange(Connection& conn, const transport::Url& url, const HttpRequest& request,
+                     HttpResponse& response, bool& keepAlive, trace::RequestTiming& timing) {
+        // --- REQUEST ---
+        std::string head;
+        head.reserve(256 + url.target.size());
+        head += request.method;
+        head += ' ';
+        head += url.target;
+        head += " HTTP/1.1\r\nHost: ";
+        head += url.host;
+        if (url.port != (url.https ? 443 : 80)) head += ":" + std::to_string(url.port);
+        head += "\r\nUser-Agent: ScarletAuthLoader/1.0\r\nConnection: keep-alive\r\n";
+        for (const HttpHeader& h : request.headers) head += h.name + ": " + h.value + "\r\n";
+        if (!request.body.empty() || request.method == "POST" || request.method == "PUT") {
+            head += "Content-Length: " + std::to_string(request.body.size()) + "\r\n";
+        }
+        head += "\r\n";
+
+        bool inlineBody = request.body.size() <= kInlineBodyLimit;
+        if (inlineBody) head.append(request.body.data(), request.body.size());
+
+        bool sendHead = true;
+#ifdef SCARLET_OPENSSL
+        if (conn.ssl && !conn.handshakeDone) {
+            // Early data can be replayed, so only idempotent reads ride on it
+            bool idempotent = Idempotent(request);
+            bool earlySent = false, earlyAccepted = false;
+            timing.tlsStart = trace::Now();
+            if (!Handshake(conn, idempotent ? &head : nullptr, earlySent, earlyAccepted, response.error)) {
+                response.requestSent = earlySent;
+                return kFailed;
+            }
+            timing.tlsEnd = trace::Now();
+            sendHead = !earlyAccepted;
+        }
+#endif
+        if (sendHead && !SendAll(conn, head.data(), head.size())) return kStale;
+        if (!inlineBody && !SendAll(conn, request.body.data(), request.body.size())) return kFailed;
+        response.requestSent = true;
+        timing.sent = trace::Now();
+
+        // --- STATUS + HEADERS ---
+        Reader reader(conn);
+        std::string line;
+        bool http10 = false;
+        do {
+            if (!reader.ReadLine(line)) return reader.Received() == 0 && Idempotent(request) ? kStale : kFailed;
+            if (line.compare(0, 5, "HTTP/") != 0) return kFailed;
+            http10 = line.compare(0, 8, "HTTP/1.0") == 0;
+            size_t space = line.find(' ');
+            response.status = space == std::string::npos ? 0 : strtoul(line.c_str() + space + 1, NULL, 10);
+            // Past a 101 the socket no longer speaks HTTP/1.1, and no Upgrade was asked for
+            if (response.status == 101) {
+                response.error = "Unexpected 101 Switching Protocols";
+                return kFailed;
+            }
+
+            response.headers.clear();
+            for (;;) {
+                if (!reader.ReadLine(line)) return kFailed;
+                if (line.empty()) break;
+                size_t colon = line.find(':');
+                if (colon == std::string::npos) continue;
+                size_t value = line.find_first_not_of(" \t", colon + 1);
+                response.headers.push_back({ line.substr(0, colon), value == std::string::npos ? "" : line.substr(value) });
+            }
+        } while (response.status >= 100 && response.status < 200);  // interim answers (100, 102-199)
+        timing.firstByte = trace::Now();
+
+        if (request.onHeaders && !request.onHeaders(response)) {
+            response.error = "Response rejected";
+            return kFailed;
+        }
+
+        std::string connection = response.Header("Connection");
+        keepAlive = http10 ? ContainsToken(connection, "keep-alive") : !ContainsToken(connection, "close");
+
+        // --- BODY ---
+        size_t readSize = transport::kMinReadSize;
+        auto deliver = [&](const char* data, size_t size) {
+            if (request.sink) return request.sink(data, size);
+            response.body.append(data, size);
+            return true;
+        };
+        auto readExact = [&](unsigned long long remaining) {
+            while (remaining > 0) {
+                if (reader.Available() == 0) {
+                    size_t want = (size_t)std::min<unsigned long long>(readSize, remaining);
+                    if (!reader.Fill(want)) return false;
+                    readSize = transport::NextReadSize(readSize, reader.Available());
+                }
+                size_t n = (size_t)std::min<unsigned long long>(reader.Available(), remaining);
+                if (!deliver(reader.Data(), n)) return false;
+                reader.Consume(n);
+                remaining -= n;
+            }
+            return true;
+        };
+
+        bool noBody = request.method == "HEAD" || response.status == 204 || response.status == 304;
+        if (noBody) {
+            response.complete = true;
+        } else if (ContainsToken(response.Header("Transfer-Encoding"), "chunked")) {
+            response.complete = ReadChunked(reader, line, readExact);
+        } else if (!response.Header("Content-Length").empty()) {
+            unsigned long long length = response.ContentLength();
+            if (!request.sink && length <= kMaxReserve) response.body.reserve((size_t)length);
+            response.complete = readExact(length);
+        } else {
+            // No framing: the body runs until the server closes.
+            keepAlive = false;
+            for (;;) {
+                if (reader.Available() > 0) {
+                    if (!deliver(reader.Data(), reader.Available())) break;
+                    reader.Consume(reader.Available());
+                }
+                if (!reader.Fill(readSize)) {
+                    response.complete = reader.Eof();
+                    break;
+                }
+                readSize = transport::NextReadSize(readSize, reader.Available());
+            }
+        }
+
+        timing.end = trace::Now();
+
+        // Unread bytes would poison the next request on this socket.
+        if (reader.Available() > 0) keepAlive = false;
+        return response.complete ? kDone : kFailed;
+    }
+
+    template <typename ReadExact>
+    static bool ReadChunked(Reader& reader, std::string& line, ReadExact& readExact) {
+        for (;;) {
+            if (!reader.ReadLine(line)) return false;
+            char* end = NULL;
+            unsigned long long size = strtoull(line.c_str(), &end, 16);
+            if (end == line.c_str()) return false;
+
+            if (size == 0) {
+                // Skip trailers up to the final empty line.
+                do {
+                    if (!reader.ReadLine(line)) return false;
+                } while (!line.empty());
+                return true;
+            }
+
+            if (!readExact(size)) return false;
+            if (!reader.ReadLine(line) || !line.empty()) return false;
+        }
+    }
+
+    bool Resolve(const transport::Url& url, const std::string& key, std::vector<Address>& addresses,
+                 trace::RequestTiming& timing) {
+        auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = dns_.find(key);
+            if (it != dns_.end() && it->second.expires > now) {
+                addresses = it->second.addresses;
+                return true;
+            }
+        }
+
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = NULL;
+        timing.dnsStart = trace::Now();
+        int error = getaddrinfo(url.host.c_str(), std::to_string(url.port).c_str(), &hints, &result);
+        timing.dnsEnd = trace::Now();
+        if (error != 0) return false;
+
+        addresses.clear();
+        for (addrinfo* ai = result; ai; ai = ai->ai_next) {
+            Address address;
+            memcpy(&address.addr, ai->ai_addr, ai->ai_addrlen);
+            address.len = (socklen_t)ai->ai_addrlen;
+            address.family = ai->ai_family;
+            addresses.push_back(address);
+        }
+        freeaddrinfo(result);
+        if (addresses.empty()) return false;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        dns_[key] = Resolved{ addresses, now + std::chrono::milliseconds(kDnsTtlMs) };
+        return true;
+    }
+
+    bool Connect(const transport::Url& url, const std::string& key, Connection& conn, trace::RequestTiming& timing) {
+        std::vector<Address> addresses;
+        if (!Resolve(url, key, addresses, timing)) return false;
+
+        timing.connectStart = trace::Now();
+        for (const Address& address : addresses) {
+            int fd = socket(address.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) continue;
+            int epfd = epoll_create1(EPOLL_CLOEXEC);
+            if (epfd < 0) {
+                close(fd);
+                continue;
+            }
+
+            epoll_event ev = {};
+            ev.events = EPOLLOUT;
+            ev.data.fd = fd;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+
+            conn.fd = fd;
+            conn.epfd = epfd;
+            conn.key = key;
+
+            bool connected = connect(fd, (const sockaddr*)&address.addr, address.len) == 0;
+            if (!connected && errno == EINPROGRESS && WaitFor(conn, EPOLLOUT)) {
+                int error = 0;
+                socklen_t len = sizeof(error);
+                connected = getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0;
+            }
+
+            if (connected) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                timing.connectEnd = trace::Now();
+#ifdef SCARLET_OPENSSL
+                // The handshake runs with the first request (see Exchange)
+                if (url.https) {
+                    conn.ssl = tls_->Open(fd, url.host, key);
+                    if (!conn.ssl) {
+                        Close(conn);
+                        return false;
+                    }
+                }
+#endif
+                return true;
+            }
+            Close(conn);
+        }
+
+        // Every address failed; resolve again next time.
+        std::lock_guard<std::mutex> lock(mutex_);
+        dns_.erase(key);
+        return false;
+    }
+
+    bool Acquire(const transport::Url& url, Connection& conn, bool& reused, trace::RequestTiming& timing) {
+        std::string key = url.host + ":" + std::to_string(url.port);
+        std::string poolKey = url.https ? "tls:" + key : key;
+
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                EvictIdleLocked();
+                auto it = std::find_if(idle_.rbegin(), idle_.rend(), [&](const Connection& c) { return c.key == poolKey; });
+                if (it == idle_.rend()) break;
+                const HttpRequest* request = conn.request;
+                conn = *it;
+                conn.request = request;
+                idle_.erase(std::next(it).base());
+            }
+
+            // A readable idle socket means the server closed it (or sent
+            // garbage); either way it can't carry a new request.
+#ifdef SCARLET_OPENSSL
+            if (conn.ssl) {
+                // ...except for TLS records with no data in them (late
+                // session tickets), which SSL_peek consumes.
+                char probe;
+                ERR_clear_error();
+                int n = SSL_peek(conn.ssl, &probe, 1);
+                if (n <= 0 && SSL_get_error(conn.ssl, n) == SSL_ERROR_WANT_READ) {
+                    reused = true;
+                    return true;
+                }
+                Close(conn);
+                continue;
+            }
+#endif
+            char probe;
+            ssize_t n = recv(conn.fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                reused = true;
+                return true;
+            }
+            Close(conn);
+        }
+
+        reused = false;
+        if (!Connect(url, key, conn, timing)) return false;
+        conn.key = poolKey;
+        return true;
+    }
+
+    void Release(Connection& conn) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        conn.lastUsed = std::chrono::steady_clock::now();
+        conn.request = nullptr;
+        if (idle_.size() >= kMaxIdleConnections) {
+            Close(idle_.front());
+            idle_.erase(idle_.begin());
+        }
+        idle_.push_back(conn);
+    }
+
+    void EvictIdleLocked() {
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < idle_.size();) {
+            auto idleMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - idle_[i].lastUsed).count();
+            if (idleMs > kIdleTimeoutMs) {
+                Close(idle_[i]);
+                idle_.erase(idle_.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    static void Close(Connection& conn) {
+#ifdef SCARLET_OPENSSL
+        if (conn.ssl) {
+            // close_notify, best effort; the socket never blocks
+            if (conn.handshakeDone) {
+                ERR_clear_error();
+                SSL_shutdown(conn.ssl);
+            }
+            SSL_free(conn.ssl);
+            conn.ssl = nullptr;
+        }
+#endif
+        if (conn.epfd >= 0) close(conn.epfd);
+        if (conn.fd >= 0) close(conn.fd);
+        conn.fd = conn.epfd = -1;
+    }
+
+    void CountRequest(bool success, bool connected) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.requests++;
+        if (!success) stats_.failures++;
+        if (connected) stats_.connectionsOpened++;
+        else if (success) stats_.connectionsReused++;
+    }
+
+    std::mutex mutex_;
+    std::vector<Connection> idle_;
+    std::map<std::string, Resolved> dns_;
+    HttpClientStats stats_;
+#ifdef SCARLET_OPENSSL
+    std::unique_ptr<TlsContext> tls_;  // created by the first https request
+#endif
+};
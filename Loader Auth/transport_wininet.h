@@ -0,0 +1,347 @@
+#pragma once
+
+// WinINet backend of the Transport interface.
+//
+// One WinINet session is opened for the lifetime of the process and every
+// request goes through it, so WinINet can keep the underlying HTTP/1.1
+// sockets alive between calls. Connection handles are pooled per host:port,
+// bounded, and evicted after sitting idle. A request's deadline becomes
+// WinINet's connect/send/receive timeouts for that request, and it and the
+// cancel flag are checked between body reads.
+//
+// https goes through SChannel, which resumes TLS sessions from its own
+// per-process cache; the transport only counts the handshakes.
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <wininet.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdlib>
+#include "transport.h"
+#include "trace.h"
+
+#pragma comment(lib, "wininet.lib")
+
+class WinInetTransport : public Transport {
+public:
+    // --- CONFIG ---
+    static const DWORD kMaxConnectionsPerHost = 4;
+    static const DWORD kMaxSocketsPerServer = 8;   // WinINet limit; leaves room for segmented downloads
+    static const DWORD kMaxIdleHandles = 8;
+    static const DWORD kIdleTimeoutMs = 30000;
+    static const unsigned long long kMaxReserve = 16 * 1024 * 1024;  // cap on Content-Length preallocation
+
+    WinInetTransport() {}
+    ~WinInetTransport() { Shutdown(); }
+    WinInetTransport(const WinInetTransport&) = delete;
+    WinInetTransport& operator=(const WinInetTransport&) = delete;
+
+    HttpResponse Send(const HttpRequest& request) override {
+        HttpResponse response;
+
+        transport::Url url;
+        if (!transport::ParseUrl(request.url, url)) {
+            response.error = "Invalid URL";
+            CountRequest(false, false);
+            return response;
+        }
+
+        PooledConnection* conn = Acquire(url.host, url.port, request.deadline);
+        if (!conn) {
+            response.error = "Failed to open connection";
+            transport::Interrupted(request, response);
+            CountRequest(false, false);
+            return response;
+        }
+
+        // The context pointer lets the status callback tell us whether this
+        // particular request had to open a new socket, and when each phase ran.
+        RequestContext ctx;
+        ctx.timing.start = trace::Now();
+        DWORD flags = INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_KEEP_CONNECTION;
+        if (url.https) flags |= INTERNET_FLAG_SECURE;
+
+        HINTERNET hRequest = HttpOpenRequestA(conn->hConnect, request.method.c_str(), url.target.c_str(),
+            NULL, NULL, NULL, flags, (DWORD_PTR)&ctx);
+
+        if (!hRequest) {
+            Release(conn, false);
+            response.error = "Failed to open request";
+            CountRequest(false, false);
+            return response;
+        }
+
+        if (request.deadline != std::chrono::steady_clock::time_point()) {
+            DWORD timeout = (DWORD)transport::RemainingMs(request, 0xFFFFFFFFUL);
+            if (timeout == 0) timeout = 1;  // 0 would mean "no timeout"
+            InternetSetOptionA(hRequest, INTERNET_OPTION_CONNECT_TIMEOUT, &timeout, sizeof(timeout));
+            InternetSetOptionA(hRequest, INTERNET_OPTION_SEND_TIMEOUT, &timeout, sizeof(timeout));
+            InternetSetOptionA(hRequest, INTERNET_OPTION_RECEIVE_TIMEOUT, &timeout, sizeof(timeout));
+        }
+
+        std::string headers;
+        for (const HttpHeader& h : request.headers) headers += h.name + ": " + h.value + "\r\n";
+
+        BOOL result = HttpSendRequestA(hRequest,
+            headers.empty() ? NULL : headers.c_str(), (DWORD)headers.size(),
+            request.body.empty() ? NULL : (LPVOID)request.body.data(), (DWORD)request.body.size());
+
+        response.requestSent = ctx.sent;
+        if (!result) {
+            InternetCloseHandle(hRequest);
+            Release(conn, false);
+            response.error = "Failed to send request";
+            transport::Interrupted(request, response);
+            CountRequest(false, ctx.connected, url.https);
+            ctx.timing.Commit(request.method, url.target);
+            return response;
+        }
+        ctx.timing.firstByte = trace::Now();  // HttpSendRequest returns once the headers are in
+
+        DWORD statusCode = 0;
+        DWORD statusSize = sizeof(statusCode);
+        HttpQueryInfoA(hRequest, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER, &statusCode, &statusSize, NULL);
+        response.status = statusCode;
+        response.headers = RawHeaders(hRequest);
+
+        if (request.onHeaders && !request.onHeaders(response)) {
+            InternetCloseHandle(hRequest);
+            Release(conn, false);
+            response.error = "Response rejected";
+            CountRequest(false, ctx.connected, url.https);
+            ctx.timing.Commit(request.method, url.target);
+            return response;
+        }
+
+        // Drain the body completely; WinINet only returns the socket to its
+        // keep-alive pool once the response has been read to the end.
+        response.complete = request.sink ? ReadToSink(hRequest, request) : ReadToString(hRequest, request, response);
+        ctx.timing.end = trace::Now();
+        if (!response.complete) transport::Interrupted(request, response);
+
+        InternetCloseHandle(hRequest);
+        Release(conn, response.complete);
+        CountRequest(response.complete, ctx.connected, url.https);
+        ctx.timing.Commit(request.method, url.target);
+
+        return response;
+    }
+
+    HttpClientStats Stats() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    void Shutdown() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (PooledConnection* conn : pool_) {
+            InternetCloseHandle(conn->hConnect);
+            delete conn;
+        }
+        pool_.clear();
+        if (hSession_) {
+            InternetSetStatusCallbackA(hSession_, NULL);
+            InternetCloseHandle(hSession_);
+            hSession_ = NULL;
+        }
+    }
+
+private:
+    struct PooledConnection {
+        std::string host;
+        INTERNET_PORT port;
+        HINTERNET hConnect;
+        bool inUse;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    struct RequestContext {
+        bool connected = false;
+        bool sent = false;
+        trace::RequestTiming timing;
+    };
+
+    static void CALLBACK StatusCallback(HINTERNET, DWORD_PTR context, DWORD status, LPVOID, DWORD) {
+        if (!context) return;
+        RequestContext* ctx = (RequestContext*)context;
+        switch (status) {
+        case INTERNET_STATUS_RESOLVING_NAME: ctx->timing.dnsStart = trace::Now(); break;
+        case INTERNET_STATUS_NAME_RESOLVED: ctx->timing.dnsEnd = trace::Now(); break;
+        case INTERNET_STATUS_CONNECTING_TO_SERVER: ctx->timing.connectStart = trace::Now(); break;
+        case INTERNET_STATUS_CONNECTED_TO_SERVER:
+            ctx->connected = true;
+            ctx->timing.connectEnd = trace::Now();
+            break;
+        case INTERNET_STATUS_REQUEST_SENT:
+            ctx->sent = true;
+            ctx->timing.sent = trace::Now();
+            break;
+        }
+    }
+
+    // Parses HTTP_QUERY_RAW_HEADERS_CRLF (status line first, then one
+    // "Name: value" per line).
+    static std::vector<HttpHeader> RawHeaders(HINTERNET hRequest) {
+        std::vector<HttpHeader> headers;
+        DWORD size = 0;
+        HttpQueryInfoA(hRequest, HTTP_QUERY_RAW_HEADERS_CRLF, NULL, &size, NULL);
+        if (size == 0) return headers;
+
+        std::string raw(size, '\0');
+        if (!HttpQueryInfoA(hRequest, HTTP_QUERY_RAW_HEADERS_CRLF, &raw[0], &size, NULL)) return headers;
+        raw.resize(size);
+
+        size_t pos = raw.find("\r\n");
+        while (pos != std::string::npos && pos + 2 < raw.size()) {
+            size_t start = pos + 2;
+            pos = raw.find("\r\n", start);
+            std::string line = raw.substr(start, pos == std::string::npos ? std::string::npos : pos - start);
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            size_t value = line.find_first_not_of(' ', colon + 1);
+            headers.push_back({ line.substr(0, colon), value == std::string::npos ? "" : line.substr(value) });
+        }
+        return headers;
+    }
+
+    bool ReadToString(HINTERNET hRequest, const HttpRequest& request, HttpResponse& response) {
+        // Size the body up front when the server tells us its length
+        unsigned long long length = response.ContentLength();
+        if (length > 0 && length <= kMaxReserve) response.body.reserve((size_t)length);
+
+        // Appending by length keeps embedded NULs.
+        char buffer[8192];
+        DWORD bytesRead;
+        for (;;) {
+            if (transport::Expired(request) || transport::Cancelled(request)) return false;
+            if (!InternetReadFile(hRequest, buffer, sizeof(buffer), &bytesRead)) return false;
+            if (bytesRead == 0) return true;
+            response.body.append(buffer, bytesRead);
+        }
+    }
+
+    bool ReadToSink(HINTERNET hRequest, const HttpRequest& request) {
+        std::vector<char> buffer(transport::kMaxReadSize);
+        size_t readSize = transport::kMinReadSize;
+        DWORD bytesRead = 0;
+        for (;;) {
+            if (transport::Expired(request) || transport::Cancelled(request)) return false;
+            if (!InternetReadFile(hRequest, buffer.data(), (DWORD)readSize, &bytesRead)) return false;
+            if (bytesRead == 0) return true;
+            if (!request.sink(buffer.data(), bytesRead)) return false;
+            readSize = transport::NextReadSize(readSize, bytesRead);
+        }
+    }
+
+    HINTERNET OpenSessionLocked() {
+        if (hSession_) return hSession_;
+
+        hSession_ = InternetOpenA("ScarletAuthLoader/1.0", INTERNET_OPEN_TYPE_DIRECT, NULL, NULL, 0);
+        if (!hSession_) return NULL;
+
+        DWORD maxConns = kMaxSocketsPerServer;
+        InternetSetOptionA(hSession_, INTERNET_OPTION_MAX_CONNS_PER_SERVER, &maxConns, sizeof(maxConns));
+        InternetSetOptionA(hSession_, INTERNET_OPTION_MAX_CONNS_PER_1_0_SERVER, &maxConns, sizeof(maxConns));
+        InternetSetStatusCallbackA(hSession_, StatusCallback);
+        return hSession_;
+    }
+
+    // Waits for a free slot on the host, until `deadline` when one is set.
+    PooledConnection* Acquire(const std::string& host, INTERNET_PORT port,
+                              std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!OpenSessionLocked()) return NULL;
+
+        for (;;) {
+            EvictIdleLocked();
+
+            DWORD active = 0;
+            for (PooledConnection* conn : pool_) {
+                if (conn->host != host || conn->port != port) continue;
+                if (!conn->inUse) {
+                    conn->inUse = true;
+                    return conn;
+                }
+                active++;
+            }
+
+            if (active < kMaxConnectionsPerHost) break;
+            if (deadline == std::chrono::steady_clock::time_point()) {
+                released_.wait(lock);
+            } else if (released_.wait_until(lock, deadline) == std::cv_status::timeout) {
+                return NULL;
+            }
+        }
+
+        HINTERNET hConnect = InternetConnectA(hSession_, host.c_str(), port,
+            NULL, NULL, INTERNET_SERVICE_HTTP, 0, 0);
+        if (!hConnect) return NULL;
+
+        PooledConnection* conn = new PooledConnection{ host, port, hConnect, true, std::chrono::steady_clock::now() };
+        pool_.push_back(conn);
+        return conn;
+    }
+
+    void Release(PooledConnection* conn, bool healthy) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        conn->inUse = false;
+        conn->lastUsed = std::chrono::steady_clock::now();
+
+        if (!healthy) {
+            RemoveLocked(conn);
+        } else {
+            // Keep at most kMaxIdleHandles idle handles around.
+            DWORD idle = 0;
+            for (PooledConnection* c : pool_) if (!c->inUse) idle++;
+            if (idle > kMaxIdleHandles) RemoveLocked(conn);
+        }
+        released_.notify_one();
+    }
+
+    void EvictIdleLocked() {
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < pool_.size();) {
+            PooledConnection* conn = pool_[i];
+            auto idleMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - conn->lastUsed).count();
+            if (!conn->inUse && idleMs > (long long)kIdleTimeoutMs) {
+                RemoveLocked(conn);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    void RemoveLocked(PooledConnection* conn) {
+        for (size_t i = 0; i < pool_.size(); i++) {
+            if (pool_[i] == conn) {
+                pool_.erase(pool_.begin() + i);
+                break;
+            }
+        }
+        InternetCloseHandle(conn->hConnect);
+        delete conn;
+    }
+
+    // A new https connection is a TLS handshake; SChannel decides whether
+    // it resumes a cached session.
+    void CountRequest(bool success, bool connected, bool https = false) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.requests++;
+        if (!success) stats_.failures++;
+        if (connected) stats_.connectionsOpened++;
+        else if (success) stats_.connectionsReused++;
+        if (connected && https) stats_.tlsHandshakes++;
+    }
+
+    std::mutex mutex_;
+    std::condition_variable released_;
+    HINTERNET hSession_ = NULL;
+    std::vector<PooledConnection*> pool_;
+    HttpClientStats stats_;
+};
@@ -1,6 +1,10 @@
 const express = require('express');
 const router = express.Router();
 const crypto = require('crypto');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { execFile } = require('child_process');
 const admin = require("firebase-admin");
 const db = admin.firestore();
 const discordLogger = require('./discord-logger'); // Discord Logging System
@@ -284,6 +288,46 @@ router.post('/api/app/:appId/blacklist', isPartner, async (req, res) => {
 
 // --- PUBLIC AUTH CLIENT API (For C# / C++ / Python Clients) ---
 
+// Optional capabilities advertised to clients in /auth/init
+const SERVER_FEATURES = ['batch', 'telemetry', 'payload-batch'];
+
+// Sessions are stateless: the server signs (session_id, appId, expires_at)
+// so a relaunched client can resume without another /auth/init. Without a
+// configured key, sessions only survive until the server restarts.
+const SESSION_TTL_MS = 12 * 60 * 60 * 1000;
+const SESSION_SIGNING_KEY = process.env.SESSION_SIGNING_KEY || generateRandomString(64);
+const sessionPayload = (session_id, appId, expires_at) => `${session_id}.${appId}.${expires_at}`;
+const signSession = (session_id, appId, expires_at) =>
+    crypto.createHmac('sha256', SESSION_SIGNING_KEY).update(sessionPayload(session_id, appId, expires_at)).digest('hex');
+
+// Offline license leases: successful license/login checks (and the menu
+// fetcher's user info) carry an Ed25519-signed statement of who may run on
+// which HWID until when. Clients verify it locally with the public key and
+// only come back online when it is about to run out. Leases are issued
+// only when LEASE_PRIVATE_KEY (PKCS#8 PEM) is set; a lease never outlives
+// the subscription itself.
+const LEASE_TTL_MS = Number(process.env.LEASE_TTL_MS) || 3 * 24 * 60 * 60 * 1000;
+const LEASE_KEY = process.env.LEASE_PRIVATE_KEY ? crypto.createPrivateKey(process.env.LEASE_PRIVATE_KEY) : null;
+if (LEASE_KEY) {
+    const spki = crypto.createPublicKey(LEASE_KEY).export({ type: 'spki', format: 'der' });
+    console.log(`[AUTH] License leases enabled, public key: ${spki.subarray(spki.length - 32).toString('hex')}`);
+}
+
+// kind: "license" (subject = key), "login" (subject = username) or "info"
+// (menu fetcher, subject = username). Returns undefined when leases are off.
+const issueLease = ({ kind, appId, subject, hwid, username, level, expires_at, created_at, subscription_type }) => {
+    if (!LEASE_KEY || !expires_at) return undefined;
+    const now = Date.now();
+    const expires_ms = new Date(expires_at).getTime();
+    if (!(expires_ms > now)) return undefined;
+
+    const payload = JSON.stringify({
+        v: 1, kind, appId, subject, hwid, username, level: level || 1, expires_at, expires_ms,
+        created_at, subscription_type, issued_at: now, lease_expires: Math.min(now + LEASE_TTL_MS, expires_ms)
+    });
+    return { payload, sig: crypto.sign(null, Buffer.from(payload), LEASE_KEY).toString('hex') };
+};
+
 // 1. Initialize
 router.post('/auth/init', async (req, res) => {
     const { name, ownerId, secret, version } = req.body;
@@ -310,12 +354,16 @@ router.post('/auth/init', async (req, res) => {
         }
 
         const session_id = generateRandomString(32);
+        const expires_at = Date.now() + SESSION_TTL_MS;
 
         res.json({
             success: true,
             message: "Initialized",
+            features: SERVER_FEATURES,
             session_id,
             appId: appDoc.id, // Return appId for client to use in subsequent requests
+            expires_at,
+            session_sig: signSession(session_id, appDoc.id, expires_at),
             app_info: {
                 numUsers: (await db.collection('app_users').where('appId', '==', appDoc.id).count().get()).data().count,
                 numOnlineUsers: 0, // Implement real tracking later
@@ -330,6 +378,46 @@ router.post('/auth/init', async (req, res) => {
 });
 
 
+// 1b. Resume a session issued by /auth/init (skips the app lookup and user count)
+router.post('/auth/session/resume', async (req, res) => {
+    const { session_id, appId, expires_at, session_sig, version } = req.body;
+
+    try {
+        if (!session_id || !appId || !session_sig) {
+            return res.status(400).json({ success: false, message: "Missing session" });
+        }
+
+        // Signature and expiry are checked before touching the database
+        const expiresAt = Number(expires_at);
+        const payload = sessionPayload(session_id, appId, expiresAt);
+        if (!verifySignature(payload, String(session_sig), SESSION_SIGNING_KEY) || !(expiresAt > Date.now())) {
+            return res.status(401).json({ success: false, message: "Session expired" });
+        }
+
+        const appDoc = await db.collection('applications').doc(String(appId)).get();
+        if (!appDoc.exists) return res.status(404).json({ success: false, message: "Application not found" });
+
+        const appData = appDoc.data();
+        if (appData.status !== 'active') return res.status(403).json({ success: false, message: "Application Disabled" });
+        if (version !== appData.version) {
+            return res.status(403).json({ success: false, message: "Update Required", download: appData.download_link || "" });
+        }
+
+        res.json({
+            success: true,
+            message: "Resumed",
+            features: SERVER_FEATURES,
+            session_id,
+            appId,
+            expires_at: expiresAt
+        });
+
+    } catch (e) {
+        console.error("Session Resume Error:", e);
+        res.status(500).json({ success: false, message: "Server Error" });
+    }
+});
+
 // 2. Login (User/Pass)
 router.post('/auth/login', async (req, res) => {
     const { username, password, session_id, hwid, appId } = req.body;
@@ -371,7 +459,11 @@ router.post('/auth/login', async (req, res) => {
                 hwid: hwid,
                 createdate: userData.created_at,
                 lastlogin: now.toISOString()
-            }
+            },
+            lease: issueLease({
+                kind: 'login', appId, subject: userData.username, hwid, username: userData.username,
+                level: userData.level, expires_at: userData.expires_at
+            })
         });
 
         // Log Login
@@ -385,7 +477,7 @@ router.post('/auth/login', async (req, res) => {
 
 
 // 3. License (Key Only Login)
-router.post('/auth/license', async (req, res) => {
+const handleLicense = async (req, res) => {
     const { key, hwid, appId, session_id } = req.body;
 
     try {
@@ -409,7 +501,8 @@ router.post('/auth/license', async (req, res) => {
                 return res.json({
                     success: true,
                     message: "Authenticated",
-                    info: { username: key, subscriptions: [{ subscription: "default", expiry: keyData.expires_at }], timeleft: (expires - now) / 1000 }
+                    info: { username: key, subscriptions: [{ subscription: "default", expiry: keyData.expires_at }], timeleft: (expires - now) / 1000 },
+                    lease: issueLease({ kind: 'license', appId, subject: key, hwid, username: key, level: keyData.level, expires_at: keyData.expires_at })
                 });
             }
         }
@@ -469,19 +562,21 @@ router.post('/auth/license', async (req, res) => {
         res.json({
             success: true,
             message: "Key Activated",
-            info: { username: key, subscriptions: [{ subscription: "default", expiry: expires.toISOString() }], timeleft: (expires - now) / 1000 }
+            info: { username: key, subscriptions: [{ subscription: "default", expiry: expires.toISOString() }], timeleft: (expires - now) / 1000 },
+            lease: issueLease({ kind: 'license', appId, subject: key, hwid, username: key, level: keyData.level, expires_at: expires.toISOString() })
         });
 
     } catch (e) {
         console.error("License Error:", e);
         res.status(500).json({ success: false, message: "Error" });
     }
-});
+};
+router.post('/auth/license', handleLicense);
 
 
 
 // 4. Update HWID (GetHWID)
-router.post('/auth/hwid', async (req, res) => {
+const handleHwid = async (req, res) => {
     const { appId, key, hwid, session_id } = req.body;
 
     if (!appId || !key || !hwid) {
@@ -513,10 +608,11 @@ router.post('/auth/hwid', async (req, res) => {
         console.error("HWID Update Error:", e);
         res.status(500).json({ success: false, message: "Server Error" });
     }
-});
+};
+router.post('/auth/hwid', handleHwid);
 
 // 5. Store/Get Components (GetComponents)
-router.post('/auth/components', async (req, res) => {
+const handleComponents = async (req, res) => {
     const { appId, key, hwid, gpu, motherboard, cpu, session_id } = req.body;
 
     if (!appId || !key || !hwid) {
@@ -561,11 +657,12 @@ router.post('/auth/components', async (req, res) => {
         console.error("Components Update Error:", e);
         res.status(500).json({ success: false, message: "Server Error" });
     }
-});
+};
+router.post('/auth/components', handleComponents);
 
 // 6. Log Login (SendLogLogin)
-router.post('/auth/log-login', async (req, res) => {
-    const { appId, username_or_key, hwid, components, session_id } = req.body;
+const handleLogLogin = async (req, res) => {
+    const { appId, username_or_key, hwid, components, session_id, event_id, occurred_at } = req.body;
 
     if (!appId || !username_or_key) {
         return res.status(400).json({ success: false, message: "Missing required fields" });
@@ -573,6 +670,10 @@ router.post('/auth/log-login', async (req, res) => {
 
     try {
         const now = new Date().toISOString();
+        // Queued loader events arrive late. The client's clock is only kept as
+        // a hint (occurred_at); the log is ordered by when the server got it.
+        const occurredMs = Number(occurred_at);
+        const occurredAt = occurredMs > 0 && occurredMs <= Date.now() ? new Date(occurredMs).toISOString() : null;
         const ip = req.ip || req.headers['x-forwarded-for'] || 'unknown';
 
         let finalComponents = components || null;
@@ -613,14 +714,26 @@ router.post('/auth/log-login', async (req, res) => {
         }
 
         // Create login log entry
-        await db.collection('app_login_logs').add({
+        const logEntry = {
             appId: appId,
             key_or_username: username_or_key,
             hwid: hwid || "",
             components: finalComponents, // Capture components if sent or found
             ip: ip,
-            timestamp: now
-        });
+            timestamp: now,
+            occurred_at: occurredAt
+        };
+        if (/^[0-9a-f]{32}$/.test(String(event_id || ''))) {
+            // A resent telemetry event keeps its id, so the same document is written once
+            try {
+                await db.collection('app_login_logs').doc(`${appId}_${event_id}`).create(logEntry);
+            } catch (createError) {
+                if (createError.code !== 6) throw createError;  // 6 = ALREADY_EXISTS
+                return res.json({ success: true, message: "Login already logged", duplicate: true });
+            }
+        } else {
+            await db.collection('app_login_logs').add(logEntry);
+        }
 
         // Log to Discord (logs-inject)
         discordLogger.logLoaderLogin({
@@ -637,6 +750,70 @@ router.post('/auth/log-login', async (req, res) => {
         console.error("Login Log Error:", e);
         res.status(500).json({ success: false, message: "Server Error" });
     }
+};
+router.post('/auth/log-login', handleLogLogin);
+
+// 6.5. Batched Activation (license + hwid + components + log-login in one round trip)
+// Runs the regular handlers against a capturing response so every step keeps
+// its own validation and logging.
+const runHandler = (handler, req, body) => new Promise((resolve) => {
+    let statusCode = 200;
+    const res = {
+        status(code) { statusCode = code; return this; },
+        json(payload) { resolve({ ...payload, status: statusCode }); return this; }
+    };
+    Promise.resolve(handler({ ...req, body, ip: req.ip, headers: req.headers }, res))
+        .catch(() => resolve({ status: 500, success: false, message: "Server Error" }));
+});
+
+router.post('/auth/activate-batch', async (req, res) => {
+    const { appId, key, hwid, session_id, gpu, motherboard, cpu } = req.body;
+
+    if (!appId || !key || !hwid) {
+        return res.status(400).json({ success: false, message: "Missing required fields" });
+    }
+
+    const base = { appId, key, hwid, session_id };
+    const license = await runHandler(handleLicense, req, base);
+
+    if (!license.success) {
+        return res.status(license.status).json({ success: false, message: license.message, license });
+    }
+
+    const [hwidResult, components, log] = await Promise.all([
+        runHandler(handleHwid, req, base),
+        runHandler(handleComponents, req, { ...base, gpu, motherboard, cpu }),
+        runHandler(handleLogLogin, req, { appId, username_or_key: key, hwid, session_id })
+    ]);
+
+    res.json({ success: true, message: license.message, license, lease: license.lease, hwid: hwidResult, components, log });
+});
+
+// 6.6. Telemetry batch: login logs and component reports queued by the loader
+// (and spooled across launches), delivered in one request. Each event runs
+// through its regular handler; the response lists the events worth sending
+// again (server errors), everything else is final.
+const TELEMETRY_MAX_EVENTS = 100;
+const TELEMETRY_HANDLERS = { login: handleLogLogin, components: handleComponents };
+
+router.post('/auth/telemetry', async (req, res) => {
+    const { appId, session_id, events } = req.body;
+
+    if (!appId || !Array.isArray(events)) {
+        return res.status(400).json({ success: false, message: "Missing required fields" });
+    }
+    if (events.length > TELEMETRY_MAX_EVENTS) {
+        return res.status(413).json({ success: false, message: `At most ${TELEMETRY_MAX_EVENTS} events per batch` });
+    }
+
+    const results = await Promise.all(events.map(event => {
+        const handler = event && TELEMETRY_HANDLERS[event.type];
+        if (!handler) return { status: 400, success: false, message: "Unknown event type" };
+        return runHandler(handler, req, { ...event, appId, session_id });
+    }));
+
+    const retry = events.filter((event, i) => results[i].status >= 500).map(event => String(event.event_id || ''));
+    res.json({ success: true, accepted: events.length - retry.length, retry });
 });
 
 // 7. Get Logs (GetLogs)
@@ -679,6 +856,59 @@ router.get('/api/app/:appId/logs', async (req, res) => {
 
 // --- LOADER SPECIFIC APIs ---
 
+// Delta updates: when an upload replaces a payload, a `zstd --patch-from`
+// patch from the replaced version to the new one is stored under
+// patches/<appId>/<product>/<old sha256>.zst. Loaders that still have the
+// old version cached report its hash to /auth/payload/stream and are
+// offered the patch next to the full download. Only the latest version
+// has patches, and only from the one before it. Needs the zstd CLI on the
+// server; without it uploads work as before.
+const PATCH_LEVEL = Math.min(Number(process.env.PATCH_LEVEL) || 19, 19);
+const PATCH_MAX_RATIO = 0.5;  // larger patches are not worth offering
+
+let zstdAvailable = null;
+const hasZstd = () => {
+    if (!zstdAvailable) {
+        zstdAvailable = new Promise(resolve => execFile('zstd', ['--version'], err => resolve(!err)));
+    }
+    return zstdAvailable;
+};
+
+const buildPatch = async (oldBuffer, newBuffer) => {
+    const dir = await fs.promises.mkdtemp(path.join(os.tmpdir(), 'scarlet-patch-'));
+    try {
+        const oldPath = path.join(dir, 'old');
+        const newPath = path.join(dir, 'new');
+        const patchPath = path.join(dir, 'patch.zst');
+        await fs.promises.writeFile(oldPath, oldBuffer);
+        await fs.promises.writeFile(newPath, newBuffer);
+        await new Promise((resolve, reject) => execFile('zstd',
+            ['-q', '-f', `-${PATCH_LEVEL}`, `--patch-from=${oldPath}`, newPath, '-o', patchPath],
+            err => err ? reject(err) : resolve()));
+        return await fs.promises.readFile(patchPath);
+    } finally {
+        await fs.promises.rm(dir, { recursive: true, force: true });
+    }
+};
+
+// Replaces the product's patches with one from `previous` ({ buffer, sha256 })
+// to the new version.
+const storePatch = async (bucket, appId, productName, previous, newBuffer, newSha256) => {
+    const prefix = `patches/${appId}/${productName}/`;
+    await bucket.deleteFiles({ prefix });
+    if (!previous || previous.sha256 === newSha256) return;
+
+    const patch = await buildPatch(previous.buffer, newBuffer);
+    if (patch.length > newBuffer.length * PATCH_MAX_RATIO) return;
+    await bucket.file(`${prefix}${previous.sha256}.zst`).save(patch, {
+        metadata: {
+            contentType: 'application/octet-stream',
+            metadata: { base_sha256: previous.sha256, target_sha256: newSha256 }
+        }
+    });
+    console.log(`[PAYLOAD-PATCH] ${appId}/${productName}: ${patch.length} byte patch for a ${newBuffer.length} byte payload`);
+};
+
 // 8. Upload Secure Payload (exe/dll) to Firebase Storage
 router.post('/auth/payload/upload', isPartner, async (req, res) => {
     const { userId, appId, productName, fileData, fileName } = req.body;
@@ -724,6 +954,21 @@ router.post('/auth/payload/upload', isPartner, async (req, res) => {
 
         const storagePath = `payloads/${appId}/${productName}${fileExt}`;
         const file = bucket.file(storagePath);
+        const sha256 = crypto.createHash('sha256').update(buffer).digest('hex');
+
+        // The version being replaced, to build the delta patch from
+        let previous = null;
+        if (await hasZstd()) {
+            try {
+                const [existed] = await file.exists();
+                if (existed) {
+                    const [oldBuffer] = await file.download();
+                    previous = { buffer: oldBuffer, sha256: crypto.createHash('sha256').update(oldBuffer).digest('hex') };
+                }
+            } catch (previousError) {
+                console.warn("Previous payload unavailable, no patch will be built:", previousError.message);
+            }
+        }
 
         // Upload to Firebase Storage with metadata
         try {
@@ -734,7 +979,9 @@ router.post('/auth/payload/upload', isPartner, async (req, res) => {
                         uploadedBy: userId,
                         productName: productName,
                         appId: appId,
-                        uploadedAt: new Date().toISOString()
+                        uploadedAt: new Date().toISOString(),
+                        // Checked by the loader while it downloads (/auth/payload/stream)
+                        sha256
                     }
                 }
             });
@@ -760,6 +1007,12 @@ router.post('/auth/payload/upload', isPartner, async (req, res) => {
             });
         }
 
+        if (await hasZstd()) {
+            // Built after the response; loaders get full downloads until it is stored
+            setImmediate(() => storePatch(bucket, appId, productName, previous, buffer, sha256)
+                .catch(err => console.error('[PAYLOAD-PATCH] Error:', err.message)));
+        }
+
         // Log upload to Discord
         const userDoc = await db.collection('users').doc(String(userId)).get();
         const username = userDoc.exists ? userDoc.data().username : 'Unknown';
@@ -844,8 +1097,8 @@ router.get('/api/app/:appId/files', async (req, res) => {
 });
 
 // 9. Stream/Download Secure Payload (for authenticated loaders)
-router.post('/auth/payload/stream', async (req, res) => {
-    const { appId, key, hwid, productName, session_id } = req.body;
+const handlePayloadStream = async (req, res) => {
+    const { appId, key, hwid, productName, session_id, cachedEtag, baseSha256 } = req.body;
 
     if (!appId || !productName || (!key && !hwid)) {
         return res.status(400).json({ success: false, message: "Missing required fields" });
@@ -918,11 +1171,39 @@ router.post('/auth/payload/stream', async (req, res) => {
             return res.status(404).json({ success: false, message: "Payload not found for this product" });
         }
 
-        // Generate signed URL (30 seconds expiry)
-        const [signedUrl] = await file.getSignedUrl({
-            action: 'read',
-            expires: Date.now() + 30 * 1000 // 30 seconds
-        });
+        // Content hash of the stored object; lets loaders keep a local cache
+        const [metadata] = await file.getMetadata();
+        const etag = metadata.md5Hash || metadata.etag || "";
+        const sha256 = (metadata.metadata && metadata.metadata.sha256) || "";  // payloads uploaded before it was recorded have none
+        const notModified = !!cachedEtag && cachedEtag === etag;
+
+        // Generate signed URL (30 seconds expiry) only when the loader's copy is stale
+        let signedUrl = null;
+        if (!notModified) {
+            [signedUrl] = await file.getSignedUrl({
+                action: 'read',
+                expires: Date.now() + 30 * 1000 // 30 seconds
+            });
+        }
+
+        // A patch from the loader's cached version, when the last upload built one
+        let patchUrl, patchSize;
+        if (!notModified && sha256 && /^[0-9a-f]{64}$/.test(String(baseSha256 || '')) && baseSha256 !== sha256) {
+            const patchFile = bucket.file(`patches/${appId}/${productName}/${baseSha256}.zst`);
+            const [patchExists] = await patchFile.exists();
+            if (patchExists) {
+                const [patchMetadata] = await patchFile.getMetadata();
+                if (patchMetadata.metadata && patchMetadata.metadata.target_sha256 === sha256) {
+                    [patchUrl] = await patchFile.getSignedUrl({ action: 'read', expires: Date.now() + 30 * 1000 });
+                    patchSize = parseInt(patchMetadata.size) || 0;
+                }
+            }
+        }
+
+        // A revalidated cache issues no URL and downloads nothing, so it is not logged
+        if (notModified) {
+            return res.json({ success: true, message: "Payload not modified", notModified: true, etag });
+        }
 
         // Log download to Discord
         const appDoc = await db.collection('applications').doc(appId).get();
@@ -941,6 +1222,11 @@ router.post('/auth/payload/stream', async (req, res) => {
             success: true,
             message: "Payload ready",
             downloadUrl: signedUrl,
+            etag,
+            sha256,
+            size: parseInt(metadata.size) || 0,
+            patchUrl,
+            patchSize,
             expiresIn: 30 // seconds
         });
 
@@ -948,65 +1234,126 @@ router.post('/auth/payload/stream', async (req, res) => {
         console.error("Payload Stream Error:", e);
         res.status(500).json({ success: false, message: "Stream failed", error: e.message });
     }
+};
+router.post('/auth/payload/stream', handlePayloadStream);
+
+// 9.5. Batched payload URLs: several products in one round trip, so a loader
+// fetching more than one starts every download inside the same 30-second
+// window. Each product runs through /auth/payload/stream's handler (license
+// check, patch lookup, download log); answers come back in request order.
+const PAYLOAD_BATCH_MAX = 16;
+
+router.post('/auth/payload/batch', async (req, res) => {
+    const { appId, key, hwid, session_id, products } = req.body;
+
+    if (!appId || (!key && !hwid) || !Array.isArray(products) || products.length === 0) {
+        return res.status(400).json({ success: false, message: "Missing required fields" });
+    }
+    if (products.length > PAYLOAD_BATCH_MAX) {
+        return res.status(413).json({ success: false, message: `At most ${PAYLOAD_BATCH_MAX} products per batch` });
+    }
+
+    const results = await Promise.all(products.map(product => {
+        const { productName, cachedEtag, baseSha256 } = product || {};
+        return runHandler(handlePayloadStream, req, { appId, key, hwid, session_id, productName, cachedEtag, baseSha256 });
+    }));
+
+    res.json({
+        success: true,
+        products: results.map((result, i) => ({ ...result, productName: String((products[i] || {}).productName || '') }))
+    });
 });
 
-// 10. Get User Info by HWID (for remote applications without auth system)
-router.get('/auth/get-user/:appId/:hwid', async (req, res) => {
+// --- HWID LOOKUP HELPERS (get-user / get-expiry / get-user-info) ---
+
+// Validates appId/appSecret and finds the key bound to the HWID. Sends the
+// error response itself and returns null when the lookup fails.
+const findKeyByHwid = async (req, res, endpoint) => {
     const { appId, hwid } = req.params;
     const { appSecret } = req.query;
 
     if (!appId || !appSecret || !hwid) {
-        return res.status(400).json({ success: false, message: "Missing required fields" });
+        res.status(400).json({ success: false, message: "Missing required fields" });
+        return null;
     }
 
-    try {
-        // Verify app exists and secret matches
-        const appDoc = await db.collection('applications').doc(appId).get();
-        if (!appDoc.exists) {
-            return res.status(404).json({ success: false, message: "Application not found" });
-        }
+    // Verify app exists and secret matches
+    const appDoc = await db.collection('applications').doc(appId).get();
+    if (!appDoc.exists) {
+        res.status(404).json({ success: false, message: "Application not found" });
+        return null;
+    }
 
-        const appData = appDoc.data();
-        if (appData.secret !== appSecret) {
-            return res.status(403).json({ success: false, message: "Invalid app secret" });
-        }
+    const appData = appDoc.data();
+    if (appData.secret !== appSecret) {
+        res.status(403).json({ success: false, message: "Invalid app secret" });
+        return null;
+    }
 
-        // Search for user by HWID
-        const keySnapshot = await db.collection('app_keys')
-            .where('appId', '==', appId)
-            .where('hwid', '==', hwid)
-            .limit(1)
-            .get();
+    // Search for user by HWID
+    const keySnapshot = await db.collection('app_keys')
+        .where('appId', '==', appId)
+        .where('hwid', '==', hwid)
+        .limit(1)
+        .get();
 
-        if (keySnapshot.empty) {
-            // Log suspicious access - unregistered HWID
-            discordLogger.logSuspiciousHWIDAccess({
-                appId: appId,
-                appName: appData.name,
-                hwid: hwid,
-                ip: req.ip || req.connection.remoteAddress,
-                endpoint: '/auth/get-user',
-                reason: 'HWID não registrado'
-            }).catch(err => console.error('[SUSPICIOUS-HWID-LOG] Error:', err));
+    if (keySnapshot.empty) {
+        // Log suspicious access - unregistered HWID
+        discordLogger.logSuspiciousHWIDAccess({
+            appId: appId,
+            appName: appData.name,
+            hwid: hwid,
+            ip: req.ip || req.connection.remoteAddress,
+            endpoint: endpoint,
+            reason: 'HWID não registrado'
+        }).catch(err => console.error('[SUSPICIOUS-HWID-LOG] Error:', err));
 
-            return res.status(404).json({ success: false, message: "HWID not registered" });
-        }
+        res.status(404).json({ success: false, message: "HWID not registered" });
+        return null;
+    }
 
-        const keyDoc = keySnapshot.docs[0];
-        const keyData = keyDoc.data();
+    return keySnapshot.docs[0].data();
+};
 
-        // Get username from linked user or use key as username
-        let username = keyData.key; // Default to key
-        if (keyData.linked_user_id) {
-            const userDoc = await db.collection('app_users').doc(keyData.linked_user_id).get();
-            if (userDoc.exists) {
-                username = userDoc.data().username;
-            }
-        }
+// Username from the linked user, or the key itself
+const usernameForKey = async (keyData) => {
+    if (keyData.linked_user_id) {
+        const userDoc = await db.collection('app_users').doc(keyData.linked_user_id).get();
+        if (userDoc.exists) return userDoc.data().username;
+    }
+    return keyData.key;
+};
+
+const expiryForKey = (keyData) => {
+    const now = new Date();
+    const expires = keyData.expires_at ? new Date(keyData.expires_at) : null;
+
+    let daysRemaining = null;
+    let isExpired = false;
+
+    if (expires) {
+        daysRemaining = Math.max(0, Math.ceil((expires - now) / (1000 * 60 * 60 * 24)));
+        isExpired = expires < now;
+    }
+
+    return {
+        expires_at: keyData.expires_at,
+        days_remaining: daysRemaining,
+        is_expired: isExpired,
+        subscription_type: keyData.type || 'license',
+        level: keyData.level || 1
+    };
+};
+
+// 10. Get User Info by HWID (for remote applications without auth system)
+router.get('/auth/get-user/:appId/:hwid', async (req, res) => {
+    try {
+        const keyData = await findKeyByHwid(req, res, '/auth/get-user');
+        if (!keyData) return;
 
         res.json({
             success: true,
-            username: username,
+            username: await usernameForKey(keyData),
             created_at: keyData.activated_at || keyData.created_at
         });
 
@@ -1018,72 +1365,40 @@ router.get('/auth/get-user/:appId/:hwid', async (req, res) => {
 
 // 11. Get Expiry Info by HWID (for remote applications without auth system)
 router.get('/auth/get-expiry/:appId/:hwid', async (req, res) => {
-    const { appId, hwid } = req.params;
-    const { appSecret } = req.query;
-
-    if (!appId || !appSecret || !hwid) {
-        return res.status(400).json({ success: false, message: "Missing required fields" });
-    }
-
     try {
-        // Verify app exists and secret matches
-        const appDoc = await db.collection('applications').doc(appId).get();
-        if (!appDoc.exists) {
-            return res.status(404).json({ success: false, message: "Application not found" });
-        }
+        const keyData = await findKeyByHwid(req, res, '/auth/get-expiry');
+        if (!keyData) return;
 
-        const appData = appDoc.data();
-        if (appData.secret !== appSecret) {
-            return res.status(403).json({ success: false, message: "Invalid app secret" });
-        }
+        res.json({ success: true, ...expiryForKey(keyData) });
 
-        // Search for user by HWID
-        const keySnapshot = await db.collection('app_keys')
-            .where('appId', '==', appId)
-            .where('hwid', '==', hwid)
-            .limit(1)
-            .get();
-
-        if (keySnapshot.empty) {
-            // Log suspicious access - unregistered HWID
-            discordLogger.logSuspiciousHWIDAccess({
-                appId: appId,
-                appName: appData.name,
-                hwid: hwid,
-                ip: req.ip || req.connection.remoteAddress,
-                endpoint: '/auth/get-expiry',
-                reason: 'HWID não registrado'
-            }).catch(err => console.error('[SUSPICIOUS-HWID-LOG] Error:', err));
-
-            return res.status(404).json({ success: false, message: "HWID not registered" });
-        }
-
-        const keyDoc = keySnapshot.docs[0];
-        const keyData = keyDoc.data();
-
-        // Calculate expiry info
-        const now = new Date();
-        const expires = keyData.expires_at ? new Date(keyData.expires_at) : null;
-
-        let daysRemaining = null;
-        let isExpired = false;
+    } catch (e) {
+        console.error("GetExpiry Error:", e);
+        res.status(500).json({ success: false, message: "Server error" });
+    }
+});
 
-        if (expires) {
-            daysRemaining = Math.max(0, Math.ceil((expires - now) / (1000 * 60 * 60 * 24)));
-            isExpired = expires < now;
-        }
+// 12. Get User + Expiry Info by HWID in one call (menu fetcher)
+router.get('/auth/get-user-info/:appId/:hwid', async (req, res) => {
+    try {
+        const keyData = await findKeyByHwid(req, res, '/auth/get-user-info');
+        if (!keyData) return;
 
+        const username = await usernameForKey(keyData);
+        const created_at = keyData.activated_at || keyData.created_at;
+        const expiry = expiryForKey(keyData);
         res.json({
             success: true,
-            expires_at: keyData.expires_at,
-            days_remaining: daysRemaining,
-            is_expired: isExpired,
-            subscription_type: keyData.type || 'license',
-            level: keyData.level || 1
+            username,
+            created_at,
+            ...expiry,
+            lease: issueLease({
+                kind: 'info', appId: req.params.appId, subject: username, hwid: req.params.hwid, username,
+                level: expiry.level, expires_at: keyData.expires_at, created_at, subscription_type: expiry.subscription_type
+            })
         });
 
     } catch (e) {
-        console.error("GetExpiry Error:", e);
+        console.error("GetUserInfo Error:", e);
         res.status(500).json({ success: false, message: "Server error" });
     }
 });